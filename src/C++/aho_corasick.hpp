@@ -0,0 +1,192 @@
+/*
+  Header file for the building of the Aho-Corasick automaton, shared by the
+  dense form in `aho_corasick.cpp` and the sparse one in
+  `aho_corasick_sparse.cpp`.
+
+  The trie is grown one state at a time as the patterns are entered, so that
+  it has a state for each distinct prefix of the patterns and no more. The
+  failure function, and the output function from it, are then built in the
+  breadth-first order of the states. The two forms differ only in how they
+  store the transitions that the search follows.
+*/
+
+#ifndef _AHO_CORASICK_HPP
+#define _AHO_CORASICK_HPP
+
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "alphabet.hpp"
+
+// The runner encodes the four characters of the DNA alphabet as 0-3 (see
+// `alphabet.hpp`), so each state of the goto function only needs four slots.
+constexpr int ASIZE = DNA_ASIZE;
+
+// The "fail" value is used to determine certain states in the goto
+// function.
+constexpr int FAIL = -1;
+
+/*
+  The automaton as it is built. The goto function is stored flat, row-major:
+  the transition from `state` on character `c` is at goto_fn[state * ASIZE +
+  c]. `endings` is the partial output function, as a list of (state, pattern)
+  pairs, one for each pattern. `failure_fn` and `order` (the states in
+  breadth-first order) are filled in by build_failure().
+*/
+struct AhoCorasickTrie {
+  std::vector<int> goto_fn;
+  std::vector<std::pair<int, int>> endings;
+  std::vector<int> failure_fn;
+  std::vector<int> order;
+
+  int states() const { return goto_fn.size() / ASIZE; }
+};
+
+/*
+  Enter the given pattern into the trie, creating new states as needed. Each
+  new state is numbered as the next row of the goto function, which is added
+  for it. When done, note the index of the pattern as ending at the state of
+  the last character (the partial output function).
+*/
+inline void enter_pattern(std::string const &pat, int idx,
+                          AhoCorasickTrie &trie) {
+  std::vector<int> &goto_fn = trie.goto_fn;
+  int len = pat.length();
+  int j = 0, state = 0;
+
+  // Find the first leaf corresponding to a character in `pat`. From there is
+  // where a new state (if needed) will be added.
+  while (j < len && goto_fn[state * ASIZE + pat[j]] != FAIL) {
+    state = goto_fn[state * ASIZE + pat[j]];
+    j++;
+  }
+
+  // At this point, `state` points to the leaf in the automaton. Create new
+  // states from here on for the remaining characters in `pat` that weren't
+  // already in the automaton.
+  for (int p = j; p < len; p++) {
+    int new_state = trie.states();
+    goto_fn[state * ASIZE + pat[p]] = new_state;
+    goto_fn.resize(goto_fn.size() + ASIZE, FAIL);
+    state = new_state;
+  }
+
+  trie.endings.emplace_back(state, idx);
+}
+
+/*
+  Build the goto function and the (partial) output function, starting from
+  the root alone. The states are numbered afresh for each automaton, as
+  `--bench` builds it more than once.
+*/
+inline AhoCorasickTrie build_goto(std::vector<std::string> const &pats) {
+  AhoCorasickTrie trie;
+
+  trie.goto_fn.assign(ASIZE, FAIL);
+  trie.endings.reserve(pats.size());
+  for (int i = 0; i < (int)pats.size(); i++)
+    enter_pattern(pats[i], i, trie);
+  // The rows were grown a few at a time, so give back what is left over.
+  trie.goto_fn.shrink_to_fit();
+
+  return trie;
+}
+
+/*
+  Build the failure function, and from it the complete DFA: every FAIL in the
+  goto function is replaced by the transition that following the failure
+  links would have arrived at, so matching takes exactly one lookup per
+  character. The states are listed in breadth-first order, which the output
+  function needs next.
+*/
+inline void build_failure(AhoCorasickTrie &trie) {
+  std::vector<int> &goto_fn = trie.goto_fn;
+  // Need a simple queue of state numbers.
+  std::queue<int> queue;
+
+  // Initializing all of the failure function's slots to 0 will allow a
+  // shortcut or two in the rest of the algorithm.
+  trie.failure_fn.assign(trie.states(), 0);
+  std::vector<int> &failure_fn = trie.failure_fn;
+  trie.order.clear();
+  trie.order.reserve(trie.states());
+  trie.order.push_back(0);
+
+  // The queue starts out empty. Set it to be all states reachable from state 0
+  // and set failure(state) for those states to be 0. The unused transitions
+  // of state 0 point back to state 0.
+  for (int a = 0; a < ASIZE; a++) {
+    int state = goto_fn[a];
+    if (state == FAIL) {
+      goto_fn[a] = 0;
+      continue;
+    }
+
+    queue.push(state);
+  }
+
+  // This uses some single-letter variable names that match the published
+  // algorithm. Their mnemonic isn't clear, or else I'd use more meaningful
+  // names.
+  while (!queue.empty()) {
+    int r = queue.front();
+    queue.pop();
+    trie.order.push_back(r);
+    for (int a = 0; a < ASIZE; a++) {
+      int s = goto_fn[r * ASIZE + a];
+      if (s == FAIL) {
+        // The row of failure(r) is already complete, as it is shallower than
+        // r. Borrow its transition.
+        goto_fn[r * ASIZE + a] = goto_fn[failure_fn[r] * ASIZE + a];
+        continue;
+      }
+
+      queue.push(s);
+      // Because shallower rows have already been completed, this is the whole
+      // of the "while goto(state, a) == fail" loop of the paper.
+      failure_fn[s] = goto_fn[failure_fn[r] * ASIZE + a];
+    }
+  }
+}
+
+/*
+  Build the complete output function in CSR form: the patterns recognized on
+  entering state `s` are out_indices[out_offsets[s]] through
+  out_indices[out_offsets[s + 1] - 1]. Each state's set is its own patterns
+  followed by those of its failure state. Going in breadth-first order means
+  the failure state's set is always finished first.
+*/
+inline void build_output(AhoCorasickTrie const &trie,
+                         std::vector<int> &out_offsets,
+                         std::vector<int> &out_indices) {
+  std::vector<int> const &failure_fn = trie.failure_fn;
+  int states = trie.states();
+  std::vector<int> own_count(states, 0), count(states, 0);
+
+  for (auto const &ending : trie.endings)
+    own_count[ending.first]++;
+  for (int s : trie.order)
+    count[s] = own_count[s] + (s ? count[failure_fn[s]] : 0);
+
+  out_offsets.assign(states + 1, 0);
+  for (int s = 0; s < states; s++)
+    out_offsets[s + 1] = out_offsets[s] + count[s];
+  out_indices.assign(out_offsets[states], 0);
+
+  // Place each state's own patterns first...
+  std::vector<int> fill(out_offsets.begin(), out_offsets.end() - 1);
+  for (auto const &ending : trie.endings)
+    out_indices[fill[ending.first]++] = ending.second;
+  // ...then copy the (finished) set of its failure state after them.
+  for (int s : trie.order) {
+    if (s == 0)
+      continue;
+    int f = failure_fn[s];
+    for (int o = out_offsets[f]; o < out_offsets[f + 1]; o++)
+      out_indices[fill[s]++] = out_indices[o];
+  }
+}
+
+#endif // !_AHO_CORASICK_HPP
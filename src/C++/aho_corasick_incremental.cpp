@@ -0,0 +1,58 @@
+/*
+  The Aho-Corasick algorithm with the automaton of
+  `aho_corasick_incremental.hpp`, which patterns can be added to and removed
+  from once it is built.
+
+  Here the automaton is built by adding the patterns one at a time, each
+  update as a long-running matcher would make it, so that the runner checks
+  the results of the updates against the answers. `aho_corasick_updates.cpp`
+  measures the updates themselves.
+*/
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "aho_corasick_incremental.hpp"
+#include "run.hpp"
+
+/*
+  Initialize the automaton by adding each pattern in turn. The patterns are
+  then numbered as they are in `patterns_data`. This isn't cacheable, as the
+  point is the updates rather than the table.
+*/
+IncrementalAhoCorasick
+init_aho_corasick_incremental(std::vector<std::string> const &patterns_data) {
+  IncrementalAhoCorasick return_val;
+
+  for (std::string const &pattern : patterns_data)
+    return_val.add(pattern);
+
+  return return_val;
+}
+
+void aho_corasick_incremental(IncrementalAhoCorasick const &pat_data,
+                              std::string_view sequence,
+                              std::vector<int> &matches) {
+  pat_data.search(sequence, matches, CountOnly{});
+}
+
+void aho_corasick_incremental_locate(IncrementalAhoCorasick const &pat_data,
+                                     std::string_view sequence,
+                                     std::vector<int> &matches, HitSink sink) {
+  pat_data.search(sequence, matches, sink);
+}
+
+/*
+  All that is done here is call the run() function with the argc/argv values,
+  asking for the data in the DNA encoding, and with the locating search for
+  `--positions`.
+*/
+int main(int argc, char *argv[]) {
+  int return_code =
+      run_multi(&init_aho_corasick_incremental, &aho_corasick_incremental,
+                "aho_corasick_incremental", argc, argv, Encoding::dna,
+                &aho_corasick_incremental_locate);
+
+  return return_code;
+}
@@ -0,0 +1,326 @@
+/*
+  Header file for an Aho-Corasick automaton that patterns can be added to and
+  removed from after it is built, without building it again from the whole
+  set. `aho_corasick_incremental.cpp` matches with it, and
+  `aho_corasick_updates.cpp` measures its updates against a full rebuild.
+
+  The automaton is the complete DFA of `aho_corasick.hpp`, with what it takes
+  to find the part of it that an update changes kept alongside:
+
+    * the edges of the trie, apart from the transitions of the DFA, and the
+      parent of each state
+    * the failure function, and its inverse as a tree: the states whose
+      failure link is s are listed from s (`first_linked`, `next_linked`)
+    * the patterns ending at each state, and for each state the first state of
+      its failure chain (itself included) that any pattern ends at, for the
+      search to follow in place of the CSR output sets
+
+  A new state s = goto(r, a) only changes the transitions on a of the states
+  below r in the inverse tree, down to those that have a child on a of their
+  own, whose children then fail to s. Removing a state undoes that. Outputs
+  only change below the state whose patterns changed, down to the states that
+  have patterns of their own. So an update costs the size of that part of the
+  tree, rather than that of the whole automaton.
+
+  The patterns are numbered in the order they are added, and a number is not
+  used again once its pattern is removed. The states of removed patterns are
+  reused by those added after them.
+*/
+
+#ifndef _AHO_CORASICK_INCREMENTAL_HPP
+#define _AHO_CORASICK_INCREMENTAL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "aho_corasick.hpp"
+
+class IncrementalAhoCorasick {
+public:
+  IncrementalAhoCorasick() { allocate(); }
+
+  /*
+    Add `pattern` (encoded, as the runner does) to the automaton, and return
+    its number.
+  */
+  int add(std::string const &pattern) {
+    if (pattern.empty())
+      throw std::runtime_error{"Cannot add an empty pattern"};
+
+    int state = 0;
+    for (char c : pattern) {
+      int next = trie[state * ASIZE + c];
+      state = next == FAIL ? add_state(state, c) : next;
+    }
+
+    int id = ends.size();
+    ends.push_back(state);
+    nodes[state].own.push_back(id);
+    if (nodes[state].own.size() == 1)
+      relink_outputs(state);
+    live++;
+
+    return id;
+  }
+
+  /*
+    Remove the pattern numbered `id`, along with the states that no other
+    pattern needs.
+  */
+  void remove(int id) {
+    if (id < 0 || id >= (int)ends.size() || ends[id] == FAIL) {
+      std::ostringstream msg;
+      msg << "No pattern " << id << " in the automaton";
+      throw std::runtime_error{msg.str()};
+    }
+
+    int state = ends[id];
+    std::vector<int> &own = nodes[state].own;
+    own.erase(std::find(own.begin(), own.end(), id));
+    ends[id] = FAIL;
+    if (own.empty())
+      relink_outputs(state);
+    live--;
+
+    // Prune the states that no longer lead to a pattern, from the leaf up.
+    while (state != 0 && nodes[state].own.empty() && leaf(state)) {
+      int parent = nodes[state].parent;
+      remove_state(state);
+      state = parent;
+    }
+  }
+
+  // The number of patterns ever added, which the counts are indexed by.
+  int patterns_count() const { return ends.size(); }
+  // The number of states in use.
+  int states() const { return nodes.size() - free_states.size(); }
+
+  // The memory of the automaton, as the runner reports for `table_bytes`.
+  std::size_t table_bytes() const {
+    std::size_t bytes = (delta.capacity() + trie.capacity() +
+                         output.capacity() + ends.capacity() +
+                         free_states.capacity()) *
+                            sizeof(int) +
+                        nodes.capacity() * sizeof(Node);
+    for (Node const &node : nodes)
+      bytes += node.own.capacity() * sizeof(int);
+    return bytes;
+  }
+
+  /*
+    The same search as aho_corasick()'s, with the patterns found on entering
+    each state collected by following `output` along the failure chain. The
+    counts of removed patterns stay 0.
+  */
+  template <typename Sink>
+  void search(std::string_view sequence, std::vector<int> &matches,
+              Sink sink) const {
+    int const *delta_fn = delta.data();
+    int const *output_fn = output.data();
+    Node const *node = nodes.data();
+
+    int state = 0;
+    int n = sequence.length();
+    matches.assign(ends.size(), 0);
+    [[maybe_unused]] int full = 0; // The patterns that need no more matches
+
+    for (int i = 0; i < n; i++) {
+      state = delta_fn[state * ASIZE + sequence[i]];
+      for (int o = output_fn[state]; o != FAIL;
+           o = output_fn[node[o].failure]) {
+        for (int pattern : node[o].own) {
+          if constexpr (Sink::reports) {
+            if (sink.full(matches[pattern]))
+              continue;
+            matches[pattern]++;
+            sink(pattern, i);
+            if (sink.full(matches[pattern]) && ++full == live)
+              return;
+          } else
+            matches[pattern]++;
+        }
+      }
+    }
+  }
+
+private:
+  struct Node {
+    int failure = 0;
+    int parent = 0;
+    int edge = 0; // The character of the edge from the parent
+    int first_linked = FAIL;
+    int next_linked = FAIL;
+    int prev_linked = FAIL;
+    std::vector<int> own; // The patterns that end here
+  };
+
+  bool leaf(int state) const {
+    for (int c = 0; c < ASIZE; c++)
+      if (trie[state * ASIZE + c] != FAIL)
+        return false;
+    return true;
+  }
+
+  // A fresh state, with no edges and no transitions yet.
+  int allocate() {
+    if (!free_states.empty()) {
+      int state = free_states.back();
+      free_states.pop_back();
+      nodes[state] = Node{};
+      return state;
+    }
+    nodes.emplace_back();
+    delta.resize(delta.size() + ASIZE, 0);
+    trie.resize(trie.size() + ASIZE, FAIL);
+    output.push_back(FAIL);
+    return nodes.size() - 1;
+  }
+
+  // Put `state` on, or take it off, the inverse failure list of its failure
+  // state.
+  void link(int state) {
+    Node &node = nodes[state];
+    Node &failure = nodes[node.failure];
+    node.prev_linked = FAIL;
+    node.next_linked = failure.first_linked;
+    if (failure.first_linked != FAIL)
+      nodes[failure.first_linked].prev_linked = state;
+    failure.first_linked = state;
+  }
+  void unlink(int state) {
+    Node &node = nodes[state];
+    if (node.prev_linked == FAIL)
+      nodes[node.failure].first_linked = node.next_linked;
+    else
+      nodes[node.prev_linked].next_linked = node.next_linked;
+    if (node.next_linked != FAIL)
+      nodes[node.next_linked].prev_linked = node.prev_linked;
+  }
+
+  // Push the states that fail to `state` onto `stack`.
+  void push_linked(int state, std::vector<int> &stack) const {
+    for (int s = nodes[state].first_linked; s != FAIL; s = nodes[s].next_linked)
+      stack.push_back(s);
+  }
+
+  /*
+    Work out `output` again for `state` and the states that fail to it. The
+    walk stops at the states whose value doesn't change, as those below them
+    are already right.
+  */
+  void relink_outputs(int state) {
+    std::vector<int> &stack = relinks;
+    stack.assign(1, state);
+    while (!stack.empty()) {
+      int s = stack.back();
+      stack.pop_back();
+      int value = nodes[s].own.empty() ? output[nodes[s].failure] : s;
+      if (s != state && value == output[s])
+        continue;
+      output[s] = value;
+      push_linked(s, stack);
+    }
+  }
+
+  /*
+    Add the state s = goto(r, a). Its failure state f is the transition of
+    failure(r) on a, which is also where r went on a until now, and its row
+    starts as f's. Then the states below r in the inverse tree that went to f
+    on a go to s instead. Where one of them has a child t on a, the walk stops,
+    as t failed to f and now fails to s.
+  */
+  int add_state(int r, int a) {
+    int s = allocate();
+    int f = delta[r * ASIZE + a];
+
+    trie[r * ASIZE + a] = s;
+    nodes[s].parent = r;
+    nodes[s].edge = a;
+    nodes[s].failure = f;
+    link(s);
+    std::copy_n(delta.begin() + f * ASIZE, ASIZE, delta.begin() + s * ASIZE);
+    output[s] = output[f];
+    delta[r * ASIZE + a] = s;
+
+    // With f = r (r being all a's), s fails to r and is among those below it.
+    std::vector<int> &stack = walk;
+    stack.clear();
+    push_linked(r, stack);
+    while (!stack.empty()) {
+      int u = stack.back();
+      stack.pop_back();
+      int t = trie[u * ASIZE + a];
+      if (t != FAIL) {
+        if (nodes[t].failure != s) {
+          unlink(t);
+          nodes[t].failure = s;
+          link(t);
+          relink_outputs(t);
+        }
+        continue;
+      }
+      delta[u * ASIZE + a] = s;
+      push_linked(u, stack);
+    }
+
+    return s;
+  }
+
+  /*
+    Remove the state s = goto(r, a), a leaf with no patterns: the reverse of
+    add_state(). The states that went to s on a go where r now goes on a, and
+    those that failed to s fail to its failure state instead. Their outputs
+    don't change, as s had no patterns of its own.
+  */
+  void remove_state(int s) {
+    int r = nodes[s].parent, a = nodes[s].edge;
+    int f = nodes[s].failure;
+    int replacement = r == 0 ? 0 : delta[nodes[r].failure * ASIZE + a];
+
+    trie[r * ASIZE + a] = FAIL;
+    delta[r * ASIZE + a] = replacement;
+    while (nodes[s].first_linked != FAIL) {
+      int t = nodes[s].first_linked;
+      unlink(t);
+      nodes[t].failure = f;
+      link(t);
+    }
+
+    std::vector<int> &stack = walk;
+    stack.clear();
+    push_linked(r, stack);
+    while (!stack.empty()) {
+      int u = stack.back();
+      stack.pop_back();
+      if (trie[u * ASIZE + a] != FAIL || delta[u * ASIZE + a] != s)
+        continue;
+      delta[u * ASIZE + a] = replacement;
+      push_linked(u, stack);
+    }
+
+    unlink(s);
+    nodes[s] = Node{};
+    output[s] = FAIL;
+    free_states.push_back(s);
+  }
+
+  std::vector<int> delta;  // The complete DFA, ASIZE transitions a state
+  std::vector<int> trie;   // The edges of the trie, FAIL where there is none
+  std::vector<int> output; // The first state on the chain with patterns
+  std::vector<Node> nodes;
+  std::vector<int> ends; // The state of each pattern, FAIL once removed
+  std::vector<int> free_states;
+  int live = 0; // The patterns not removed
+
+  // The stacks of the walks over the inverse tree, kept between updates so
+  // that each walk doesn't allocate its own. add_state() relinks outputs in
+  // the middle of its walk, so the two need their own.
+  std::vector<int> walk, relinks;
+};
+
+#endif // !_AHO_CORASICK_INCREMENTAL_HPP
@@ -0,0 +1,184 @@
+/*
+  The Aho-Corasick algorithm with a sparse form of the automaton, for sets of
+  patterns whose dense table (`aho_corasick.cpp`) would be too large.
+
+  Rather than all ASIZE transitions of each state, only the edges of the trie
+  and the failure function are kept, and the search follows the failure links
+  as in the paper. The states are numbered in breadth-first order, so the
+  children of each state are numbered consecutively. A state is then one
+  32-bit word: the mask of the characters it has children for, in the low
+  bits, and the number of its first child above them. The child on c is the
+  first child plus the number of characters in the mask below c. With the
+  failure function, that is 8 bytes a state in place of 16.
+*/
+
+#include <bit>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "aho_corasick.hpp"
+#include "run.hpp"
+
+// The low bits of a state's word that hold the mask of its children.
+constexpr int MASK_BITS = ASIZE;
+
+// The most states that the first child of a state can be numbered within.
+constexpr int MOST_STATES = 1 << (32 - MASK_BITS);
+
+/*
+  The preprocessed form of the set of patterns: the trie, as the words
+  described above, the failure function, and the output function in the CSR
+  form of `aho_corasick.hpp`, all by the breadth-first numbering of the
+  states.
+*/
+struct alignas(CACHE_LINE) AhoCorasickSparsePattern {
+  int patterns_count = 0;
+  AlignedArray<std::uint32_t> nodes;
+  AlignedArray<int> failure_fn;
+  AlignedArray<int> out_offsets;
+  AlignedArray<int> out_indices;
+
+  template <typename Archive> void fields(Archive &archive) {
+    archive(patterns_count, nodes, failure_fn, out_offsets, out_indices);
+  }
+};
+
+/*
+  Initialize the structure for the sparse Aho-Corasick. The automaton is
+  built as for the dense form, noting which transitions are edges of the trie
+  before the failure transitions are folded in, and is then renumbered into
+  the sparse tables.
+*/
+AhoCorasickSparsePattern
+init_aho_corasick_sparse(std::vector<std::string> const &patterns_data) {
+  AhoCorasickSparsePattern return_val;
+
+  AhoCorasickTrie trie = build_goto(patterns_data);
+  int states = trie.states();
+  if (states > MOST_STATES) {
+    std::ostringstream msg;
+    msg << "Too many states for the sparse automaton: " << states
+        << " (at most " << MOST_STATES << ")";
+    throw std::runtime_error{msg.str()};
+  }
+  std::vector<std::uint32_t> masks(states, 0);
+  for (int s = 0; s < states; s++)
+    for (int c = 0; c < ASIZE; c++)
+      if (trie.goto_fn[s * ASIZE + c] != FAIL)
+        masks[s] |= 1u << c;
+  build_failure(trie);
+  std::vector<int> out_offsets, out_indices;
+  build_output(trie, out_offsets, out_indices);
+
+  // The breadth-first number of each state. The root stays 0.
+  std::vector<int> renumber(states);
+  for (int i = 0; i < states; i++)
+    renumber[trie.order[i]] = i;
+
+  return_val.patterns_count = patterns_data.size();
+  return_val.nodes = AlignedArray<std::uint32_t>(states, 0);
+  return_val.failure_fn = AlignedArray<int>(states, 0);
+  return_val.out_offsets = AlignedArray<int>(states + 1, 0);
+  return_val.out_indices = AlignedArray<int>(out_indices.size(), 0);
+  std::uint32_t *nodes = return_val.nodes.data();
+  int *failure_fn = return_val.failure_fn.data();
+  int *offsets = return_val.out_offsets.data();
+  int *indices = return_val.out_indices.data();
+  int filled = 0;
+  for (int i = 0; i < states; i++) {
+    int s = trie.order[i];
+    std::uint32_t first_child = 0;
+    for (int c = 0; c < ASIZE; c++)
+      if (masks[s] & (1u << c)) {
+        first_child = renumber[trie.goto_fn[s * ASIZE + c]];
+        break;
+      }
+    nodes[i] = first_child << MASK_BITS | masks[s];
+    failure_fn[i] = renumber[trie.failure_fn[s]];
+    for (int o = out_offsets[s]; o < out_offsets[s + 1]; o++)
+      indices[filled++] = out_indices[o];
+    offsets[i + 1] = filled;
+  }
+
+  return return_val;
+}
+
+/*
+  Perform the Aho-Corasick algorithm against the given sequence, following
+  the failure links from each state that has no child on the character, down
+  to the root if need be. The counts and the reports to `sink` are those of
+  `aho_corasick.cpp`.
+*/
+template <typename Sink>
+static void aho_corasick_sparse_search(AhoCorasickSparsePattern const &pat_data,
+                                       std::string_view sequence,
+                                       std::vector<int> &matches, Sink sink) {
+  int pattern_count = pat_data.patterns_count;
+  std::uint32_t const *nodes = pat_data.nodes.data();
+  int const *failure_fn = pat_data.failure_fn.data();
+  int const *out_offsets = pat_data.out_offsets.data();
+  int const *out_indices = pat_data.out_indices.data();
+
+  int state = 0;
+  int n = sequence.length();
+  matches.assign(pattern_count, 0);
+  [[maybe_unused]] int full = 0; // The patterns that need no more matches
+
+  for (int i = 0; i < n; i++) {
+    int c = sequence[i];
+    for (;;) {
+      std::uint32_t node = nodes[state];
+      if (node & (1u << c)) {
+        state = (node >> MASK_BITS) + std::popcount(node & ((1u << c) - 1));
+        break;
+      }
+      if (state == 0)
+        break;
+      state = failure_fn[state];
+    }
+    for (int o = out_offsets[state]; o < out_offsets[state + 1]; o++) {
+      int pattern = out_indices[o];
+      if constexpr (Sink::reports) {
+        // As in aho_corasick(): a full pattern is no longer counted, and the
+        // search ends once all of them are full.
+        if (sink.full(matches[pattern]))
+          continue;
+        matches[pattern]++;
+        sink(pattern, i);
+        if (sink.full(matches[pattern]) && ++full == pattern_count)
+          return;
+      } else
+        matches[pattern]++;
+    }
+  }
+
+  return;
+}
+
+void aho_corasick_sparse(AhoCorasickSparsePattern const &pat_data,
+                         std::string_view sequence, std::vector<int> &matches) {
+  aho_corasick_sparse_search(pat_data, sequence, matches, CountOnly{});
+}
+
+void aho_corasick_sparse_locate(AhoCorasickSparsePattern const &pat_data,
+                                std::string_view sequence,
+                                std::vector<int> &matches, HitSink sink) {
+  aho_corasick_sparse_search(pat_data, sequence, matches, sink);
+}
+
+/*
+  All that is done here is call the run() function with the argc/argv values,
+  asking for the data in the DNA encoding, and with the locating search for
+  `--positions`.
+*/
+int main(int argc, char *argv[]) {
+  int return_code = run_multi(&init_aho_corasick_sparse, &aho_corasick_sparse,
+                              "aho_corasick_sparse", argc, argv, Encoding::dna,
+                              &aho_corasick_sparse_locate);
+
+  return return_code;
+}
@@ -0,0 +1,196 @@
+/*
+  Measure the updates of the automaton in `aho_corasick_incremental.hpp`
+  against building the automaton again from the whole set of patterns, as
+  init_aho_corasick() has to.
+
+  Of the patterns read, `--batch` are held out and the automaton is built from
+  the rest. Each of the `--rounds` then removes as many of the patterns in it,
+  chosen at random, and adds the held-out ones in their place, so the set
+  keeps its size and the patterns removed are the ones held out for the next
+  round. Each round is timed, and so are two rebuilds of the set it leaves:
+  the incremental automaton from nothing, and the dense tables of
+  `aho_corasick.hpp`. Last, the counts of the updated automaton against the
+  sequences are checked against those of the dense one for the final set.
+
+  The output is YAML, as the runners' is, with the min, median and 99th
+  percentile of each time.
+*/
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "aho_corasick.hpp"
+#include "aho_corasick_incremental.hpp"
+#include "input.hpp"
+#include "run.hpp"
+
+// The defaults of the options: a day's worth of changes to the dictionary,
+// several times over.
+constexpr int DEFAULT_BATCH = 100;
+constexpr int DEFAULT_ROUNDS = 10;
+constexpr int DEFAULT_SEED = 1;
+
+/*
+  The dense automaton of `aho_corasick.hpp`, as init_aho_corasick() builds it
+  (less the copy into its AlignedArrays).
+*/
+struct DenseAutomaton {
+  std::vector<int> goto_fn;
+  std::vector<int> out_offsets;
+  std::vector<int> out_indices;
+};
+
+DenseAutomaton build_dense(std::vector<std::string> const &patterns) {
+  DenseAutomaton return_val;
+
+  AhoCorasickTrie trie = build_goto(patterns);
+  build_failure(trie);
+  build_output(trie, return_val.out_offsets, return_val.out_indices);
+  return_val.goto_fn = std::move(trie.goto_fn);
+
+  return return_val;
+}
+
+/*
+  Count the matches of each of the dense automaton's patterns in `sequence`,
+  as aho_corasick() does.
+*/
+void count_dense(DenseAutomaton const &dense, int patterns_count,
+                 std::string_view sequence, std::vector<int> &matches) {
+  int state = 0;
+  matches.assign(patterns_count, 0);
+
+  for (char c : sequence) {
+    state = dense.goto_fn[state * ASIZE + c];
+    for (int o = dense.out_offsets[state]; o < dense.out_offsets[state + 1];
+         o++)
+      matches[dense.out_indices[o]]++;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  std::ostringstream usage;
+  usage << "Usage: " << argv[0]
+        << " [ --batch N ] [ --rounds N ] [ --seed N ] <sequences> <patterns>";
+  int batch = DEFAULT_BATCH, rounds = DEFAULT_ROUNDS, seed = DEFAULT_SEED;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--batch" || arg == "--rounds" || arg == "--seed") {
+      if (i + 1 == argc)
+        throw std::runtime_error{usage.str()};
+      int value = std::stoi(argv[++i]);
+      (arg == "--batch" ? batch : arg == "--rounds" ? rounds : seed) = value;
+    } else if (arg.starts_with("--"))
+      throw std::runtime_error{usage.str()};
+    else
+      files.push_back(arg);
+  }
+  if (files.size() != 2)
+    throw std::runtime_error{usage.str()};
+
+  SequenceStore sequences_data = read_sequences(files[0]);
+  sequences_data.encode();
+  std::vector<std::string> patterns_data = read_patterns(files[1]);
+  for (auto &pattern : patterns_data)
+    pattern = encode_dna(pattern);
+  int patterns_count = patterns_data.size();
+  if (batch < 1 || rounds < 1 || 2 * batch > patterns_count) {
+    std::ostringstream msg;
+    msg << "Batches of " << batch << " need at least " << 2 * batch
+        << " patterns, and there are " << patterns_count;
+    throw std::runtime_error{msg.str()};
+  }
+
+  // `current` is the set in the automaton, by index in `patterns_data`, and
+  // ids[p] is the number that the automaton gave pattern p.
+  std::mt19937 rng(seed);
+  std::vector<int> current(patterns_count);
+  std::iota(current.begin(), current.end(), 0);
+  std::shuffle(current.begin(), current.end(), rng);
+  std::vector<int> held(current.end() - batch, current.end());
+  current.resize(patterns_count - batch);
+  std::vector<int> ids(patterns_count, FAIL);
+
+  double start = get_time();
+  IncrementalAhoCorasick automaton;
+  for (int p : current)
+    ids[p] = automaton.add(patterns_data[p]);
+  double build_time = get_time() - start;
+
+  std::vector<double> update_times, rebuild_times, dense_times;
+  std::vector<std::string> set;
+  for (int round = 0; round < rounds; round++) {
+    std::shuffle(current.begin(), current.end(), rng);
+    std::vector<int> removed(current.begin(), current.begin() + batch);
+
+    start = get_time();
+    for (int p : removed) {
+      automaton.remove(ids[p]);
+      ids[p] = FAIL;
+    }
+    for (int p : held)
+      ids[p] = automaton.add(patterns_data[p]);
+    update_times.push_back(get_time() - start);
+
+    std::copy(held.begin(), held.end(), current.begin());
+    held = removed;
+    set.clear();
+    for (int p : current)
+      set.push_back(patterns_data[p]);
+
+    start = get_time();
+    {
+      IncrementalAhoCorasick rebuilt;
+      for (std::string const &pattern : set)
+        rebuilt.add(pattern);
+    }
+    rebuild_times.push_back(get_time() - start);
+
+    start = get_time();
+    DenseAutomaton dense = build_dense(set);
+    dense_times.push_back(get_time() - start);
+  }
+
+  // Check the updated automaton against the dense one for the same set. The
+  // mismatches are reported by the position of the pattern in the file.
+  DenseAutomaton dense = build_dense(set);
+  std::vector<int> found, expected;
+  int mismatches = 0;
+  for (int s = 0; s < (int)sequences_data.size(); s++) {
+    automaton.search(sequences_data[s], found, CountOnly{});
+    count_dense(dense, set.size(), sequences_data[s], expected);
+    for (int j = 0; j < (int)set.size(); j++)
+      if (found[ids[current[j]]] != expected[j]) {
+        report_mismatch(current[j], s, found[ids[current[j]]], expected[j]);
+        mismatches++;
+      }
+  }
+
+  std::sort(update_times.begin(), update_times.end());
+  std::sort(dense_times.begin(), dense_times.end());
+  double update_median = median(update_times);
+  double dense_median = median(dense_times);
+  std::cout << "algorithm: aho_corasick_incremental\n"
+            << "patterns: " << set.size() << "\n"
+            << "batch: " << batch << "\n"
+            << "rounds: " << rounds << "\n"
+            << "states: " << automaton.states() << "\n"
+            << "table_bytes: " << automaton.table_bytes() << "\n"
+            << "build_time: " << build_time << "\n";
+  report_spread("update_time", update_times);
+  report_spread("rebuild_time", rebuild_times);
+  report_spread("dense_rebuild_time", dense_times);
+  std::cout << "speedup: "
+            << (update_median > 0 ? dense_median / update_median : 0) << "\n"
+            << "success: " << (mismatches ? "false" : "true") << "\n";
+
+  return mismatches != 0;
+}
@@ -0,0 +1,51 @@
+/*
+  A counting replacement for the global operator new, linked into the
+  binaries that `make alloc-check` builds. It points `allocation_count` (see
+  `counters.hpp`) at its count, so that `--counters` reports the allocations
+  made in each phase.
+
+  The default operator new[] and the nothrow forms call these, so replacing
+  the plain and the aligned forms counts them all.
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "counters.hpp"
+
+static std::atomic<std::uint64_t> allocations{0};
+
+static struct CountAllocations {
+  CountAllocations() { allocation_count = &allocations; }
+} count_allocations;
+
+void *operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *block = std::malloc(size ? size : 1))
+    return block;
+  throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, std::align_val_t align) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  // aligned_alloc() wants the size to be a multiple of the alignment.
+  std::size_t alignment = (std::size_t)align;
+  size = (size + alignment - 1) / alignment * alignment;
+  if (void *block = std::aligned_alloc(alignment, size ? size : alignment))
+    return block;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *block) noexcept { std::free(block); }
+
+void operator delete(void *block, std::size_t) noexcept { std::free(block); }
+
+void operator delete(void *block, std::align_val_t) noexcept {
+  std::free(block);
+}
+
+void operator delete(void *block, std::size_t, std::align_val_t) noexcept {
+  std::free(block);
+}
@@ -0,0 +1,34 @@
+/*
+  Header file for the compact encoding of the DNA alphabet.
+
+  The data only ever uses the four characters A, C, G and T. When the runners
+  are asked to, they encode those as the values 0-3 before any matching starts
+  (see `SequenceStore::encode` in `input.cpp`), so that the algorithms can size
+  their per-character tables by DNA_ASIZE instead of by the full ASCII range.
+*/
+
+#ifndef _ALPHABET_HPP
+#define _ALPHABET_HPP
+
+#include <array>
+
+// The number of characters in the encoded alphabet.
+constexpr int DNA_ASIZE = 4;
+
+// The characters of the alphabet, indexed by their encoded value.
+constexpr std::array<char, DNA_ASIZE> DNA_ALPHABET = {'A', 'C', 'G', 'T'};
+
+// The value DNA_CODES gives for any character outside of the alphabet.
+constexpr signed char DNA_INVALID = -1;
+
+// The encoded value of each (unsigned) char, or DNA_INVALID.
+constexpr std::array<signed char, 256> DNA_CODES = [] {
+  std::array<signed char, 256> codes{};
+  for (auto &code : codes)
+    code = DNA_INVALID;
+  for (int i = 0; i < DNA_ASIZE; i++)
+    codes[(unsigned char)DNA_ALPHABET[i]] = i;
+  return codes;
+}();
+
+#endif // !_ALPHABET_HPP
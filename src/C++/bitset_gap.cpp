@@ -0,0 +1,191 @@
+/*
+  A bit-parallel implementation of the same gapped approximate matching that
+  DFA-Gap does.
+
+  A match at position s is the pattern's first character at s, followed by
+  each of the remaining characters in turn, where up to k other characters may
+  come before each one (the first occurrence of the character is always the
+  one taken). DFA-Gap walks this forward from every s. Forward walks from
+  different starts can merge into the same state, so a forward set of states
+  cannot tell how many matches reached the end. Here the pattern is taken
+  backwards instead: G_j is the set of positions x at which pattern[j..m-1]
+  matches, starting with pattern[j] at x. Then
+
+    G_{m-1} = Eq(pattern[m-1])
+    G_j     = Eq(pattern[j]) & (x such that the first pattern[j + 1] after x
+                                 is within k + 1 and is in G_{j + 1})
+
+  and the count is |G_0|. Each set is a bitset over the sequence, one bit per
+  position, and each step is k + 1 shifts of G_{j + 1} back over positions
+  that are not pattern[j + 1].
+*/
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "run.hpp"
+
+// The runner encodes the four characters of the DNA alphabet as 0-3 (see
+// `alphabet.hpp`).
+constexpr int ASIZE = DNA_ASIZE;
+
+// The bitsets are made of 64-bit words.
+constexpr int WORD = 64;
+typedef unsigned long WORD_TYPE;
+
+/*
+  The preprocessed form of a pattern, which for this algorithm is just the
+  pattern itself and the value of k.
+*/
+struct alignas(CACHE_LINE) BitsetGapPattern {
+  int m = 0;
+  int k = 0;
+  AlignedArray<char> pattern;
+
+  template <typename Archive> void fields(Archive &archive) {
+    archive(m, k, pattern);
+  }
+};
+
+/*
+  Fill `eq` with the positions of each character in `sequence`: bit x%64 of
+  word (c * words + x / 64) is set when sequence[x] is c.
+*/
+static void calc_eq(std::string_view sequence, int words,
+                    std::vector<WORD_TYPE> &eq) {
+  int n = sequence.length();
+  char const *text = sequence.data();
+  int x = 0;
+
+  eq.assign(ASIZE * words, 0);
+
+#if defined(__AVX2__)
+  // 32 positions per compare.
+  for (; x + 32 <= n; x += 32) {
+    __m256i chars = _mm256_loadu_si256((__m256i const *)(text + x));
+    for (int c = 0; c < ASIZE; c++) {
+      WORD_TYPE mask = (unsigned)_mm256_movemask_epi8(
+          _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(c)));
+      eq[c * words + x / WORD] |= mask << (x % WORD);
+    }
+  }
+#endif
+
+  for (; x < n; x++)
+    eq[text[x] * words + x / WORD] |= (WORD_TYPE)1 << (x % WORD);
+}
+
+/*
+  Initialize the pattern given. For this algorithm that is just keeping the
+  pattern itself and the value of k.
+*/
+BitsetGapPattern init_bitset_gap(std::string const &pattern, int k) {
+  BitsetGapPattern return_val;
+
+  return_val.m = pattern.length();
+  return_val.k = k;
+  return_val.pattern = AlignedArray<char>(pattern.begin(), pattern.end());
+
+  return return_val;
+}
+
+/*
+  Perform the bit-parallel gapped matching of the given pattern against the
+  given sequence, reporting each match to `sink` (see `run.hpp`). The matches
+  are the bits left set in `reach`, one for each starting position, so they
+  are only walked one by one when the sink wants them. Stopping early only
+  saves that walk, as `reach` is built for the whole sequence at once.
+*/
+template <typename Sink>
+static int bitset_gap_search(BitsetGapPattern const &pat_data,
+                             std::string_view sequence, Sink sink) {
+  char const *pattern = pat_data.pattern.data();
+  int k = pat_data.k;
+
+  int m = pat_data.m;
+  int n = sequence.length();
+  if (n < m)
+    return 0;
+  int words = (n + WORD - 1) / WORD;
+
+  // These are reused from call to call, rather than allocated every time.
+  thread_local std::vector<WORD_TYPE> eq, reach, carry;
+  calc_eq(sequence, words, eq);
+  carry.resize(k + 2);
+
+  // Start with G_{m-1}.
+  WORD_TYPE const *last = &eq[pattern[m - 1] * words];
+  reach.assign(last, last + words);
+
+  for (int j = m - 2; j >= 0; j--) {
+    WORD_TYPE const *here = &eq[pattern[j] * words];
+    WORD_TYPE const *next = &eq[pattern[j + 1] * words];
+    WORD_TYPE any = 0;
+
+    // Going from the top word down, each word of a shift needs the low bit of
+    // the word above it at the same level. `carry[d]` holds that word.
+    carry.assign(k + 2, 0);
+    for (int w = words - 1; w >= 0; w--) {
+      WORD_TYPE level = reach[w], found = 0;
+
+      for (int d = 1; d <= k + 1; d++) {
+        // The first shift moves back onto the character before; any further
+        // ones can only pass over characters that are not pattern[j + 1].
+        WORD_TYPE from = d == 1 ? level : level & ~next[w];
+        level = (from >> 1) | (carry[d] << (WORD - 1));
+        carry[d] = from;
+        found |= level;
+      }
+
+      reach[w] = found & here[w];
+      any |= reach[w];
+    }
+
+    // Nothing left that could become a match.
+    if (!any)
+      return 0;
+  }
+
+  int matches = 0;
+  for (int w = 0; w < words; w++) {
+    if constexpr (Sink::reports) {
+      for (WORD_TYPE bits = reach[w]; bits; bits &= bits - 1) {
+        matches++;
+        sink(w * WORD + __builtin_ctzl(bits));
+        if (sink.full(matches))
+          return matches;
+      }
+    } else
+      matches += __builtin_popcountl(reach[w]);
+  }
+
+  return matches;
+}
+
+int bitset_gap(BitsetGapPattern const &pat_data, std::string_view sequence) {
+  return bitset_gap_search(pat_data, sequence, CountOnly{});
+}
+
+int bitset_gap_locate(BitsetGapPattern const &pat_data,
+                      std::string_view sequence, HitSink sink) {
+  return bitset_gap_search(pat_data, sequence, sink);
+}
+
+/*
+  All that is done here is call the run() function with a pointer to the
+  algorithm implementation, the label for the algorithm, and the argc/argv
+  values. The data is asked for in the DNA encoding, and the locating search
+  is used for `--positions`.
+*/
+int main(int argc, char *argv[]) {
+  int return_code =
+      run_approx(&init_bitset_gap, &bitset_gap, "bitset_gap", argc, argv,
+                 Encoding::dna, nullptr, &bitset_gap_locate);
+
+  return return_code;
+}
@@ -3,22 +3,48 @@
 
   This is based heavily on the code given in chapter 14 of the book, "Handbook
   of Exact String-Matching Algorithms," by Christian Charras and Thierry Lecroq.
+
+  When built with SIMD_FILTER defined (the `boyer_moore_simd` target), each
+  window is first moved up to the next position that passes the first/last
+  character filter in `simd_filter.hpp`.
 */
 
 #include <algorithm>
+#include <array>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "run.hpp"
+#ifdef SIMD_FILTER
+#include "simd_filter.hpp"
+#endif
 
-// Define the alphabet size, part of the Boyer-Moore pre-processing. Here, we
-// are just using ASCII characters, so 128 is fine.
-constexpr int ASIZE = 128;
+// Define the alphabet size, part of the Boyer-Moore pre-processing. The runner
+// encodes the DNA alphabet as 0-3 (see `alphabet.hpp`), so four is enough.
+constexpr int ASIZE = DNA_ASIZE;
+
+/*
+  The preprocessed form of a pattern. The bad-character table is small enough
+  to be kept in the struct itself.
+*/
+struct alignas(CACHE_LINE) BoyerMoorePattern {
+  int m = 0;
+  AlignedArray<char> pattern;
+  AlignedArray<int> good_suffix;
+  std::array<int, ASIZE> bad_char;
+
+  template <typename Archive> void fields(Archive &archive) {
+    archive(m, pattern, good_suffix, bad_char);
+  }
+};
 
 /*
   Preprocessing step: calculate the bad-character shifts.
 */
-void calc_bad_char(std::string const &pat, int m, std::vector<int> &bad_char) {
+void calc_bad_char(AlignedArray<char> const &pat, int m,
+                   std::array<int, ASIZE> &bad_char) {
+  bad_char.fill(m);
   for (int i = 0; i < m - 1; ++i)
     bad_char[pat[i]] = m - i - 1;
 }
@@ -26,7 +52,7 @@ void calc_bad_char(std::string const &pat, int m, std::vector<int> &bad_char) {
 /*
   Preprocessing step: calculate suffixes for good-suffix shifts.
 */
-void calc_suffixes(std::string const &pat, int m,
+void calc_suffixes(AlignedArray<char> const &pat, int m,
                    std::vector<int> &suffix_list) {
   int f = 0, g, i;
   suffix_list[m - 1] = m;
@@ -49,11 +75,10 @@ void calc_suffixes(std::string const &pat, int m,
 /*
   Preprocessing step: calculate the good-suffix shifts.
 */
-void calc_good_suffix(std::string const &pat, int m,
-                      std::vector<int> &good_suffix) {
+void calc_good_suffix(AlignedArray<char> const &pat, int m,
+                      AlignedArray<int> &good_suffix) {
   int i, j;
-  std::vector<int> suffixes;
-  suffixes.reserve(m);
+  std::vector<int> suffixes(m);
 
   calc_suffixes(pat, m, suffixes);
 
@@ -71,54 +96,61 @@ void calc_good_suffix(std::string const &pat, int m,
 
 /*
   Initialize the structure for Boyer-Moore. Here, that means setting up the
-  pair of jump-tables. The return value is a vector of the `PatternData` type,
-  which is a type-safe union of sorts that covers the different types that have
-  to be returned.
+  pair of jump-tables. The return value is the preprocessed pattern.
 */
-std::vector<PatternData> init_boyer_moore(std::string const &pattern) {
-  std::vector<PatternData> return_val;
-  return_val.reserve(3);
+BoyerMoorePattern init_boyer_moore(std::string const &pattern) {
+  BoyerMoorePattern return_val;
   int m = pattern.length();
+  return_val.m = m;
   // Set up a copy of pattern, with the sentinel character added:
-  std::string pat(pattern + "\0");
-  // Declare and initialize the good_suffix and bad_char vectors:
-  std::vector<int> good_suffix(m, 0), bad_char(ASIZE, m);
-
-  calc_good_suffix(pat, m, good_suffix);
-  calc_bad_char(pat, m, bad_char);
-
-  return_val.push_back(pat);
-  return_val.push_back(good_suffix);
-  return_val.push_back(bad_char);
+  return_val.pattern = AlignedArray<char>(m + 1, '\0');
+  std::copy(pattern.begin(), pattern.end(), return_val.pattern.begin());
+  // Set up the good_suffix and bad_char tables:
+  return_val.good_suffix = AlignedArray<int>(m, 0);
+  calc_good_suffix(return_val.pattern, m, return_val.good_suffix);
+  calc_bad_char(return_val.pattern, m, return_val.bad_char);
 
   return return_val;
 }
 
 /*
-  Perform the Boyer-Moore algorithm on the given pattern of length m,
-  against the sequence of length n.
+  The search itself, for a pattern of length m, reporting each match to `sink`
+  (see `run.hpp`). This is always inlined, so that a constant m (from
+  boyer_moore_fixed(), below) gives the comparison loop a constant bound the
+  compiler can unroll.
 */
-int boyer_moore(std::vector<PatternData> const &pat_data,
-                std::string const &sequence) {
+template <typename Sink>
+[[gnu::always_inline]] static inline int
+boyer_moore_search(BoyerMoorePattern const &pat_data, int m,
+                   std::string_view sequence, Sink sink) {
   int i, j;
   int matches = 0;
 
-  // Unpack pat_data:
-  std::string pattern = std::get<std::string>(pat_data[0]);
-  auto const &good_suffix = std::get<std::vector<int>>(pat_data[1]);
-  auto const &bad_char = std::get<std::vector<int>>(pat_data[2]);
+  char const *pattern = pat_data.pattern.data();
+  int const *good_suffix = pat_data.good_suffix.data();
+  auto const &bad_char = pat_data.bad_char;
 
-  // Get the size of the pattern and the sequence.
-  int m = pattern.length();
+  // Get the size of the sequence.
   int n = sequence.length();
 
   // Perform the searching:
   j = 0;
   while (j <= n - m) {
+#ifdef SIMD_FILTER
+    // No match can start before the next candidate, so skip straight to it.
+    j = next_candidate(sequence, j, m, pattern[0], pattern[m - 1]);
+    if (j > n - m)
+      break;
+#endif
     for (i = m - 1; i >= 0 && pattern[i] == sequence[i + j]; --i)
       ;
     if (i < 0) {
       matches++;
+      if constexpr (Sink::reports) {
+        sink(j);
+        if (sink.full(matches))
+          break;
+      }
       j += good_suffix[0];
     } else {
       j += std::max(good_suffix[i], bad_char[sequence[i + j]] - m + 1 + i);
@@ -128,14 +160,60 @@ int boyer_moore(std::vector<PatternData> const &pat_data,
   return matches;
 }
 
+/*
+  Perform the Boyer-Moore algorithm on the given pattern of length m,
+  against the sequence of length n.
+*/
+int boyer_moore(BoyerMoorePattern const &pat_data, std::string_view sequence) {
+  return boyer_moore_search(pat_data, pat_data.m, sequence, CountOnly{});
+}
+
+/*
+  The search again, specialized for a pattern length M known at compile time
+  (see `FixedLengths` in `run.hpp`).
+*/
+template <int M>
+int boyer_moore_fixed(BoyerMoorePattern const &pat_data,
+                      std::string_view sequence) {
+  return boyer_moore_search(pat_data, M, sequence, CountOnly{});
+}
+
+/*
+  The search again, reporting the offset of each match as well.
+*/
+int boyer_moore_locate(BoyerMoorePattern const &pat_data,
+                       std::string_view sequence, HitSink sink) {
+  return boyer_moore_search(pat_data, pat_data.m, sequence, sink);
+}
+
+/*
+  Return the specialized search for patterns of length m, if there is one.
+*/
+algorithm<BoyerMoorePattern> specialize_boyer_moore(int m) {
+  return select_fixed(
+      m,
+      [](auto M) -> algorithm<BoyerMoorePattern> {
+        return &boyer_moore_fixed<decltype(M)::value>;
+      },
+      FixedLengths{});
+}
+
 /*
   All that is done here is call the run() function with a pointer to the
   algorithm implementation, the label for the algorithm, and the argc/argv
-  values.
+  values. The data is asked for in the DNA encoding, and the specialized
+  searches are used for the lengths that have them. The locating search is
+  used for `--positions`.
 */
 int main(int argc, char *argv[]) {
+#ifdef SIMD_FILTER
+  std::string name = "boyer_moore_simd";
+#else
+  std::string name = "boyer_moore";
+#endif
   int return_code =
-      run(&init_boyer_moore, &boyer_moore, "boyer_moore", argc, argv);
+      run(&init_boyer_moore, &boyer_moore, name, argc, argv, Encoding::dna,
+          &specialize_boyer_moore, &boyer_moore_locate);
 
   return return_code;
 }
@@ -0,0 +1,203 @@
+/*
+  The pattern cache: building, writing and mapping the cache files described
+  in `cache.hpp`.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "cache.hpp"
+
+/*
+  Open the cache at `fname`, building it first if it is missing or does not
+  match `key`. The file is read back in after it is built, so that the run
+  uses the cache the same way whether it was built or not.
+*/
+PatternCache::PatternCache(std::string const &fname, CacheKey const &key,
+                           Save const &save) {
+  if (load(fname, key))
+    return;
+
+  write_cache(fname, key, save);
+  was_rebuilt = true;
+  if (!load(fname, key)) {
+    std::ostringstream error;
+    error << "Error reading back pattern cache " << fname;
+    throw std::runtime_error{error.str()};
+  }
+}
+
+PatternCache::~PatternCache() { release(); }
+
+void PatternCache::release() {
+  if (base)
+    munmap(base, length);
+  base = nullptr;
+  length = 0;
+}
+
+/*
+  Map the file and check its header against `key`. Returns false (with
+  nothing mapped) if the file can't be opened or doesn't match, which means
+  that it has to be built. The mapping is populated up front, so that reading
+  the patterns back does not fault pages in inside the timed region.
+*/
+bool PatternCache::load(std::string const &fname, CacheKey const &key) {
+  int fd = open(fname.c_str(), O_RDONLY);
+  if (fd == -1)
+    return false;
+
+  struct stat info;
+  if (fstat(fd, &info) == -1 ||
+      (std::size_t)info.st_size < sizeof(CacheHeader)) {
+    close(fd);
+    return false;
+  }
+  length = info.st_size;
+  base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    base = nullptr;
+    return false;
+  }
+
+  char const *start = static_cast<char const *>(base);
+  CacheHeader header;
+  std::memcpy(&header, start, sizeof(header));
+
+  char algorithm[sizeof(header.algorithm) + 1] = {};
+  std::memcpy(algorithm, header.algorithm, sizeof(header.algorithm));
+  std::size_t table_end =
+      sizeof(CacheHeader) + (key.entries + 1) * sizeof(std::uint64_t);
+
+  bool matches =
+      std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+      header.version == CACHE_VERSION && key.algorithm == algorithm &&
+      header.encoding == (std::uint32_t)key.encoding && header.k == key.k &&
+      header.entries == key.entries &&
+      header.patterns_hash == key.patterns_hash &&
+      header.layout == key.layout && header.data_offset % CACHE_LINE == 0 &&
+      header.data_offset >= table_end && header.data_offset <= length &&
+      header.data_size <= length - header.data_offset;
+  if (matches) {
+    offsets.resize(key.entries + 1);
+    std::memcpy(offsets.data(), start + sizeof(CacheHeader),
+                offsets.size() * sizeof(std::uint64_t));
+    // The entries must follow each other, within the data.
+    matches = offsets.front() == 0 &&
+              std::is_sorted(offsets.begin(), offsets.end()) &&
+              offsets.back() <= header.data_size;
+  }
+  if (!matches) {
+    release();
+    return false;
+  }
+  data = start + header.data_offset;
+
+  return true;
+}
+
+/*
+  A reader for the fields of entry `entry`.
+*/
+PatternReader PatternCache::reader(std::size_t entry) const {
+  return PatternReader(data, offsets[entry], offsets[entry + 1]);
+}
+
+/*
+  Build the cache for `key` and write it to `fname`. The file is written under
+  a temporary name and then renamed over `fname`, so that a run that is
+  interrupted (or another run reading the cache) never sees half of a file.
+  The temporary name is made unique with mkstemp(), as runs that miss the
+  same cache at once (under the harness's `-j`, say) each write their own.
+*/
+void write_cache(std::string const &fname, CacheKey const &key,
+                 PatternCache::Save const &save) {
+  PatternWriter writer;
+  std::vector<std::uint64_t> offsets;
+  for (std::size_t entry = 0; entry < key.entries; entry++) {
+    offsets.push_back(writer.size());
+    save(writer, entry);
+  }
+  offsets.push_back(writer.size());
+
+  CacheHeader header{};
+  if (key.algorithm.length() > sizeof(header.algorithm))
+    throw std::runtime_error{"Algorithm name too long for pattern cache"};
+  std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header.version = CACHE_VERSION;
+  header.encoding = key.encoding;
+  header.k = key.k;
+  header.entries = key.entries;
+  header.patterns_hash = key.patterns_hash;
+  header.layout = key.layout;
+  std::copy(key.algorithm.begin(), key.algorithm.end(), header.algorithm);
+  std::size_t table_end =
+      sizeof(CacheHeader) + offsets.size() * sizeof(std::uint64_t);
+  header.data_offset = (table_end + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+  header.data_size = writer.size();
+
+  std::string temp_name = fname + ".XXXXXX";
+  int fd = mkstemp(temp_name.data());
+  std::ofstream file;
+  if (fd != -1) {
+    // mkstemp() makes the file readable by its owner alone.
+    fchmod(fd, 0644);
+    close(fd);
+    file.open(temp_name, std::ios::binary | std::ios::trunc);
+  }
+  if (fd == -1 || !file) {
+    if (fd != -1)
+      std::remove(temp_name.c_str());
+    std::ostringstream error;
+    error << "Error opening " << temp_name << " for writing";
+    throw std::runtime_error{error.str()};
+  }
+  std::vector<char> padding(header.data_offset - table_end, '\0');
+  file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+  file.write(reinterpret_cast<char const *>(offsets.data()),
+             offsets.size() * sizeof(std::uint64_t));
+  file.write(padding.data(), padding.size());
+  file.write(writer.data(), writer.size());
+  file.close();
+  if (!file || std::rename(temp_name.c_str(), fname.c_str()) != 0) {
+    std::remove(temp_name.c_str());
+    std::ostringstream error;
+    error << "Error writing pattern cache " << fname;
+    throw std::runtime_error{error.str()};
+  }
+}
+
+/*
+  A hash of the patterns, as they are given to the algorithm (FNV-1a, over
+  each pattern's length and then its characters). This is what ties a cache
+  to the patterns file it was built from.
+*/
+std::uint64_t hash_patterns(std::vector<std::string> const &patterns) {
+  std::uint64_t hash = 0xcbf29ce484222325;
+  auto add = [&](unsigned char byte) {
+    hash ^= byte;
+    hash *= 0x100000001b3;
+  };
+
+  for (auto const &pattern : patterns) {
+    std::uint64_t length = pattern.length();
+    for (int shift = 0; shift < 64; shift += 8)
+      add(length >> shift);
+    for (char c : pattern)
+      add(c);
+  }
+
+  return hash;
+}
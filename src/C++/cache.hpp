@@ -0,0 +1,108 @@
+/*
+  Header file for the pattern cache.
+
+  A pattern cache is a file holding the preprocessed form of every pattern of
+  a run (or, for a multi-pattern algorithm, of the set of patterns), as written
+  by a PatternWriter (see `pattern.hpp`). A run given `--pattern-cache FILE`
+  maps the file into memory and reads its patterns from there, instead of
+  preprocessing them again. The tables are used in place, so loading costs
+  little more than the page faults on the parts that the search touches.
+
+  The header records what the cache was built from: the algorithm, the
+  encoding, k, a hash of the patterns, and the layout of the algorithm's
+  pattern struct in the build that wrote it (see pattern_layout() in
+  `pattern.hpp`). If any of these differ from the run's, or the file is
+  missing or of another version, the cache is built again and the file
+  replaced.
+*/
+
+#ifndef _CACHE_HPP
+#define _CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "pattern.hpp"
+
+/*
+  The layout of the start of a cache file. All fields are in the byte order
+  of the machine that wrote it (the patterns' tables are, too), so a cache is
+  not meant to be moved between machines. `offsets` (entries + 1 of them,
+  64-bit) follow the header, then the patterns from `data_offset` onwards,
+  which is a multiple of CACHE_LINE. Entry i runs from offsets[i] to
+  offsets[i + 1], relative to `data_offset`. `algorithm` is NUL-padded.
+
+  CACHE_VERSION must be raised whenever the layout of a pattern struct (or of
+  this header) changes.
+*/
+constexpr char CACHE_MAGIC[8] = {'P', 'A', 'T', 'C', 'A', 'C', 'H', 'E'};
+constexpr std::uint32_t CACHE_VERSION = 2;
+
+struct CacheHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t encoding;
+  std::int32_t k;
+  std::uint32_t entries;
+  std::uint64_t patterns_hash;
+  std::uint64_t layout;
+  char algorithm[32];
+  std::uint64_t data_offset;
+  std::uint64_t data_size;
+};
+static_assert(sizeof(CacheHeader) == 88, "CacheHeader must have no padding");
+
+/*
+  What a cache has to have been built from for a run to use it. `k` is -1 for
+  the exact-matching algorithms.
+*/
+struct CacheKey {
+  std::string algorithm;
+  int encoding;
+  int k;
+  std::uint64_t patterns_hash;
+  std::size_t entries;
+  std::uint64_t layout;
+};
+
+/*
+  An open pattern cache. The constructor maps the file if it matches `key`,
+  and otherwise calls `save(writer, entry)` for each of the key's entries to
+  build it, writes it out and maps that. reader() gives a PatternReader for an
+  entry, whose arrays point into the mapping; they are only valid for as long
+  as the cache is alive.
+*/
+class PatternCache {
+public:
+  typedef std::function<void(PatternWriter &, std::size_t)> Save;
+
+  PatternCache(std::string const &fname, CacheKey const &key,
+               Save const &save);
+  ~PatternCache();
+
+  PatternCache(PatternCache const &) = delete;
+  PatternCache &operator=(PatternCache const &) = delete;
+
+  // Whether the file had to be (re)built, rather than just loaded.
+  bool rebuilt() const { return was_rebuilt; }
+  PatternReader reader(std::size_t entry) const;
+
+private:
+  bool load(std::string const &fname, CacheKey const &key);
+  void release();
+
+  void *base = nullptr;
+  std::size_t length = 0;
+  char const *data = nullptr;
+  std::vector<std::uint64_t> offsets;
+  bool was_rebuilt = false;
+};
+
+extern void write_cache(std::string const &fname, CacheKey const &key,
+                        PatternCache::Save const &save);
+extern std::uint64_t hash_patterns(std::vector<std::string> const &patterns);
+
+#endif // !_CACHE_HPP
@@ -0,0 +1,162 @@
+/*
+  The per-phase counters described in `counters.hpp`.
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "counters.hpp"
+
+std::atomic<std::uint64_t> *allocation_count = nullptr;
+
+// The core whose MSRs are read for the energy, as in the harness. RAPL counts
+// the whole package, so any core of it would do.
+constexpr int RAPL_CORE = 0;
+
+// The names of the phases and of the events, as they are reported.
+constexpr char const *PHASE_NAMES[PHASES] = {"load", "init", "search",
+                                             "verify"};
+constexpr char const *EVENT_NAMES[EVENTS] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"};
+
+/*
+  Open the perf event of the given type and config, counting this process in
+  user space, along with the threads it starts from now on (`inherit`).
+  Returns -1 if the event can't be opened.
+*/
+static int open_event(std::uint32_t type, std::uint64_t config) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // When there are more events than hardware counters, the kernel takes
+  // turns with them; these say for how long each one was counted.
+  attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+PhaseCounters::PhaseCounters(bool enabled) : on(enabled) {
+  fds.fill(-1);
+  if (!on)
+    return;
+
+  constexpr std::uint64_t L1D_READ_MISS =
+      PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+      PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+  fds[0] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+  fds[1] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  fds[2] = open_event(PERF_TYPE_HW_CACHE, L1D_READ_MISS);
+  fds[3] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  fds[4] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+
+  // rapl_init() exits if it can't open the MSRs, so check that it can first.
+  char msr_filename[32];
+  sprintf(msr_filename, "/dev/cpu/%d/msr", RAPL_CORE);
+  rapl_reading reading;
+  has_energy = access(msr_filename, R_OK) == 0 &&
+               rapl_init(RAPL_CORE, 0) == 0 &&
+               rapl_read(RAPL_CORE, &reading) == 0;
+}
+
+PhaseCounters::~PhaseCounters() {
+  for (int fd : fds)
+    if (fd != -1)
+      close(fd);
+}
+
+/*
+  Read every counter. An event that was only counted for part of the time
+  (see open_event()) is scaled up to the whole of it.
+*/
+PhaseCounters::Reading PhaseCounters::read() const {
+  Reading reading;
+
+  for (int event = 0; event < EVENTS; event++) {
+    std::uint64_t values[3];
+    if (fds[event] == -1 ||
+        ::read(fds[event], values, sizeof(values)) != sizeof(values))
+      continue;
+    double count = values[0];
+    if (values[2] && values[2] < values[1])
+      count *= (double)values[1] / values[2];
+    reading.events[event] = count;
+  }
+  if (has_energy)
+    rapl_read(RAPL_CORE, &reading.energy);
+  if (allocation_count)
+    reading.allocations = allocation_count->load(std::memory_order_relaxed);
+  reading.time = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now().time_since_epoch())
+                     .count();
+
+  return reading;
+}
+
+void PhaseCounters::start(Phase phase) {
+  if (on)
+    started[(int)phase] = read();
+}
+
+void PhaseCounters::stop(Phase phase) {
+  if (!on)
+    return;
+
+  Reading now = read();
+  Reading const &then = started[(int)phase];
+  Totals &total = totals[(int)phase];
+  total.time += now.time - then.time;
+  for (int event = 0; event < EVENTS; event++)
+    total.events[event] += now.events[event] - then.events[event];
+  if (has_energy)
+    rapl_add_energy(&total.energy, &then.energy, &now.energy);
+  total.allocations += now.allocations - then.allocations;
+}
+
+void PhaseCounters::clear() {
+  // The input is only loaded once, before any of the iterations.
+  for (int phase = 0; phase < PHASES; phase++)
+    if (phase != (int)Phase::load)
+      totals[phase] = Totals{};
+}
+
+/*
+  Write the totals as a `counters` mapping with one line per phase, along
+  with the instructions per cycle when both were counted.
+*/
+void PhaseCounters::report(std::ostream &out) const {
+  if (!on)
+    return;
+
+  out << "counters:\n" << std::setprecision(8);
+  for (int phase = 0; phase < PHASES; phase++) {
+    Totals const &total = totals[phase];
+    out << "  " << PHASE_NAMES[phase] << ": {time: " << total.time;
+    for (int event = 0; event < EVENTS; event++)
+      if (fds[event] != -1)
+        out << ", " << EVENT_NAMES[event] << ": "
+            << (std::uint64_t)total.events[event];
+    if (fds[0] != -1 && fds[1] != -1 && total.events[0] > 0)
+      out << ", ipc: " << total.events[1] / total.events[0];
+    if (has_energy) {
+      out << ", package: " << total.energy.package
+          << ", pp0: " << total.energy.pp0;
+      if (dram_avail)
+        out << ", dram: " << total.energy.dram;
+    }
+    if (allocation_count)
+      out << ", allocations: " << total.allocations;
+    out << "}\n";
+  }
+}
@@ -0,0 +1,105 @@
+/*
+  Header file for the per-phase counters of the runners' `--counters` option.
+
+  A run is split into four phases: `load` (reading and encoding the input, and
+  opening the pattern cache), `init` (preparing the patterns), `search` (the
+  matching, along with the checks of the counts that are made as each one is
+  found) and `verify` (gathering and reporting the mismatches). For each
+  phase, the counters total the wall-clock time, the hardware events counted
+  through perf_event_open(2), and the energy read from RAPL in-process (by way
+  of `../harness/rapl.c`). The events or the energy that this machine (or the
+  user's permissions) doesn't allow are left out of the report.
+
+  In the binaries that `make alloc-check` builds, which are linked with the
+  counting operator new of `alloc_check.cpp`, the report also gives the
+  allocations made in each phase.
+*/
+
+#ifndef _COUNTERS_HPP
+#define _COUNTERS_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+#include "../harness/rapl.h"
+
+enum class Phase { load, init, search, verify };
+constexpr int PHASES = 4;
+
+// The hardware events counted: cycles, instructions, L1 data-cache read
+// misses, last-level cache misses, and mispredicted branches.
+constexpr int EVENTS = 5;
+
+// The count of the calls to operator new so far, when the binary is linked
+// with `alloc_check.cpp`, and null otherwise.
+extern std::atomic<std::uint64_t> *allocation_count;
+
+/*
+  The counters for a run. Those of a disabled PhaseCounters do nothing, so the
+  runners can start and stop the phases without checking for `--counters`.
+  The events are counted for the whole process, threads included, but only for
+  the threads started after the counters are opened; a runner has to open its
+  counters before it starts its thread pool.
+*/
+class PhaseCounters {
+public:
+  explicit PhaseCounters(bool enabled);
+  ~PhaseCounters();
+
+  PhaseCounters(PhaseCounters const &) = delete;
+  PhaseCounters &operator=(PhaseCounters const &) = delete;
+
+  bool enabled() const { return on; }
+  void start(Phase phase);
+  void stop(Phase phase);
+  // Clear the totals of all but the load phase, as `--bench` does after its
+  // warmup.
+  void clear();
+  void report(std::ostream &out) const;
+
+private:
+  // A reading of every counter at one moment.
+  struct Reading {
+    double time = 0;
+    std::array<double, EVENTS> events{};
+    rapl_reading energy{};
+    std::uint64_t allocations = 0;
+  };
+  struct Totals {
+    double time = 0;
+    std::array<double, EVENTS> events{};
+    rapl_energy energy{};
+    std::uint64_t allocations = 0;
+  };
+
+  Reading read() const;
+
+  bool on;
+  std::array<int, EVENTS> fds;
+  bool has_energy = false;
+  std::array<Reading, PHASES> started;
+  std::array<Totals, PHASES> totals;
+};
+
+/*
+  Counts the code in its scope as `phase`.
+*/
+class PhaseScope {
+public:
+  PhaseScope(PhaseCounters &counters, Phase phase)
+      : counters(counters), phase(phase) {
+    counters.start(phase);
+  }
+  ~PhaseScope() { counters.stop(phase); }
+
+  PhaseScope(PhaseScope const &) = delete;
+  PhaseScope &operator=(PhaseScope const &) = delete;
+
+private:
+  PhaseCounters &counters;
+  Phase phase;
+};
+
+#endif // !_COUNTERS_HPP
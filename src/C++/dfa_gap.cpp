@@ -3,42 +3,47 @@
   approximate string matching.
 */
 
-#include <array>
+#include <algorithm>
 #include <string>
-#include <vector>
+#include <string_view>
 
 #include "run.hpp"
 
-// Rather than implement a translation table for the four characters in the DNA
-// alphabet, for now just let the alphabet be the full ASCII range and only use
-// those four.
-constexpr int ASIZE = 128;
+// The runner encodes the four characters of the DNA alphabet as 0-3 (see
+// `alphabet.hpp`), so each state of the DFA only needs four slots.
+constexpr int ASIZE = DNA_ASIZE;
 
 // The "fail" value is used to determine when to start over.
 constexpr int FAIL = -1;
 
 /*
-  The ALPHABET/ALPHABET_COUNT values are used when setting up the transitions
-  around the "gap" states in the DFA. Since we're being lazy about translating
-  ACGT to 0-3 and using an alphabet of 128 instead, this will save some time in
-  loops during the creation of the DFA.
+  The preprocessed form of a pattern. The DFA is a single table, with the
+  transitions for state s on the characters 0-3 at dfa[s * ASIZE] onwards. The
+  original pattern is not needed for matching.
 */
-constexpr int ALPHABET_COUNT = 4;
-static const std::array<int, ALPHABET_COUNT> ALPHABET = {65, 67, 71, 84};
+struct alignas(CACHE_LINE) DfaGapPattern {
+  int m = 0;
+  int terminal = 0;
+  AlignedArray<int> dfa;
+
+  template <typename Archive> void fields(Archive &archive) {
+    archive(m, terminal, dfa);
+  }
+};
 
 void create_dfa(std::string const &pattern, int m, int k,
-                std::vector<std::vector<int>> &dfa, int &terminal) {
+                AlignedArray<int> &dfa, int &terminal) {
   // We know that the number of states will be 1 + m + k(m - 1).
   int max_states = 1 + m + k * (m - 1);
 
   // Allocate for the DFA
-  dfa.resize(max_states, std::vector<int>(ASIZE, FAIL));
+  dfa = AlignedArray<int>(max_states * ASIZE, FAIL);
 
   // Start building the DFA. Start with state 0 and iterate through the
   // characters of `pattern`.
 
   // First step: Set d(0, p_0) = state(1)
-  dfa[0][pattern[0]] = 1;
+  dfa[pattern[0]] = 1;
 
   // Start `state` and `new_state` both at 1
   int state = 1, new_state = 1;
@@ -50,19 +55,19 @@ void create_dfa(std::string const &pattern, int m, int k,
     // Move `new_state` to the next place.
     new_state++;
     // The previous `state` maps to `new_state` on `pattern[i]`
-    dfa[state][pattern[i]] = new_state;
+    dfa[state * ASIZE + pattern[i]] = new_state;
     // `last_state` is used to control setting transitions for other values
     int last_state = state;
     for (int j = 1; j <= k; j++) {
       // For each of 1..k, we start a new state for which `pattern[i]` maps to
       // `new_state`.
-      dfa[(new_state + j)][pattern[i]] = new_state;
-      for (int n = 0; n < ALPHABET_COUNT; n++) {
-        if (ALPHABET[n] == pattern[i])
+      dfa[(new_state + j) * ASIZE + pattern[i]] = new_state;
+      for (int n = 0; n < ASIZE; n++) {
+        if (n == pattern[i])
           continue;
         // Every character that isn't `pattern[i]` needs to map `last_state` to
         // this new state-value.
-        dfa[last_state][ALPHABET[n]] = new_state + j;
+        dfa[last_state * ASIZE + n] = new_state + j;
       }
       // Shift `last_state` for the next iteration.
       last_state = new_state + j;
@@ -79,37 +84,31 @@ void create_dfa(std::string const &pattern, int m, int k,
 }
 
 /*
-  Initialize the pattern given. Return a 3-element array of the DFA from
-  processing the pattern, the terminal state, and the pattern length m. The
-  original pattern will not be needed for matching.
+  Initialize the pattern given. The return value is the preprocessed pattern:
+  the DFA from processing the pattern, the terminal state, and the pattern
+  length m.
 */
-std::vector<ApproxPatternData> init_dfa_gap(std::string const &pattern, int k) {
-  std::vector<ApproxPatternData> return_val;
-  return_val.reserve(3);
+DfaGapPattern init_dfa_gap(std::string const &pattern, int k) {
+  DfaGapPattern return_val;
 
   // Set up the DFA structure for the algorithm to use:
-  int m = pattern.length();
-  int terminal;
-  std::vector<std::vector<int>> dfa;
-  create_dfa(pattern, m, k, dfa, terminal);
-
-  return_val.push_back(dfa);
-  return_val.push_back(terminal);
-  return_val.push_back(m);
+  return_val.m = pattern.length();
+  create_dfa(pattern, return_val.m, k, return_val.dfa, return_val.terminal);
 
   return return_val;
 }
 
 /*
-  Perform the DFA-Gap algorithm on the given (processed) pattern against the
-  given sequence.
+  The matching itself, for a pattern of length m, reporting each match to
+  `sink` (see `run.hpp`). This is always inlined, so that a constant m (from
+  dfa_gap_fixed(), below) is folded into the loop.
 */
-int dfa_gap(std::vector<ApproxPatternData> const &pat_data,
-            std::string const &sequence) {
-  // Unpack pat_data:
-  auto const &dfa = std::get<std::vector<std::vector<int>>>(pat_data[0]);
-  int terminal = std::get<int>(pat_data[1]);
-  int m = std::get<int>(pat_data[2]);
+template <typename Sink>
+[[gnu::always_inline]] static inline int
+dfa_gap_search(DfaGapPattern const &pat_data, int m,
+               std::string_view sequence, Sink sink) {
+  int const *dfa = pat_data.dfa.data();
+  int terminal = pat_data.terminal;
 
   int matches = 0;
   int n = sequence.length();
@@ -120,23 +119,71 @@ int dfa_gap(std::vector<ApproxPatternData> const &pat_data,
   for (int i = 0; i <= end; i++) {
     int state = 0;
     int ch = 0;
-    while ((i + ch) < n && dfa[state][sequence[i + ch]] != FAIL)
-      state = dfa[state][sequence[i + ch++]];
+    while ((i + ch) < n && dfa[state * ASIZE + sequence[i + ch]] != FAIL)
+      state = dfa[state * ASIZE + sequence[i + ch++]];
 
-    if (state == terminal)
+    if (state == terminal) {
       matches++;
+      if constexpr (Sink::reports) {
+        sink(i);
+        if (sink.full(matches))
+          break;
+      }
+    }
   }
 
   return matches;
 }
 
+/*
+  Perform the DFA-Gap algorithm on the given (processed) pattern against the
+  given sequence.
+*/
+int dfa_gap(DfaGapPattern const &pat_data, std::string_view sequence) {
+  return dfa_gap_search(pat_data, pat_data.m, sequence, CountOnly{});
+}
+
+/*
+  The matching again, specialized for a pattern length M known at compile time
+  (see `FixedLengths` in `run.hpp`). With the DFA in a single table, k no
+  longer changes the matching code, so the specializations are by M alone.
+*/
+template <int M>
+int dfa_gap_fixed(DfaGapPattern const &pat_data, std::string_view sequence) {
+  return dfa_gap_search(pat_data, M, sequence, CountOnly{});
+}
+
+/*
+  The matching again, reporting the offset of each match as well.
+*/
+int dfa_gap_locate(DfaGapPattern const &pat_data, std::string_view sequence,
+                   HitSink sink) {
+  return dfa_gap_search(pat_data, pat_data.m, sequence, sink);
+}
+
+/*
+  Return the specialized matching for patterns of length m, if there is one.
+*/
+am_algorithm<DfaGapPattern> specialize_dfa_gap(int m, int) {
+  return select_fixed(
+      m,
+      [](auto M) -> am_algorithm<DfaGapPattern> {
+        return &dfa_gap_fixed<decltype(M)::value>;
+      },
+      FixedLengths{});
+}
+
 /*
   All that is done here is call the run() function with a pointer to the
   algorithm implementation, the label for the algorithm, and the argc/argv
-  values.
+  values. The data is asked for in the DNA encoding, and the specialized
+  matching is used for the lengths that have it. The locating matching is used
+  for `--positions`.
 */
 int main(int argc, char *argv[]) {
-  int return_code = run_approx(&init_dfa_gap, &dfa_gap, "dfa_gap", argc, argv);
+  int return_code =
+      run_approx(&init_dfa_gap, &dfa_gap, "dfa_gap", argc, argv, Encoding::dna,
+                 &specialize_dfa_gap, &dfa_gap_locate);
 
   return return_code;
 }
@@ -0,0 +1,167 @@
+/*
+  DFA-Gap with the DFA built lazily, as the search reaches each state, rather
+  than whole by create_dfa() in `dfa_gap.cpp`.
+
+  The states are numbered as they are there, and as that numbering is
+  regular, any transition can be worked out from the pattern alone (see
+  `dfa_gap_states.hpp`). Most starting positions fail within the first few
+  characters, so only the states near the start are ever reached.
+
+  Each transition is worked out the first time it is followed, and kept in
+  the table (see LazyTable, below). So the preprocessing is only a copy of
+  the pattern, and the memory of the table is only that of the pages of it
+  that the search has reached. The threads of `--threads` search with the same
+  pattern at once, but two threads that follow the same transition work out
+  the same value for it, so it doesn't matter which of them stores it.
+*/
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+
+#include "dfa_gap_states.hpp"
+#include "run.hpp"
+
+// The runner encodes the four characters of the DNA alphabet as 0-3 (see
+// `alphabet.hpp`), so each state of the DFA only needs four slots.
+constexpr int ASIZE = DNA_ASIZE;
+
+// The "fail" value is used to determine when to start over. A transition
+// that hasn't been worked out yet is `UNKNOWN`, which is less than any other.
+constexpr int FAIL = DFA_GAP_FAIL;
+constexpr int UNKNOWN = -2;
+
+/*
+  The table of transitions, in the layout of create_dfa()'s, with each one
+  kept as its value less UNKNOWN. So the slots of a transition that hasn't
+  been worked out are 0, and the table can come from calloc(), for which the
+  system hands out zeroed pages as they are first touched. The value of a
+  slot is read and written through an atomic_ref, as the transitions are
+  filled in from all of the threads that are searching.
+*/
+class LazyTable {
+public:
+  LazyTable() = default;
+  explicit LazyTable(int states)
+      : slots(static_cast<int *>(std::calloc(states * ASIZE, sizeof(int)))) {
+    if (!slots)
+      throw std::bad_alloc{};
+  }
+
+  int get(int state, int c) const {
+    return std::atomic_ref<int>(slots[state * ASIZE + c])
+               .load(std::memory_order_relaxed) +
+           UNKNOWN;
+  }
+  void set(int state, int c, int next) const {
+    std::atomic_ref<int>(slots[state * ASIZE + c])
+        .store(next - UNKNOWN, std::memory_order_relaxed);
+  }
+
+private:
+  struct Free {
+    void operator()(int *ptr) const { std::free(ptr); }
+  };
+  std::unique_ptr<int[], Free> slots;
+};
+
+/*
+  The preprocessed form of a pattern: the pattern itself, which the
+  transitions are worked out from, and the table they are kept in. This has
+  no fields() for the pattern cache, as there is nothing to save: the table
+  is as empty as it is when prepared.
+*/
+struct alignas(CACHE_LINE) DfaGapLazyPattern {
+  int m = 0;
+  int k = 0;
+  int terminal = 0;
+  AlignedArray<char> pattern;
+  LazyTable table;
+};
+
+/*
+  Initialize the pattern given: only a copy of it, and the empty table for the
+  1 + m + k(m - 1) states.
+*/
+DfaGapLazyPattern init_dfa_gap_lazy(std::string const &pattern, int k) {
+  DfaGapLazyPattern return_val;
+
+  return_val.m = pattern.length();
+  return_val.k = k;
+  return_val.terminal = dfa_gap_main_state(return_val.m - 1, k);
+  return_val.pattern = AlignedArray<char>(pattern.begin(), pattern.end());
+  return_val.table = LazyTable(dfa_gap_states(return_val.m, k));
+
+  return return_val;
+}
+
+/*
+  The matching itself, as in `dfa_gap.cpp`, looking each transition up in the
+  table and working it out the first time that it isn't there.
+*/
+template <typename Sink>
+static int dfa_gap_lazy_search(DfaGapLazyPattern const &pat_data,
+                               std::string_view sequence, Sink sink) {
+  LazyTable const &table = pat_data.table;
+  int terminal = pat_data.terminal;
+
+  int matches = 0;
+  int n = sequence.length();
+
+  int end = n - pat_data.m;
+  for (int i = 0; i <= end; i++) {
+    int state = 0;
+    for (int ch = i; ch < n; ch++) {
+      int next = table.get(state, sequence[ch]);
+      // Both FAIL and UNKNOWN are negative, so a transition that is there
+      // costs a single test.
+      if (next < 0) {
+        if (next == UNKNOWN) {
+          next = dfa_gap_transition(pat_data.pattern.data(), pat_data.m,
+                                    pat_data.k, state, sequence[ch]);
+          table.set(state, sequence[ch], next);
+        }
+        if (next == FAIL)
+          break;
+      }
+      state = next;
+    }
+
+    if (state == terminal) {
+      matches++;
+      if constexpr (Sink::reports) {
+        sink(i);
+        if (sink.full(matches))
+          break;
+      }
+    }
+  }
+
+  return matches;
+}
+
+int dfa_gap_lazy(DfaGapLazyPattern const &pat_data,
+                 std::string_view sequence) {
+  return dfa_gap_lazy_search(pat_data, sequence, CountOnly{});
+}
+
+int dfa_gap_lazy_locate(DfaGapLazyPattern const &pat_data,
+                        std::string_view sequence, HitSink sink) {
+  return dfa_gap_lazy_search(pat_data, sequence, sink);
+}
+
+/*
+  All that is done here is call the run() function with the argc/argv values,
+  asking for the data in the DNA encoding, and with the locating matching for
+  `--positions`.
+*/
+int main(int argc, char *argv[]) {
+  int return_code = run_approx(&init_dfa_gap_lazy, &dfa_gap_lazy,
+                               "dfa_gap_lazy", argc, argv, Encoding::dna,
+                               nullptr, &dfa_gap_lazy_locate);
+
+  return return_code;
+}
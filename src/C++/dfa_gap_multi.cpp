@@ -0,0 +1,320 @@
+/*
+  A multi-pattern form of DFA-Gap, for approximate matching of a whole set of
+  patterns in a single pass over each sequence.
+
+  The patterns are merged into a trie, as in Aho-Corasick. Each node u of the
+  trie stands for the patterns that begin with the characters leading to it,
+  and (at each starting position in the sequence) all of those patterns are
+  in the same state of their own DFA-Gap automaton until they part. So rather
+  than running one automaton per pattern, the states are kept per node: the
+  state "(u, j, mask)" has matched u, spent j gaps since, and is waiting for
+  the children of u whose characters are in `mask`.
+
+  On a character c, a state whose mask has c enters that child (with no gaps
+  spent, waiting for all of its children), and the children still waiting
+  spend a gap (if j < k). A gap is any character other than the one waited
+  for, just as in `dfa_gap.cpp`. So each state goes to at most two states,
+  which are looked up in a single table. As the states reached are those of
+  the single-pattern automata, merged where the patterns have not yet parted,
+  the counts are the same as those of dfa_gap, pattern by pattern.
+*/
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "run.hpp"
+
+// The runner encodes the four characters of the DNA alphabet as 0-3 (see
+// `alphabet.hpp`), so each node of the trie has at most four children.
+constexpr int ASIZE = DNA_ASIZE;
+
+// The "fail" value marks a transition that goes nowhere.
+constexpr int FAIL = -1;
+
+// The mask with all four characters in it.
+constexpr int ALL_CHARACTERS = (1 << ASIZE) - 1;
+
+// The flags in the low bits of a transition that enters a node: whether the
+// node has patterns that end there, and whether the state entered waits for
+// anything (a leaf of the trie does not). The state is the rest. With neither
+// flag, there is nothing to do, so a child that isn't there is just 0.
+constexpr int HAS_OUTPUT = 1;
+constexpr int IS_LIVE = 2;
+constexpr int FLAG_BITS = 2;
+
+/*
+  The preprocessed form of the set of patterns. The transitions of state s on
+  the character c are next_fn[(s * ASIZE + c) * 2], the child entered (with
+  the flags above), and next_fn[(s * ASIZE + c) * 2 + 1], the state that goes
+  on spending gaps. The patterns that end at the node a state enters are given
+  by the output function, in the same CSR form as that of `aho_corasick.cpp`.
+  `shortest` is the length of the shortest pattern, and `most_live` the most
+  states that can be live at once (one per node of the trie).
+*/
+struct alignas(CACHE_LINE) DfaGapMultiPattern {
+  int patterns_count = 0;
+  int start = 0;
+  int shortest = 0;
+  int most_live = 0;
+  AlignedArray<int> next_fn;
+  AlignedArray<int> out_offsets;
+  AlignedArray<int> out_indices;
+
+  template <typename Archive> void fields(Archive &archive) {
+    archive(patterns_count, start, shortest, most_live, next_fn, out_offsets,
+            out_indices);
+  }
+};
+
+/*
+  The trie of the patterns. The children of node u are at children[u * ASIZE]
+  onwards, and `endings` lists the patterns that end at each node.
+*/
+struct Trie {
+  std::vector<int> children;
+  std::vector<std::vector<int>> endings;
+};
+
+Trie build_trie(std::vector<std::string> const &patterns) {
+  Trie trie;
+  trie.children.assign(ASIZE, FAIL);
+  trie.endings.resize(1);
+
+  for (int idx = 0; idx < (int)patterns.size(); idx++) {
+    int node = 0;
+    for (char c : patterns[idx]) {
+      if (trie.children[node * ASIZE + c] == FAIL) {
+        trie.children[node * ASIZE + c] = trie.endings.size();
+        trie.children.resize(trie.children.size() + ASIZE, FAIL);
+        trie.endings.emplace_back();
+      }
+      node = trie.children[node * ASIZE + c];
+    }
+    trie.endings[node].push_back(idx);
+  }
+
+  return trie;
+}
+
+/*
+  Build the states that can be reached from the root, numbering them as they
+  are found. The root spends no gaps, as a match can't start with one, which
+  is the same as it having spent all k of them already.
+*/
+void build_states(Trie const &trie, int k, DfaGapMultiPattern &pat_data) {
+  // The mask of the characters that node u has children for.
+  auto children_of = [&](int u) {
+    int mask = 0;
+    for (int c = 0; c < ASIZE; c++)
+      if (trie.children[u * ASIZE + c] != FAIL)
+        mask |= 1 << c;
+    return mask;
+  };
+
+  // The states found, as (node, gaps, mask), and their numbers.
+  struct State {
+    int node;
+    int gaps;
+    int mask;
+  };
+  std::vector<State> states;
+  std::unordered_map<long, int> numbers;
+  auto number = [&](int node, int gaps, int mask) {
+    long key = ((long)node * (k + 1) + gaps) * (ALL_CHARACTERS + 1) + mask;
+    auto [at, added] = numbers.try_emplace(key, states.size());
+    if (added)
+      states.push_back({node, gaps, mask});
+    return at->second;
+  };
+
+  std::vector<int> next_fn;
+  pat_data.start = number(0, k, children_of(0));
+  // The states are numbered in the order they are found, so this visits each
+  // of them once, breadth-first.
+  for (std::size_t s = 0; s < states.size(); s++) {
+    State state = states[s];
+    for (int c = 0; c < ASIZE; c++) {
+      int enter = FAIL, wait = FAIL;
+      int rest = state.mask & ~(1 << c);
+      if (state.mask & (1 << c)) {
+        int child = trie.children[state.node * ASIZE + c];
+        enter = number(child, 0, children_of(child));
+      }
+      if (state.gaps < k && rest)
+        wait = number(state.node, state.gaps + 1, rest);
+      next_fn.push_back(enter);
+      next_fn.push_back(wait);
+    }
+  }
+
+  // Renumber the states in the order of their nodes, and by the gaps spent
+  // within a node. A pattern's states are then together in the table, which
+  // matters once the table no longer fits in cache: the path through them is
+  // for the most part the gaps at one node, then the next node.
+  std::vector<int> order(states.size()), renumber(states.size());
+  for (std::size_t s = 0; s < states.size(); s++)
+    order[s] = s;
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    return std::tie(states[a].node, states[a].gaps, states[a].mask) <
+           std::tie(states[b].node, states[b].gaps, states[b].mask);
+  });
+  for (std::size_t s = 0; s < states.size(); s++)
+    renumber[order[s]] = s;
+  std::vector<int> sorted_fn(next_fn.size());
+  std::vector<State> sorted_states(states.size());
+  for (std::size_t s = 0; s < states.size(); s++) {
+    sorted_states[renumber[s]] = states[s];
+    for (int t = 0; t < ASIZE * 2; t++) {
+      int to = next_fn[s * ASIZE * 2 + t];
+      sorted_fn[renumber[s] * ASIZE * 2 + t] = to == FAIL ? FAIL : renumber[to];
+    }
+  }
+  next_fn.swap(sorted_fn);
+  states.swap(sorted_states);
+  pat_data.start = renumber[pat_data.start];
+
+  // Only the states with no gaps spent are entered, so only those can have
+  // patterns in the output function.
+  std::vector<int> out_offsets(states.size() + 1, 0), out_indices;
+  for (std::size_t s = 0; s < states.size(); s++) {
+    if (states[s].gaps == 0 && (int)s != pat_data.start) {
+      auto const &endings = trie.endings[states[s].node];
+      out_indices.insert(out_indices.end(), endings.begin(), endings.end());
+    }
+    out_offsets[s + 1] = out_indices.size();
+  }
+
+  // Now that every state is known, flag the transitions that enter a node.
+  for (std::size_t t = 0; t < next_fn.size(); t += 2) {
+    int s = next_fn[t];
+    if (s == FAIL) {
+      next_fn[t] = 0;
+      continue;
+    }
+    next_fn[t] = s << FLAG_BITS;
+    if (out_offsets[s] != out_offsets[s + 1])
+      next_fn[t] |= HAS_OUTPUT;
+    if (states[s].mask)
+      next_fn[t] |= IS_LIVE;
+  }
+
+  pat_data.next_fn = AlignedArray<int>(next_fn.begin(), next_fn.end());
+  pat_data.out_offsets =
+      AlignedArray<int>(out_offsets.begin(), out_offsets.end());
+  pat_data.out_indices =
+      AlignedArray<int>(out_indices.begin(), out_indices.end());
+}
+
+/*
+  Initialize the structure for the set of patterns and k: the trie, and from
+  it the table of states.
+*/
+DfaGapMultiPattern
+init_dfa_gap_multi(std::vector<std::string> const &patterns_data, int k) {
+  DfaGapMultiPattern return_val;
+
+  return_val.patterns_count = patterns_data.size();
+  return_val.shortest = 0;
+  for (auto const &pattern : patterns_data)
+    if (!return_val.shortest || (int)pattern.length() < return_val.shortest)
+      return_val.shortest = pattern.length();
+  Trie trie = build_trie(patterns_data);
+  return_val.most_live = trie.endings.size();
+  build_states(trie, k, return_val);
+
+  return return_val;
+}
+
+/*
+  Match all of the patterns against the given sequence, filling `matches`
+  with the count for each. From each starting position, the states that are
+  still alive are followed until there are none; a pattern matches from there
+  if the node it ends at is entered. Each match is reported to `sink` (see
+  `run.hpp`) at the offset where it starts.
+*/
+template <typename Sink>
+static void dfa_gap_multi_search(DfaGapMultiPattern const &pat_data,
+                                 std::string_view sequence,
+                                 std::vector<int> &matches, Sink sink) {
+  int pattern_count = pat_data.patterns_count;
+  int const *next_fn = pat_data.next_fn.data();
+  int const *out_offsets = pat_data.out_offsets.data();
+  int const *out_indices = pat_data.out_indices.data();
+
+  int n = sequence.length();
+  matches.assign(pattern_count, 0);
+  [[maybe_unused]] int full = 0; // The patterns that need no more matches
+  // The live states, before and after each character. There is never more
+  // than one state per node, as each pattern is in one state at a time. The
+  // buffer is kept from call to call, so the search doesn't allocate.
+  thread_local std::vector<int> buffer;
+  buffer.resize(2 * pat_data.most_live);
+  int *live = buffer.data(), *next = live + pat_data.most_live;
+
+  int end = n - pat_data.shortest;
+  for (int i = 0; i <= end; i++) {
+    live[0] = pat_data.start;
+    int live_count = 1;
+    for (int ch = i; ch < n && live_count; ch++) {
+      int c = sequence[ch];
+      int next_count = 0;
+      for (int l = 0; l < live_count; l++) {
+        int const *to = &next_fn[(live[l] * ASIZE + c) * 2];
+        int enter = to[0] >> FLAG_BITS;
+        if (to[0] & HAS_OUTPUT) {
+          for (int o = out_offsets[enter]; o < out_offsets[enter + 1]; o++) {
+            int pattern = out_indices[o];
+            if constexpr (Sink::reports) {
+              // As in aho_corasick(): a full pattern is no longer counted,
+              // and the search ends once all of them are full.
+              if (sink.full(matches[pattern]))
+                continue;
+              matches[pattern]++;
+              sink.at(pattern, i);
+              if (sink.full(matches[pattern]) && ++full == pattern_count)
+                return;
+            } else
+              matches[pattern]++;
+          }
+        }
+        if (to[0] & IS_LIVE)
+          next[next_count++] = enter;
+        if (to[1] != FAIL)
+          next[next_count++] = to[1];
+      }
+      std::swap(live, next);
+      live_count = next_count;
+    }
+  }
+
+  return;
+}
+
+void dfa_gap_multi(DfaGapMultiPattern const &pat_data,
+                   std::string_view sequence, std::vector<int> &matches) {
+  dfa_gap_multi_search(pat_data, sequence, matches, CountOnly{});
+}
+
+void dfa_gap_multi_locate(DfaGapMultiPattern const &pat_data,
+                          std::string_view sequence, std::vector<int> &matches,
+                          HitSink sink) {
+  dfa_gap_multi_search(pat_data, sequence, matches, sink);
+}
+
+/*
+  All that is done here is call the run() function with the argc/argv values,
+  asking for the data in the DNA encoding, and with the locating search for
+  `--positions`.
+*/
+int main(int argc, char *argv[]) {
+  int return_code =
+      run_multi_approx(&init_dfa_gap_multi, &dfa_gap_multi, "dfa_gap_multi",
+                       argc, argv, Encoding::dna, &dfa_gap_multi_locate);
+
+  return return_code;
+}
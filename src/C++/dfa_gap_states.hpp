@@ -0,0 +1,63 @@
+/*
+  Header file for the numbering of the states of the DFA-Gap automaton, as
+  create_dfa() in `dfa_gap.cpp` builds them, for the forms of the algorithm
+  that work out each transition from the pattern rather than build the whole
+  table: `dfa_gap_lazy.cpp`, and `dfa_gap_sycl.cpp` on an offload device.
+  These are plain functions of the pattern, so that they also compile as
+  device code.
+
+  0 is the start, and the state that has matched the first i + 1 characters
+  of the pattern is main(i), with main(0) = 1 and main(i) = 2 + (i - 1)(k + 1).
+  The k states after main(i), main(i) + j, have matched the first i
+  characters and spent j gaps waiting for the next one. The terminal state is
+  main(m - 1).
+*/
+
+#ifndef _DFA_GAP_STATES_HPP
+#define _DFA_GAP_STATES_HPP
+
+// The value of a transition that goes nowhere, as in `dfa_gap.cpp`.
+constexpr int DFA_GAP_FAIL = -1;
+
+/*
+  The state that has matched the first i + 1 characters of the pattern.
+*/
+inline int dfa_gap_main_state(int i, int k) {
+  return i == 0 ? 1 : 2 + (i - 1) * (k + 1);
+}
+
+/*
+  The number of states of the automaton for a pattern of length m.
+*/
+inline int dfa_gap_states(int m, int k) { return 1 + m + k * (m - 1); }
+
+/*
+  The transition from `state` on `c`, for the pattern of length m, as
+  create_dfa() would have made it.
+*/
+inline int dfa_gap_transition(char const *pattern, int m, int k, int state,
+                              int c) {
+  if (state == 0)
+    return c == pattern[0] ? 1 : DFA_GAP_FAIL;
+  if (state == dfa_gap_main_state(m - 1, k))
+    return DFA_GAP_FAIL;
+
+  // The number i of the main state at or before `state`, and the gaps spent
+  // since.
+  int i = state == 1 ? 0 : 1 + (state - 2) / (k + 1);
+  int j = state == 1 ? 0 : (state - 2) % (k + 1);
+  if (j == 0) {
+    // A main state waits for the next character, and otherwise spends the
+    // first gap in the states before the next main state.
+    if (c == pattern[i + 1])
+      return dfa_gap_main_state(i + 1, k);
+    return k ? dfa_gap_main_state(i + 1, k) + 1 : DFA_GAP_FAIL;
+  }
+  // A gap state waits for the character of its main state, and otherwise
+  // spends another gap if it can.
+  if (c == pattern[i])
+    return dfa_gap_main_state(i, k);
+  return j < k ? state + 1 : DFA_GAP_FAIL;
+}
+
+#endif // !_DFA_GAP_STATES_HPP
@@ -0,0 +1,62 @@
+/*
+  DFA-Gap (see `dfa_gap.cpp`) as a batch matcher, matching every pattern
+  against every sequence at once on an offload device (see `sycl_batch.hpp`).
+
+  Rather than copy each pattern's DFA over, a work-item works out each
+  transition from the pattern as it goes (see `dfa_gap_states.hpp`). That is
+  a few integer operations in place of a load from the device's memory, and
+  the table for a pattern is only the pattern itself.
+*/
+
+#include <string>
+#include <vector>
+
+#include "dfa_gap_states.hpp"
+#include "sycl_batch.hpp"
+
+struct DfaGapSycl {
+  using Word = char;
+
+  static void prepare(std::string const &pattern, int,
+                      std::vector<Word> &table) {
+    table.insert(table.end(), pattern.begin(), pattern.end());
+  }
+
+  /*
+    As in dfa_gap_search(): the automaton is run from each starting position
+    until it fails, and there is a match where it has reached the terminal
+    state.
+  */
+  static int count(Word const *pattern, int m, int k, char const *sequence,
+                   int n) {
+    int terminal = dfa_gap_main_state(m - 1, k);
+    int matches = 0;
+
+    for (int i = 0; i <= n - m; i++) {
+      int state = 0;
+      for (int ch = i; ch < n; ch++) {
+        int next = dfa_gap_transition(pattern, m, k, state, sequence[ch]);
+        if (next == DFA_GAP_FAIL)
+          break;
+        state = next;
+      }
+      if (state == terminal)
+        matches++;
+    }
+
+    return matches;
+  }
+};
+
+/*
+  All that is done here is call the batch runner with the argc/argv values,
+  asking for the data in the DNA encoding, and for the k of an approximate
+  match.
+*/
+int main(int argc, char *argv[]) {
+  SyclBatchMatcher<DfaGapSycl> matcher;
+  int return_code = run_batch_matcher(matcher, "dfa_gap_sycl", argc, argv,
+                                      Encoding::dna, true);
+
+  return return_code;
+}
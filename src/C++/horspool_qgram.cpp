@@ -0,0 +1,174 @@
+/*
+  Implementation of a q-gram variant of the Boyer-Moore-Horspool algorithm.
+
+  Horspool shifts each window by the last character of the window. On the DNA
+  alphabet most of those characters occur near the end of the pattern, so the
+  shifts are short. Here the shift is taken from the last q characters of the
+  window instead, which for a large enough q only rarely occur in the pattern
+  at all, giving shifts close to m - q + 1. This follows the "HASHq" algorithm
+  of T. Lecroq, "Fast exact string matching algorithms," Information
+  Processing Letters 102(6), 2007, except that with the DNA encoding (2 bits
+  per character) a q-gram of up to 8 characters is its own hash value, so no
+  two q-grams ever share a table entry.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "run.hpp"
+
+// The runner encodes the DNA alphabet as 0-3 (see `alphabet.hpp`), so each
+// character is 2 bits of a q-gram's value.
+constexpr int BITS = 2;
+
+// The range of q. A table for q = 8 has 4^8 (65536) entries.
+constexpr int MIN_Q = 2;
+constexpr int MAX_Q = 8;
+
+/*
+  The preprocessed form of a pattern.
+*/
+struct alignas(CACHE_LINE) HorspoolQgramPattern {
+  int m = 0;
+  int q = 0;
+  int last_shift = 0;
+  AlignedArray<char> pattern;
+  AlignedArray<int> shift;
+
+  template <typename Archive> void fields(Archive &archive) {
+    archive(m, q, last_shift, pattern, shift);
+  }
+};
+
+/*
+  Choose q for a pattern of length m. Longer patterns need longer q-grams for
+  the q-grams of the text to be unlikely to occur in them: roughly log4(m) + 2
+  characters, within the range above and never more than m.
+*/
+int choose_q(int m) {
+  int q = MIN_Q;
+  for (int len = 4; len <= m && q < MAX_Q; len *= 4)
+    q++;
+
+  return std::min(q, m);
+}
+
+/*
+  The value of the q-gram of `text` that ends at position `end`.
+*/
+static inline int qgram(char const *text, int end, int q) {
+  int value = 0;
+  for (int i = end - q + 1; i <= end; i++)
+    value = (value << BITS) | text[i];
+
+  return value;
+}
+
+/*
+  Preprocessing step: calculate the shift for every q-gram. A q-gram that ends
+  at position i of the pattern (other than the last) gives a shift of m - 1 -
+  i, and any q-gram not in the pattern gives the full m - q + 1. The shift for
+  the pattern's own last q-gram is returned, and its entry is set to 0 so that
+  the search knows when to verify the window.
+*/
+int calc_shifts(std::string const &pat, int m, int q,
+                AlignedArray<int> &shift) {
+  for (int i = q - 1; i < m - 1; i++)
+    shift[qgram(pat.data(), i, q)] = m - 1 - i;
+
+  int last = qgram(pat.data(), m - 1, q);
+  int last_shift = shift[last];
+  shift[last] = 0;
+
+  return last_shift;
+}
+
+/*
+  Initialize the structure for the q-gram Horspool. Here, that means choosing
+  q and setting up the shift table. The return value is the preprocessed
+  pattern.
+*/
+HorspoolQgramPattern init_horspool_qgram(std::string const &pattern) {
+  HorspoolQgramPattern return_val;
+  int m = pattern.length();
+  int q = choose_q(m);
+  return_val.m = m;
+  return_val.q = q;
+  return_val.pattern = AlignedArray<char>(pattern.begin(), pattern.end());
+  // Declare and initialize the shift table:
+  return_val.shift = AlignedArray<int>(1 << (BITS * q), m - q + 1);
+
+  return_val.last_shift = calc_shifts(pattern, m, q, return_val.shift);
+
+  return return_val;
+}
+
+/*
+  Perform the q-gram Horspool algorithm on the given pattern of length m,
+  against the sequence of length n, reporting each match to `sink` (see
+  `run.hpp`).
+*/
+template <typename Sink>
+[[gnu::always_inline]] static inline int
+horspool_qgram_search(HorspoolQgramPattern const &pat_data,
+                      std::string_view sequence, Sink sink) {
+  int matches = 0;
+
+  char const *pattern = pat_data.pattern.data();
+  int const *shift = pat_data.shift.data();
+  int q = pat_data.q;
+  int last_shift = pat_data.last_shift;
+
+  // Get the size of the pattern and the sequence.
+  int m = pat_data.m;
+  int n = sequence.length();
+  char const *text = sequence.data();
+
+  // Perform the searching. The last q characters of a window with a shift of
+  // 0 are known to match, so only the rest of it needs comparing.
+  int j = 0;
+  while (j <= n - m) {
+    int s = shift[qgram(text, j + m - 1, q)];
+    if (s == 0) {
+      if (std::memcmp(pattern, text + j, m - q) == 0) {
+        matches++;
+        if constexpr (Sink::reports) {
+          sink(j);
+          if (sink.full(matches))
+            break;
+        }
+      }
+      j += last_shift;
+    } else {
+      j += s;
+    }
+  }
+
+  return matches;
+}
+
+int horspool_qgram(HorspoolQgramPattern const &pat_data,
+                   std::string_view sequence) {
+  return horspool_qgram_search(pat_data, sequence, CountOnly{});
+}
+
+int horspool_qgram_locate(HorspoolQgramPattern const &pat_data,
+                          std::string_view sequence, HitSink sink) {
+  return horspool_qgram_search(pat_data, sequence, sink);
+}
+
+/*
+  All that is done here is call the run() function with a pointer to the
+  algorithm implementation, the label for the algorithm, and the argc/argv
+  values. The data is asked for in the DNA encoding. There are no specialized
+  searches, but there is a locating one for `--positions`.
+*/
+int main(int argc, char *argv[]) {
+  int return_code =
+      run(&init_horspool_qgram, &horspool_qgram, "horspool_qgram", argc, argv,
+          Encoding::dna, nullptr, &horspool_qgram_locate);
+
+  return return_code;
+}
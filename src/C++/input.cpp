@@ -3,122 +3,799 @@
   return viable data structures.
 */
 
-#include <fstream>
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <vector>
 
+#include "alphabet.hpp"
 #include "input.hpp"
 
 /*
-  Read the numbers from the first line of the file pointed to by `input`. Store
-  them in a vector of int and return it.
+  Parse the space-separated numbers in the header line `line`. Store them in a
+  vector of int and return it.
 */
-std::vector<int> read_header(std::ifstream &input) {
-  std::string line;
+std::vector<int> parse_header(std::string_view line) {
   std::vector<int> ints;
+  char const *p = line.data();
+  char const *end = p + line.size();
 
-  std::getline(input, line);
-  std::istringstream ss(std::move(line));
+  while (p < end) {
+    if (*p == ' ') {
+      p++;
+      continue;
+    }
 
-  for (std::string value; std::getline(ss, value, ' ');) {
-    ints.push_back(std::stoi(value));
+    int value;
+    auto [next, ec] = std::from_chars(p, end, value);
+    if (ec != std::errc())
+      throw std::runtime_error{"Malformed header line"};
+    ints.push_back(value);
+    p = next;
   }
 
   return ints;
 }
 
 /*
-  Read the sequence data from the given filename. Return it as a vector of
-  std::string.
+  Check whether the first bytes of an answers file, `data`, are the header of
+  the binary format, and if so copy it into `header`. `file_size` is the size
+  of the whole file, which must be large enough for the table the header
+  describes.
+*/
+static bool binary_answers(std::string const &fname, char const *data,
+                           std::size_t file_size, AnswersHeader &header) {
+  if (file_size < ANSWERS_HEADER_SIZE ||
+      std::memcmp(data, ANSWERS_MAGIC, sizeof(ANSWERS_MAGIC)) != 0)
+    return false;
+
+  // The counts are used in place, so they have to be in the host's order.
+  if constexpr (std::endian::native != std::endian::little)
+    throw std::runtime_error{"Binary answers files need a little-endian host"};
+
+  std::memcpy(&header, data, sizeof(header));
+  if (header.version != ANSWERS_VERSION) {
+    std::ostringstream error;
+    error << fname << ": unsupported answers version " << header.version;
+    throw std::runtime_error{error.str()};
+  }
+  std::size_t table_size =
+      (std::size_t)header.rows * header.columns * sizeof(std::int32_t);
+  if (file_size < ANSWERS_HEADER_SIZE + table_size) {
+    std::ostringstream error;
+    error << fname << ": answers table is truncated";
+    throw std::runtime_error{error.str()};
+  }
+
+  return true;
+}
+
+/*
+  Map the sequence data from the given filename into memory, and index the
+  lines of it as std::string_view slices.
 
   The first line indicates the number of data-lines and their maximum length:
 
     100000 1040
 
   Here, the max-length is not used. Simply compare the number of lines of data
-  read to the first integer from the first line.
+  found to the first integer from the first line. Lines are split the same way
+  std::getline would split them, so a final newline does not add an empty
+  sequence at the end.
+
+  The indexing pass touches every page of the mapping, so the whole file is
+  resident by the time the constructor returns and no page faults land inside
+  the timed region of the runners.
 */
-std::vector<std::string> read_sequences(std::string fname) {
-  std::ifstream input{fname};
-  if (!input.is_open()) {
+SequenceStore::SequenceStore(std::string const &fname) {
+  int fd = open(fname.c_str(), O_RDONLY);
+  if (fd == -1) {
     std::ostringstream error;
     error << "Error opening " << fname << " for reading";
     throw std::runtime_error{error.str()};
   }
 
-  std::vector<int> ints = read_header(input);
-  unsigned int num_lines = ints[0];
+  struct stat info;
+  if (fstat(fd, &info) == -1) {
+    close(fd);
+    std::ostringstream error;
+    error << "Error reading size of " << fname;
+    throw std::runtime_error{error.str()};
+  }
+  length = info.st_size;
 
-  std::vector<std::string> data;
-  for (std::string line; std::getline(input, line);) {
-    data.push_back(std::move(line));
+  // A zero-length mapping is an error to mmap(), so only map non-empty files.
+  // An empty file will fail the header check below.
+  if (length > 0) {
+    base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) {
+      base = nullptr;
+      close(fd);
+      std::ostringstream error;
+      error << "Error mapping " << fname << " into memory";
+      throw std::runtime_error{error.str()};
+    }
   }
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+
+  try {
+    char const *data = static_cast<char const *>(base);
+    char const *end = data + length;
 
-  if (data.size() != num_lines) {
+    std::vector<int> ints;
+    char const *eol = end;
+    if (length > 0) {
+      eol = static_cast<char const *>(std::memchr(data, '\n', length));
+      if (eol == nullptr)
+        eol = end;
+      ints = parse_header(std::string_view(data, eol - data));
+    }
+    if (ints.empty()) {
+      std::ostringstream error;
+      error << fname << ": missing header line";
+      throw std::runtime_error{error.str()};
+    }
+    unsigned int num_lines = ints[0];
+    // The header is only checked once the lines are counted, so the reserve
+    // is capped by the most lines that the rest of the file can hold.
+    sequences.reserve(std::min<std::size_t>(num_lines, end - eol));
+
+    for (char const *line = eol + 1; line < end; line = eol + 1) {
+      eol = static_cast<char const *>(std::memchr(line, '\n', end - line));
+      if (eol == nullptr)
+        eol = end;
+      sequences.emplace_back(line, eol - line);
+    }
+
+    if (sequences.size() != num_lines) {
+      std::ostringstream error;
+      error << fname << ": wrong number of lines read";
+      throw std::runtime_error{error.str()};
+    }
+  } catch (...) {
+    // The destructor won't run for a partially-constructed object.
+    if (base != nullptr)
+      munmap(base, length);
+    throw;
+  }
+}
+
+SequenceStore::~SequenceStore() {
+  if (base != nullptr)
+    munmap(base, length);
+}
+
+SequenceStore::SequenceStore(SequenceStore &&other) noexcept
+    : base(other.base), length(other.length),
+      sequences(std::move(other.sequences)),
+      encoded_data(std::move(other.encoded_data)),
+      is_encoded(other.is_encoded) {
+  other.base = nullptr;
+  other.length = 0;
+}
+
+SequenceStore &SequenceStore::operator=(SequenceStore &&other) noexcept {
+  if (this != &other) {
+    if (base != nullptr)
+      munmap(base, length);
+    base = other.base;
+    length = other.length;
+    sequences = std::move(other.sequences);
+    encoded_data = std::move(other.encoded_data);
+    is_encoded = other.is_encoded;
+    other.base = nullptr;
+    other.length = 0;
+  }
+
+  return *this;
+}
+
+/*
+  Replace the sequence data with its DNA encoding. The encoded sequences are
+  laid out back-to-back in a buffer owned by the store, and the views are
+  re-pointed at it. The file mapping is no longer needed after that.
+*/
+void SequenceStore::encode() {
+  if (is_encoded)
+    return;
+
+  std::size_t total = 0;
+  for (auto const &sequence : sequences)
+    total += sequence.size();
+  encoded_data.resize(total);
+
+  char *out = encoded_data.data();
+  for (auto &sequence : sequences) {
+    encode_dna(sequence, out);
+    sequence = std::string_view(out, sequence.size());
+    out += sequence.size();
+  }
+
+  if (base != nullptr) {
+    munmap(base, length);
+    base = nullptr;
+    length = 0;
+  }
+  is_encoded = true;
+}
+
+/*
+  Open a sequences file for streaming, and read its header line. The thread
+  that reads the chunks is started here, so the first chunk is already on its
+  way by the time the constructor returns.
+*/
+SequenceStream::SequenceStream(std::string const &fname,
+                               std::size_t chunk_bytes, bool encode)
+    : fname(fname), chunk_bytes(std::max<std::size_t>(chunk_bytes, 1)),
+      encode(encode) {
+  fd = open(fname.c_str(), O_RDONLY);
+  if (fd == -1) {
+    std::ostringstream error;
+    error << "Error opening " << fname << " for reading";
+    throw std::runtime_error{error.str()};
+  }
+
+  // Read up to the end of the header line. Whatever comes after it is the
+  // start of the first chunk.
+  char *eol = nullptr;
+  while (!eol) {
+    char block[4096];
+    ssize_t got = read(fd, block, sizeof(block));
+    if (got <= 0)
+      break;
+    carry.insert(carry.end(), block, block + got);
+    eol = static_cast<char *>(std::memchr(carry.data(), '\n', carry.size()));
+  }
+  std::size_t header_end = eol ? eol - carry.data() : carry.size();
+  std::vector<int> ints;
+  try {
+    ints = parse_header(std::string_view(carry.data(), header_end));
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+  if (ints.empty()) {
+    close(fd);
+    std::ostringstream error;
+    error << fname << ": missing header line";
+    throw std::runtime_error{error.str()};
+  }
+  count = ints[0];
+  carry.erase(carry.begin(), carry.begin() + std::min(header_end + 1,
+                                                      carry.size()));
+
+  thread = std::thread(&SequenceStream::reader, this);
+}
+
+SequenceStream::~SequenceStream() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  changed.notify_all();
+
+  if (thread.joinable())
+    thread.join();
+  close(fd);
+}
+
+/*
+  Read the next chunk of whole lines into `chunk`, reusing its storage. The
+  return value is false once the end of the file has been reached (the chunk
+  may still hold the last of the lines).
+*/
+bool SequenceStream::fill(SequenceChunk &chunk) {
+  std::vector<char> &data = chunk.data;
+  data.assign(carry.begin(), carry.end());
+  carry.clear();
+
+  // Read until there is a chunk's worth of data, and at least one whole line.
+  bool at_end = false;
+  bool whole_line = std::memchr(data.data(), '\n', data.size()) != nullptr;
+  while (!at_end && (data.size() < chunk_bytes || !whole_line)) {
+    std::size_t have = data.size();
+    std::size_t want = have < chunk_bytes ? chunk_bytes - have : chunk_bytes;
+    data.resize(have + want);
+    ssize_t got = read(fd, data.data() + have, want);
+    if (got < 0) {
+      std::ostringstream error;
+      error << "Error reading " << fname;
+      throw std::runtime_error{error.str()};
+    }
+    data.resize(have + got);
+    at_end = got == 0;
+    whole_line =
+        whole_line || std::memchr(data.data() + have, '\n', got) != nullptr;
+  }
+
+  // A partial line at the end is kept for the next chunk, unless this is the
+  // end of the file. As with the SequenceStore, a final newline does not make
+  // an empty sequence at the end.
+  char *begin = data.data();
+  char *end = begin + data.size();
+  if (!at_end) {
+    char *last = begin + data.size();
+    while (last > begin && last[-1] != '\n')
+      last--;
+    carry.assign(last, end);
+    end = last;
+  }
+
+  chunk.sequences.clear();
+  for (char *line = begin; line < end;) {
+    char *eol = static_cast<char *>(std::memchr(line, '\n', end - line));
+    if (eol == nullptr)
+      eol = end;
+    if (encode)
+      encode_dna(std::string_view(line, eol - line), line);
+    chunk.sequences.emplace_back(line, eol - line);
+    line = eol + 1;
+  }
+  chunk.first = lines_read;
+  lines_read += chunk.sequences.size();
+
+  if (at_end && lines_read != count) {
     std::ostringstream error;
     error << fname << ": wrong number of lines read";
     throw std::runtime_error{error.str()};
   }
 
-  return data;
+  return !at_end;
 }
 
 /*
-  Read the pattern data from the given filename. For now, the pattern data is
-  the same format as the sequence data so just fall through to read_sequences.
+  The body of the reading thread. Each chunk is read into a buffer of the
+  thread's own, which is then swapped with the (empty) ready one, once the
+  caller has taken the last chunk from there.
 */
-std::vector<std::string> read_patterns(std::string fname) {
-  return read_sequences(fname);
+void SequenceStream::reader() {
+  SequenceChunk back;
+
+  try {
+    for (bool more = true; more;) {
+      more = fill(back);
+
+      std::unique_lock<std::mutex> guard(lock);
+      changed.wait(guard, [this] { return !have_ready || stopping; });
+      if (stopping)
+        return;
+      if (back.size()) {
+        std::swap(ready, back);
+        have_ready = true;
+      }
+      done = !more;
+      changed.notify_all();
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> guard(lock);
+    error = std::current_exception();
+    done = true;
+    changed.notify_all();
+  }
 }
 
 /*
-  Read the answers data from the given filename. This data is different from
-  the DNA-based data. The first line tells how many data-lines there are (one
-  for each pattern read) and how many comma-separated numbers there are on
-  each data-line (one for each sequence read). As with the others, the return
-  value is a vector of the data read, here std::vector<std::vector<int>>.
+  Hand over the next chunk, waiting for it if it hasn't been read yet. The
+  chunk given is taken back for the reader to reuse. Returns false when there
+  are no more chunks. An error from the reading thread is re-thrown here.
 */
-std::vector<std::vector<int>> read_answers(std::string fname, int *k) {
-  std::ifstream input{fname};
-  if (!input.is_open()) {
+bool SequenceStream::next(SequenceChunk &chunk) {
+  std::unique_lock<std::mutex> guard(lock);
+  changed.wait(guard, [this] { return have_ready || done; });
+
+  if (have_ready) {
+    std::swap(chunk, ready);
+    have_ready = false;
+    changed.notify_all();
+    return true;
+  }
+  if (error)
+    std::rethrow_exception(error);
+
+  return false;
+}
+
+/*
+  Open an answers file for streaming. One pass is made over the file to find
+  where each row starts and ends, and the header is read as read_answers()
+  reads it. Nothing else is kept.
+*/
+AnswersStream::AnswersStream(std::string const &fname, int *k) : fname(fname) {
+  fd = open(fname.c_str(), O_RDONLY);
+  if (fd == -1) {
     std::ostringstream error;
     error << "Error opening " << fname << " for reading";
     throw std::runtime_error{error.str()};
   }
 
-  std::vector<int> ints = read_header(input);
-  unsigned int num_lines = ints[0];
-  unsigned int num_ints = ints[1];
-  if (k != nullptr)
-    *k = ints[2];
+  try {
+    // A binary file has fixed places for everything.
+    struct stat info;
+    char start[ANSWERS_HEADER_SIZE] = {};
+    AnswersHeader binary_header;
+    if (fstat(fd, &info) == -1 ||
+        pread(fd, start, sizeof(start), 0) < 0) {
+      std::ostringstream error;
+      error << "Error reading " << fname;
+      throw std::runtime_error{error.str()};
+    }
+    if (binary_answers(fname, start, info.st_size, binary_header)) {
+      binary = true;
+      columns = binary_header.columns;
+      std::size_t row_bytes = columns * sizeof(std::int32_t);
+      for (std::size_t row = 0; row < binary_header.rows; row++) {
+        positions.push_back(ANSWERS_HEADER_SIZE + row * row_bytes);
+        ends.push_back(positions.back() + row_bytes);
+      }
+      if (k != nullptr)
+        *k = binary_header.k;
+      return;
+    }
 
-  // Allocate the vector-of-vectors in `table`:
-  std::vector<std::vector<int>> table;
+    std::string header;
+    bool in_header = true;
+    std::vector<char> block(1 << 20);
+    off_t at = 0;
 
-  for (std::string line; std::getline(input, line);) {
-    std::istringstream ss(std::move(line));
-    std::vector<int> row;
-    row.reserve(num_ints);
+    for (;;) {
+      ssize_t got = pread(fd, block.data(), block.size(), at);
+      if (got < 0) {
+        std::ostringstream error;
+        error << "Error reading " << fname;
+        throw std::runtime_error{error.str()};
+      }
+      if (got == 0)
+        break;
 
-    for (std::string value; std::getline(ss, value, ',');) {
-      row.push_back(std::stoi(value));
+      char const *start = block.data();
+      char const *end = start + got;
+      for (char const *p = start; p < end;) {
+        auto eol = static_cast<char const *>(std::memchr(p, '\n', end - p));
+        if (in_header)
+          header.append(p, eol ? eol : end);
+        else if (eol)
+          ends.push_back(at + (eol - start));
+        if (!eol)
+          break;
+        in_header = false;
+        positions.push_back(at + (eol + 1 - start));
+        p = eol + 1;
+      }
+      at += got;
     }
-    if (row.size() != num_ints) {
+    // The last row may or may not end in a newline.
+    if (!positions.empty() && positions.back() == at)
+      positions.pop_back();
+    else if (!positions.empty())
+      ends.push_back(at);
+
+    std::vector<int> ints = parse_header(header);
+    if (ints.size() < (k ? 3u : 2u)) {
+      std::ostringstream error;
+      error << fname << ": missing header line";
+      throw std::runtime_error{error.str()};
+    }
+    if ((std::size_t)ints[0] != positions.size()) {
       std::ostringstream error;
-      error << fname << ": wrong number of numbers read (" << row.size() << ")";
+      error << fname << ": wrong number of lines read";
       throw std::runtime_error{error.str()};
     }
+    columns = ints[1];
+    if (k != nullptr)
+      *k = ints[2];
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+}
+
+AnswersStream::~AnswersStream() { close(fd); }
+
+/*
+  Read the next `count` numbers of every row: rows[p][i] is the answer for
+  pattern p against the i-th of the next `count` sequences.
+*/
+void AnswersStream::next(std::size_t count,
+                         std::vector<std::vector<int>> &rows) {
+  if (columns_read + count > columns) {
+    std::ostringstream error;
+    error << fname << ": wrong number of numbers read (" << columns << ")";
+    throw std::runtime_error{error.str()};
+  }
+  columns_read += count;
+  rows.resize(positions.size());
+
+  for (std::size_t row = 0; row < positions.size(); row++) {
+    std::vector<int> &values = rows[row];
+    values.resize(count);
+
+    if (binary) {
+      std::size_t bytes = count * sizeof(std::int32_t);
+      if (pread(fd, values.data(), bytes, positions[row]) != (ssize_t)bytes) {
+        std::ostringstream error;
+        error << "Error reading " << fname;
+        throw std::runtime_error{error.str()};
+      }
+      positions[row] += bytes;
+      continue;
+    }
+    std::size_t left = ends[row] - positions[row];
+    // A guess at the bytes needed, which is doubled until it is enough.
+    std::size_t want = std::min(left, count * 4 + 64);
+
+    for (;;) {
+      buffer.resize(want);
+      if (pread(fd, buffer.data(), want, positions[row]) != (ssize_t)want) {
+        std::ostringstream error;
+        error << "Error reading " << fname;
+        throw std::runtime_error{error.str()};
+      }
+
+      char const *p = buffer.data();
+      char const *end = p + want;
+      std::size_t i = 0;
+      for (; i < count && p < end; i++) {
+        auto [next, ec] = std::from_chars(p, end, values[i]);
+        if (ec != std::errc() || (next == end && want < left))
+          break;
+        p = next < end && *next == ',' ? next + 1 : next;
+      }
+
+      if (i == count) {
+        positions[row] += p - buffer.data();
+        break;
+      }
+      if (want == left) {
+        std::ostringstream error;
+        error << fname << ": wrong number of numbers read (" << i << ")";
+        throw std::runtime_error{error.str()};
+      }
+      want = std::min(left, want * 2);
+    }
 
-    table.push_back(row);
+    if (columns_read == columns && positions[row] != ends[row]) {
+      std::ostringstream error;
+      error << fname << ": wrong number of numbers read (" << columns << "+)";
+      throw std::runtime_error{error.str()};
+    }
   }
+}
 
-  if (table.size() != num_lines) {
+/*
+  Read the sequence data from the given filename. Return it as a SequenceStore
+  of std::string_view slices into the memory-mapped file.
+*/
+SequenceStore read_sequences(std::string fname) { return SequenceStore{fname}; }
+
+/*
+  Read the pattern data from the given filename. The pattern data is the same
+  format as the sequence data, so map it the same way. Patterns are few and
+  short, and the initializers build on them, so they are copied out into
+  std::string values and the mapping is released.
+*/
+std::vector<std::string> read_patterns(std::string fname) {
+  SequenceStore patterns{fname};
+
+  return std::vector<std::string>(patterns.begin(), patterns.end());
+}
+
+/*
+  Read an answers file, which may be in either format. The file is mapped into
+  memory. A binary table is used from the mapping directly; a text one is
+  parsed and the mapping released.
+*/
+AnswersTable::AnswersTable(std::string const &fname) {
+  int fd = open(fname.c_str(), O_RDONLY);
+  if (fd == -1) {
+    std::ostringstream error;
+    error << "Error opening " << fname << " for reading";
+    throw std::runtime_error{error.str()};
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) == -1) {
+    close(fd);
+    std::ostringstream error;
+    error << "Error reading size of " << fname;
+    throw std::runtime_error{error.str()};
+  }
+  length = info.st_size;
+
+  if (length > 0) {
+    base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) {
+      base = nullptr;
+      close(fd);
+      std::ostringstream error;
+      error << "Error mapping " << fname << " into memory";
+      throw std::runtime_error{error.str()};
+    }
+  }
+  close(fd);
+
+  try {
+    char const *data = static_cast<char const *>(base);
+    AnswersHeader header;
+
+    if (binary_answers(fname, data, length, header)) {
+      rows = header.rows;
+      cols = header.columns;
+      k_value = header.k;
+      values = reinterpret_cast<std::int32_t const *>(data +
+                                                      ANSWERS_HEADER_SIZE);
+    } else {
+      read_text(fname, data, length);
+      release();
+    }
+  } catch (...) {
+    release();
+    throw;
+  }
+}
+
+/*
+  Parse a text answers file. The first line tells how many data-lines there
+  are (one for each pattern read) and how many comma-separated numbers there
+  are on each data-line (one for each sequence read), and for approximate
+  matching the value of k. The numbers are parsed straight into the matrix.
+*/
+void AnswersTable::read_text(std::string const &fname, char const *data,
+                             std::size_t length) {
+  char const *end = data + length;
+  char const *eol = end;
+  std::vector<int> ints;
+  if (length > 0) {
+    eol = static_cast<char const *>(std::memchr(data, '\n', length));
+    if (eol == nullptr)
+      eol = end;
+    ints = parse_header(std::string_view(data, eol - data));
+  }
+  if (ints.size() < 2) {
+    std::ostringstream error;
+    error << fname << ": missing header line";
+    throw std::runtime_error{error.str()};
+  }
+  // The matrix is sized from the header, so check first that the rest of the
+  // file could hold it: each number takes at least a digit and a separator.
+  // Below 2^31 each, the product of the two can't overflow.
+  if (ints[0] < 0 || ints[1] < 0 ||
+      (std::uint64_t)ints[0] * ints[1] > (std::uint64_t)(end - eol) / 2) {
+    std::ostringstream error;
+    error << fname << ": header gives more numbers than the file holds";
+    throw std::runtime_error{error.str()};
+  }
+  rows = ints[0];
+  cols = ints[1];
+  if (ints.size() > 2)
+    k_value = ints[2];
+  storage.assign(rows * cols, 0);
+  values = storage.data();
+
+  std::size_t row = 0;
+  for (char const *line = eol + 1; line < end; line = eol + 1, row++) {
+    eol = static_cast<char const *>(std::memchr(line, '\n', end - line));
+    if (eol == nullptr)
+      eol = end;
+    if (row == rows)
+      continue; // Counted, for the error below
+
+    std::int32_t *out = storage.data() + row * cols;
+    std::size_t count = 0;
+    for (char const *p = line; p < eol; count++) {
+      std::int32_t value;
+      auto [next, ec] = std::from_chars(p, eol, value);
+      if (ec != std::errc()) {
+        std::ostringstream error;
+        error << fname << ": malformed number in line " << row + 2;
+        throw std::runtime_error{error.str()};
+      }
+      if (count < cols)
+        out[count] = value;
+      p = next < eol && *next == ',' ? next + 1 : next;
+    }
+    if (count != cols) {
+      std::ostringstream error;
+      error << fname << ": wrong number of numbers read (" << count << ")";
+      throw std::runtime_error{error.str()};
+    }
+  }
+
+  if (row != rows) {
     std::ostringstream error;
     error << fname << ": wrong number of lines read";
     throw std::runtime_error{error.str()};
   }
+}
+
+/*
+  Release the mapping of the file, if there is one.
+*/
+void AnswersTable::release() {
+  if (base != nullptr)
+    munmap(base, length);
+  base = nullptr;
+  length = 0;
+}
+
+AnswersTable::~AnswersTable() { release(); }
+
+AnswersTable::AnswersTable(AnswersTable &&other) noexcept
+    : rows(other.rows), cols(other.cols), k_value(other.k_value),
+      values(other.values), storage(std::move(other.storage)),
+      base(other.base), length(other.length) {
+  other.rows = other.cols = 0;
+  other.values = nullptr;
+  other.base = nullptr;
+  other.length = 0;
+}
+
+AnswersTable &AnswersTable::operator=(AnswersTable &&other) noexcept {
+  if (this != &other) {
+    release();
+    rows = other.rows;
+    cols = other.cols;
+    k_value = other.k_value;
+    values = other.values;
+    storage = std::move(other.storage);
+    base = other.base;
+    length = other.length;
+    other.rows = other.cols = 0;
+    other.values = nullptr;
+    other.base = nullptr;
+    other.length = 0;
+  }
+
+  return *this;
+}
+
+/*
+  Read the answers data from the given filename, in either the text or the
+  binary format. If `k` is given, the value of k from the file is stored
+  there.
+*/
+AnswersTable read_answers(std::string fname, int *k) {
+  AnswersTable table{fname};
+  if (k != nullptr)
+    *k = table.k();
 
   return table;
 }
+
+/*
+  Encode `text` into the DNA alphabet, writing text.size() values to `out`. An
+  exception is thrown for any character that isn't one of A/C/G/T, as the
+  encoded tables have no room for another (an N, say).
+*/
+void encode_dna(std::string_view text, char *out) {
+  for (std::size_t i = 0; i < text.size(); i++) {
+    signed char code = DNA_CODES[(unsigned char)text[i]];
+    if (code == DNA_INVALID) {
+      std::ostringstream error;
+      error << "Character '" << text[i]
+            << "' outside of the DNA alphabet (the algorithms that use the "
+               "DNA encoding only take A, C, G and T)";
+      throw std::runtime_error{error.str()};
+    }
+    out[i] = code;
+  }
+}
+
+/*
+  Encode `text` into the DNA alphabet, returning the encoded copy.
+*/
+std::string encode_dna(std::string_view text) {
+  std::string encoded(text.size(), '\0');
+  encode_dna(text, encoded.data());
+
+  return encoded;
+}
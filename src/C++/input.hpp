@@ -5,11 +5,206 @@
 #ifndef _INPUT_HPP
 #define _INPUT_HPP
 
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <thread>
 #include <vector>
 
-extern std::vector<std::string> read_sequences(std::string fname);
+#include "alphabet.hpp"
+
+/*
+  A sequences file that has been mapped into memory, read-only. Each sequence
+  is exposed as a std::string_view slice into the mapping, so loading the file
+  costs no per-line allocations and no copy of the data. The views are only
+  valid for as long as the store itself is alive.
+
+  Calling encode() replaces the data with its DNA encoding (A/C/G/T as 0-3,
+  see `alphabet.hpp`). The encoded copy is owned by the store and the file
+  mapping is released, so the footprint stays at one byte per character.
+*/
+class SequenceStore {
+public:
+  explicit SequenceStore(std::string const &fname);
+  ~SequenceStore();
+
+  SequenceStore(SequenceStore const &) = delete;
+  SequenceStore &operator=(SequenceStore const &) = delete;
+  SequenceStore(SequenceStore &&other) noexcept;
+  SequenceStore &operator=(SequenceStore &&other) noexcept;
+
+  std::size_t size() const { return sequences.size(); }
+  std::string_view operator[](std::size_t idx) const { return sequences[idx]; }
+  std::vector<std::string_view>::const_iterator begin() const {
+    return sequences.begin();
+  }
+  std::vector<std::string_view>::const_iterator end() const {
+    return sequences.end();
+  }
+
+  void encode();
+  bool encoded() const { return is_encoded; }
+
+private:
+  void *base = nullptr;
+  std::size_t length = 0;
+  std::vector<std::string_view> sequences;
+  std::vector<char> encoded_data;
+  bool is_encoded = false;
+};
+
+/*
+  The answers for an experiment: an answers file read into a single P x S
+  matrix of counts, row-major, so that table[p][s] is the count for pattern p
+  in sequence s. A text file is parsed into storage the table owns. A binary
+  file (see `ANSWERS_MAGIC`, below) is mapped into memory and used as it is.
+*/
+class AnswersTable {
+public:
+  AnswersTable() = default;
+  explicit AnswersTable(std::string const &fname);
+  ~AnswersTable();
+
+  AnswersTable(AnswersTable const &) = delete;
+  AnswersTable &operator=(AnswersTable const &) = delete;
+  AnswersTable(AnswersTable &&other) noexcept;
+  AnswersTable &operator=(AnswersTable &&other) noexcept;
+
+  // The number of rows (patterns) and of columns (sequences).
+  std::size_t size() const { return rows; }
+  std::size_t columns() const { return cols; }
+  // The value of k from the header, or -1 if there was none.
+  int k() const { return k_value; }
+  std::int32_t const *operator[](std::size_t row) const {
+    return values + row * cols;
+  }
+
+private:
+  void read_text(std::string const &fname, char const *data,
+                 std::size_t length);
+  void release();
+
+  std::size_t rows = 0, cols = 0;
+  int k_value = -1;
+  std::int32_t const *values = nullptr;
+  std::vector<std::int32_t> storage;
+  void *base = nullptr;
+  std::size_t length = 0;
+};
+
+/*
+  The binary answers format. The file starts with this header, all fields
+  little-endian, and the P x S counts follow it as 32-bit integers, row by
+  row, at an offset of ANSWERS_HEADER_SIZE. `k` is -1 for exact-matching
+  answers. The files are made from the text ones by
+  `../util/answers_to_binary.py`.
+*/
+constexpr char ANSWERS_MAGIC[8] = {'A', 'N', 'S', 'W', 'E', 'R', 'S', 'B'};
+constexpr std::uint32_t ANSWERS_VERSION = 1;
+constexpr std::size_t ANSWERS_HEADER_SIZE = 32;
+
+struct AnswersHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t rows;
+  std::uint32_t columns;
+  std::int32_t k;
+  char reserved[8];
+};
+static_assert(sizeof(AnswersHeader) == ANSWERS_HEADER_SIZE,
+              "AnswersHeader must match the file layout");
+
+/*
+  A run of consecutive sequences read from a SequenceStream. `first` is the
+  index (in the whole file) of the first of them. The views point into `data`,
+  which the chunk owns.
+*/
+struct SequenceChunk {
+  std::size_t first = 0;
+  std::vector<char> data;
+  std::vector<std::string_view> sequences;
+
+  std::size_t size() const { return sequences.size(); }
+  std::string_view operator[](std::size_t idx) const { return sequences[idx]; }
+};
+
+/*
+  A sequences file read a chunk at a time, for files too large to be held in
+  memory at once. Each chunk holds whole lines, about `chunk_bytes` of them (a
+  single longer line gets a chunk of its own). A thread of the stream's own
+  reads (and, if asked, encodes) the next chunk while the caller works on the
+  current one. next() hands over the next chunk and takes back the one it is
+  given for reuse, so no more than three chunks are ever allocated.
+*/
+class SequenceStream {
+public:
+  SequenceStream(std::string const &fname, std::size_t chunk_bytes,
+                 bool encode);
+  ~SequenceStream();
+
+  SequenceStream(SequenceStream const &) = delete;
+  SequenceStream &operator=(SequenceStream const &) = delete;
+
+  // The number of sequences the header line says the file holds.
+  std::size_t size() const { return count; }
+  bool next(SequenceChunk &chunk);
+
+private:
+  void reader();
+  bool fill(SequenceChunk &chunk);
+
+  std::string fname;
+  int fd = -1;
+  std::size_t chunk_bytes;
+  bool encode;
+  std::size_t count = 0;
+  std::size_t lines_read = 0;
+  // The start of a line that didn't fit in the last chunk read.
+  std::vector<char> carry;
+
+  SequenceChunk ready;
+  bool have_ready = false, done = false, stopping = false;
+  std::exception_ptr error;
+  std::mutex lock;
+  std::condition_variable changed;
+  std::thread thread;
+};
+
+/*
+  An answers file read a block of columns (sequences) at a time, as the
+  sequences are streamed. Only the position reached in each row is kept, so the
+  memory needed is that of one block rather than the whole table.
+*/
+class AnswersStream {
+public:
+  AnswersStream(std::string const &fname, int *k);
+  ~AnswersStream();
+
+  AnswersStream(AnswersStream const &) = delete;
+  AnswersStream &operator=(AnswersStream const &) = delete;
+
+  std::size_t size() const { return positions.size(); }
+  void next(std::size_t count, std::vector<std::vector<int>> &rows);
+
+private:
+  std::string fname;
+  int fd = -1;
+  bool binary = false;
+  std::size_t columns = 0;
+  std::size_t columns_read = 0;
+  std::vector<off_t> positions, ends;
+  std::vector<char> buffer;
+};
+
+extern SequenceStore read_sequences(std::string fname);
 extern std::vector<std::string> read_patterns(std::string fname);
-extern std::vector<std::vector<int>> read_answers(std::string fname, int *k);
+extern AnswersTable read_answers(std::string fname, int *k);
+extern void encode_dna(std::string_view text, char *out);
+extern std::string encode_dna(std::string_view text);
 
 #endif // !_INPUT_HPP
@@ -3,18 +3,40 @@
 
   This is based heavily on the code given in chapter 7 of the book, "Handbook
   of Exact String-Matching Algorithms," by Christian Charras and Thierry Lecroq.
+
+  When built with SIMD_FILTER defined (the `kmp_simd` target), the search skips
+  ahead to the next position that passes the first/last character filter in
+  `simd_filter.hpp` whenever there is no partial match in progress.
 */
 
+#include <algorithm>
 #include <string>
-#include <vector>
+#include <string_view>
 
 #include "run.hpp"
+#ifdef SIMD_FILTER
+#include "simd_filter.hpp"
+#endif
+
+/*
+  The preprocessed form of a pattern. The copy of the pattern has a sentinel
+  character after it, which make_next_table() reads.
+*/
+struct alignas(CACHE_LINE) KmpPattern {
+  int m = 0;
+  AlignedArray<char> pattern;
+  AlignedArray<int> next_table;
+
+  template <typename Archive> void fields(Archive &archive) {
+    archive(m, pattern, next_table);
+  }
+};
 
 /*
   Initialize the jump-table that KMP uses.
 */
-void make_next_table(std::string const &pat, int m,
-                     std::vector<int> &next_table) {
+void make_next_table(AlignedArray<char> const &pat, int m,
+                     AlignedArray<int> &next_table) {
   int i, j;
 
   i = 0;
@@ -34,45 +56,52 @@ void make_next_table(std::string const &pat, int m,
 
 /*
   Initialize the structure for Knuth-Morris-Pratt. Here, that means setting up
-  the `next_table` array. The return value is a vector of the `PatternData`
-  type, which is a type-safe union of sorts that covers the different types
-  that have to be returned.
+  the `next_table` array. The return value is the preprocessed pattern.
 */
-std::vector<PatternData> init_kmp(std::string const &pattern) {
-  std::vector<PatternData> return_val;
-  return_val.reserve(2);
+KmpPattern init_kmp(std::string const &pattern) {
+  KmpPattern return_val;
   int m = pattern.length();
-  // Set up the next_table array for the algorithm to use:
-  std::vector<int> next_table(m + 1, 0);
+  return_val.m = m;
   // Set up a copy of pattern, with the sentinel character added:
-  std::string pat(pattern + "\0");
-  make_next_table(pat, m, next_table);
-
-  return_val.push_back(pat);
-  return_val.push_back(next_table);
+  return_val.pattern = AlignedArray<char>(m + 1, '\0');
+  std::copy(pattern.begin(), pattern.end(), return_val.pattern.begin());
+  // Set up the next_table array for the algorithm to use:
+  return_val.next_table = AlignedArray<int>(m + 1, 0);
+  make_next_table(return_val.pattern, m, return_val.next_table);
 
   return return_val;
 }
 
 /*
-  Perform the KMP algorithm on the given pattern of length m, against the
-  sequence of length n.
+  The search itself, for a pattern of length m, reporting each match to `sink`
+  (see `run.hpp`). This is always inlined, so that a constant m (from
+  kmp_fixed(), below) is folded into the loop.
 */
-int kmp(std::vector<PatternData> const &pat_data, std::string const &sequence) {
+template <typename Sink>
+[[gnu::always_inline]] static inline int
+kmp_search(KmpPattern const &pat_data, int m, std::string_view sequence,
+           Sink sink) {
   int i, j;
   int matches = 0;
 
-  // Unpack pat_data:
-  auto const &pattern = std::get<std::string>(pat_data[0]);
-  auto const &next_table = std::get<std::vector<int>>(pat_data[1]);
+  char const *pattern = pat_data.pattern.data();
+  int const *next_table = pat_data.next_table.data();
 
-  // Get the size of the pattern and the sequence.
-  int m = pattern.length();
+  // Get the size of the sequence.
   int n = sequence.length();
 
   // Perform the searching:
   i = j = 0;
   while (j < n) {
+#ifdef SIMD_FILTER
+    // With no partial match, the next match can't start before the next
+    // candidate.
+    if (i == 0) {
+      j = next_candidate(sequence, j, m, pattern[0], pattern[m - 1]);
+      if (j > n - m)
+        break;
+    }
+#endif
     while (i > -1 && pattern[i] != sequence[j])
       i = next_table[i];
 
@@ -80,6 +109,11 @@ int kmp(std::vector<PatternData> const &pat_data, std::string const &sequence) {
     j++;
     if (i >= m) {
       matches++;
+      if constexpr (Sink::reports) {
+        sink(j - m);
+        if (sink.full(matches))
+          break;
+      }
       i = next_table[i];
     }
   }
@@ -87,13 +121,58 @@ int kmp(std::vector<PatternData> const &pat_data, std::string const &sequence) {
   return matches;
 }
 
+/*
+  Perform the KMP algorithm on the given pattern of length m, against the
+  sequence of length n.
+*/
+int kmp(KmpPattern const &pat_data, std::string_view sequence) {
+  return kmp_search(pat_data, pat_data.m, sequence, CountOnly{});
+}
+
+/*
+  The search again, specialized for a pattern length M known at compile time
+  (see `FixedLengths` in `run.hpp`).
+*/
+template <int M>
+int kmp_fixed(KmpPattern const &pat_data, std::string_view sequence) {
+  return kmp_search(pat_data, M, sequence, CountOnly{});
+}
+
+/*
+  The search again, reporting the offset of each match as well.
+*/
+int kmp_locate(KmpPattern const &pat_data, std::string_view sequence,
+               HitSink sink) {
+  return kmp_search(pat_data, pat_data.m, sequence, sink);
+}
+
+/*
+  Return the specialized search for patterns of length m, if there is one.
+*/
+algorithm<KmpPattern> specialize_kmp(int m) {
+  return select_fixed(
+      m,
+      [](auto M) -> algorithm<KmpPattern> {
+        return &kmp_fixed<decltype(M)::value>;
+      },
+      FixedLengths{});
+}
+
 /*
   All that is done here is call the run() function with a pointer to the
   algorithm implementation, the label for the algorithm, and the argc/argv
-  values.
+  values. The specialized searches are used for the lengths that have them,
+  and the locating search for `--positions`.
 */
 int main(int argc, char *argv[]) {
-  int return_code = run(&init_kmp, &kmp, "kmp", argc, argv);
+#ifdef SIMD_FILTER
+  std::string name = "kmp_simd";
+#else
+  std::string name = "kmp";
+#endif
+  int return_code =
+      run(&init_kmp, &kmp, name, argc, argv, Encoding::ascii, &specialize_kmp,
+          &kmp_locate);
 
   return return_code;
 }
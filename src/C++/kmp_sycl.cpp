@@ -0,0 +1,74 @@
+/*
+  Knuth-Morris-Pratt (see `kmp.cpp`) as a batch matcher, matching every
+  pattern against every sequence at once on an offload device (see
+  `sycl_batch.hpp`).
+*/
+
+#include <string>
+#include <vector>
+
+#include "sycl_batch.hpp"
+
+struct KmpSycl {
+  using Word = int;
+
+  /*
+    The pattern, with a sentinel character after it, followed by its jump
+    table, as make_next_table() builds them. Both take m + 1 items.
+  */
+  static void prepare(std::string const &pattern, int,
+                      std::vector<Word> &table) {
+    int m = pattern.length();
+    std::size_t base = table.size();
+    table.resize(base + 2 * (m + 1), 0);
+    int *pat = table.data() + base;
+    int *next_table = pat + m + 1;
+    for (int i = 0; i < m; i++)
+      pat[i] = pattern[i];
+
+    int i = 0, j = next_table[0] = -1;
+    while (i < m) {
+      while (j > -1 && pat[i] != pat[j])
+        j = next_table[j];
+      i++;
+      j++;
+      if (pat[i] == pat[j])
+        next_table[i] = next_table[j];
+      else
+        next_table[i] = j;
+    }
+  }
+
+  static int count(Word const *table, int m, int, char const *sequence,
+                   int n) {
+    Word const *pattern = table;
+    Word const *next_table = table + m + 1;
+    int matches = 0;
+
+    int i = 0, j = 0;
+    while (j < n) {
+      while (i > -1 && pattern[i] != sequence[j])
+        i = next_table[i];
+      i++;
+      j++;
+      if (i >= m) {
+        matches++;
+        i = next_table[i];
+      }
+    }
+
+    return matches;
+  }
+};
+
+/*
+  All that is done here is call the batch runner with the argc/argv values.
+  The data is left in ASCII, as it is for `kmp.cpp`.
+*/
+int main(int argc, char *argv[]) {
+  SyclBatchMatcher<KmpSycl> matcher;
+  int return_code = run_batch_matcher(matcher, "kmp_sycl", argc, argv,
+                                      Encoding::ascii, false);
+
+  return return_code;
+}
@@ -0,0 +1,334 @@
+/*
+  Header file for the storage used by the preprocessed patterns.
+
+  Each algorithm preprocesses a pattern into a struct of its own (see the
+  `*Pattern` types in the algorithm files). The tables in those structs are
+  AlignedArrays: each one a single contiguous block that starts on a cache
+  line, so that a table small enough to fit in a line or two is never split
+  across more of them than it has to be.
+
+  The same structs can be written to and read back from a pattern cache (see
+  `cache.hpp`). A struct takes part by listing its members in a `fields()`
+  member template, which is called with a PatternWriter or a PatternReader.
+  An AlignedArray that is read back borrows its storage from the mapped cache
+  file, rather than copying it.
+
+  The patterns that the runners prepare take the storage of their tables from
+  an Arena instead of the heap (see ArenaScope), so that preparing one pattern
+  after another doesn't allocate and free for each.
+*/
+
+#ifndef _PATTERN_HPP
+#define _PATTERN_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// The size of a cache line, which is also the alignment of the tables.
+constexpr std::size_t CACHE_LINE = 64;
+
+/*
+  Allocate `bytes`, rounded up to whole cache lines, aligned to CACHE_LINE.
+  This goes through the aligned operator new (rather than aligned_alloc()), so
+  that the counting one of `make alloc-check` sees it. The storage is given
+  back with free_lines().
+*/
+inline void *allocate_lines(std::size_t bytes) {
+  std::size_t lines = (bytes + CACHE_LINE - 1) / CACHE_LINE;
+
+  return ::operator new(lines * CACHE_LINE, std::align_val_t{CACHE_LINE});
+}
+
+inline void free_lines(void *ptr) {
+  ::operator delete(ptr, std::align_val_t{CACHE_LINE});
+}
+
+/*
+  A monotonic arena for the tables of preprocessed patterns. It hands out
+  pieces of its blocks in order, each starting on a cache line, and only
+  takes them back all at once, in reset(). A reset keeps the storage (merged
+  into one block, if it had grown past one) for the next use, so once the
+  arena has grown to fit the largest pattern that it holds, it allocates
+  nothing more.
+*/
+class Arena {
+public:
+  void *allocate(std::size_t bytes) {
+    bytes = (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    if (blocks.empty() || blocks.back().size - used < bytes) {
+      // Each new block is at least twice the last, so that an arena that
+      // keeps growing only takes a few of them.
+      std::size_t size =
+          std::max(bytes, blocks.empty() ? 0 : 2 * blocks.back().size);
+      blocks.push_back(
+          {std::unique_ptr<char, Free>(
+               static_cast<char *>(allocate_lines(size))),
+           size});
+      used = 0;
+    }
+    char *at = blocks.back().data.get() + used;
+    used += bytes;
+
+    return at;
+  }
+
+  // Give back everything allocated; what was allocated is no longer valid.
+  void reset() {
+    if (blocks.size() > 1) {
+      std::size_t total = capacity();
+      blocks.clear();
+      blocks.push_back(
+          {std::unique_ptr<char, Free>(
+               static_cast<char *>(allocate_lines(total))),
+           total});
+    }
+    used = 0;
+  }
+
+  // The bytes held, whether in use or not.
+  std::size_t capacity() const {
+    std::size_t total = 0;
+    for (auto const &block : blocks)
+      total += block.size;
+
+    return total;
+  }
+
+private:
+  struct Free {
+    void operator()(char *ptr) const { free_lines(ptr); }
+  };
+  struct Block {
+    std::unique_ptr<char, Free> data;
+    std::size_t size;
+  };
+
+  std::vector<Block> blocks;
+  std::size_t used = 0; // Of the last block
+};
+
+// The arena of the innermost ArenaScope open on this thread, if there is one.
+inline thread_local Arena *current_arena = nullptr;
+
+/*
+  While an ArenaScope is open, the AlignedArrays made on its thread take their
+  storage from its arena, and don't own it; they are only valid until the
+  arena is reset. The runners' matchers prepare each pattern in a scope for
+  its slot's arena, which they reset before the slot's next pattern.
+*/
+class ArenaScope {
+public:
+  explicit ArenaScope(Arena &arena) : previous(current_arena) {
+    current_arena = &arena;
+  }
+  ~ArenaScope() { current_arena = previous; }
+
+  ArenaScope(ArenaScope const &) = delete;
+  ArenaScope &operator=(ArenaScope const &) = delete;
+
+private:
+  Arena *previous;
+};
+
+/*
+  A fixed-size, heap-allocated array whose storage is aligned to CACHE_LINE.
+  Only meant for plain values (characters, integers, bit masks), so that the
+  storage can be allocated and freed without running constructors. It can be
+  moved but not copied, so a pattern's tables are never copied by accident.
+
+  An array made by borrow() does not own its storage, which must outlive it
+  and must not be written to. Neither does one made in an ArenaScope, whose
+  storage is the arena's.
+*/
+template <typename T> class AlignedArray {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "AlignedArray is only for plain values");
+
+public:
+  AlignedArray() = default;
+  explicit AlignedArray(std::size_t count, T value = T{}) : length(count) {
+    if (current_arena && count)
+      items = std::unique_ptr<T[], Free>(
+          static_cast<T *>(current_arena->allocate(count * sizeof(T))),
+          Free{false});
+    else
+      items = std::unique_ptr<T[], Free>(allocate(count));
+    std::fill_n(items.get(), count, value);
+  }
+  template <std::input_iterator Iterator>
+  AlignedArray(Iterator first, Iterator last)
+      : AlignedArray(std::distance(first, last)) {
+    std::copy(first, last, items.get());
+  }
+
+  static AlignedArray borrow(T const *data, std::size_t count) {
+    AlignedArray array;
+    array.items =
+        std::unique_ptr<T[], Free>(const_cast<T *>(data), Free{false});
+    array.length = count;
+
+    return array;
+  }
+
+  std::size_t size() const { return length; }
+  T *data() { return items.get(); }
+  T const *data() const { return items.get(); }
+  T &operator[](std::size_t idx) { return items[idx]; }
+  T const &operator[](std::size_t idx) const { return items[idx]; }
+  T *begin() { return items.get(); }
+  T *end() { return items.get() + length; }
+  T const *begin() const { return items.get(); }
+  T const *end() const { return items.get() + length; }
+
+private:
+  struct Free {
+    bool owned = true;
+    void operator()(T *ptr) const {
+      if (owned)
+        free_lines(ptr);
+    }
+  };
+
+  static T *allocate(std::size_t count) {
+    if (count == 0)
+      return nullptr;
+
+    return static_cast<T *>(allocate_lines(count * sizeof(T)));
+  }
+
+  std::unique_ptr<T[], Free> items;
+  std::size_t length = 0;
+};
+
+/*
+  Writes the fields of patterns into one buffer, for a pattern cache. Plain
+  values are copied as they are. An AlignedArray is written as its size,
+  followed by its items starting at the next multiple of CACHE_LINE, so that
+  the items are still aligned when the buffer is mapped back in from a file
+  (at an aligned offset).
+*/
+class PatternWriter {
+public:
+  std::size_t size() const { return bytes.size(); }
+  char const *data() const { return bytes.data(); }
+
+  template <typename... Fields> void operator()(Fields const &...fields) {
+    (write(fields), ...);
+  }
+
+private:
+  template <typename T> void write(T const &value) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "only plain values can be cached");
+    append(&value, sizeof(T));
+  }
+  template <typename T> void write(AlignedArray<T> const &array) {
+    std::uint64_t count = array.size();
+    append(&count, sizeof(count));
+    bytes.resize((bytes.size() + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE);
+    append(array.data(), count * sizeof(T));
+  }
+  void append(void const *data, std::size_t size) {
+    char const *from = static_cast<char const *>(data);
+    bytes.insert(bytes.end(), from, from + size);
+  }
+
+  std::vector<char> bytes;
+};
+
+/*
+  Reads the fields of a pattern back out of a mapped cache, in the order that
+  a PatternWriter wrote them. `base` is the start of the writer's buffer in
+  the mapping, which must be aligned to CACHE_LINE; the pattern's fields run
+  from `offset` to `end` within it. The arrays are borrowed from the mapping.
+*/
+class PatternReader {
+public:
+  PatternReader(char const *base, std::size_t offset, std::size_t end)
+      : base(base), offset(offset), end(end) {}
+
+  template <typename... Fields> void operator()(Fields &...fields) {
+    (read(fields), ...);
+  }
+
+private:
+  template <typename T> void read(T &value) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "only plain values can be cached");
+    std::memcpy(&value, take(sizeof(T)), sizeof(T));
+  }
+  template <typename T> void read(AlignedArray<T> &array) {
+    std::uint64_t count;
+    std::memcpy(&count, take(sizeof(count)), sizeof(count));
+    offset = (offset + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    if (offset > end || count > (end - offset) / sizeof(T))
+      throw std::runtime_error{"Pattern cache is corrupt"};
+    array = AlignedArray<T>::borrow(
+        reinterpret_cast<T const *>(take(count * sizeof(T))), count);
+  }
+  char const *take(std::size_t size) {
+    if (offset > end || size > end - offset)
+      throw std::runtime_error{"Pattern cache is corrupt"};
+    char const *at = base + offset;
+    offset += size;
+
+    return at;
+  }
+
+  char const *base;
+  std::size_t offset, end;
+};
+
+/*
+  Totals the bytes of the fields of a pattern: the size of each plain value,
+  and the items of each AlignedArray. This is what the pattern takes in
+  memory, less its padding, whether it was prepared or loaded from a cache.
+*/
+class PatternSizer {
+public:
+  std::size_t bytes = 0;
+
+  template <typename... Fields> void operator()(Fields const &...fields) {
+    (add(fields), ...);
+  }
+
+private:
+  template <typename T> void add(T const &) { bytes += sizeof(T); }
+  template <typename T> void add(AlignedArray<T> const &array) {
+    bytes += array.size() * sizeof(T);
+  }
+};
+
+/*
+  A tag for the layout of a pattern type's tables, which a pattern cache
+  records so that one written by a build that lays them out otherwise is
+  rebuilt rather than read. It takes in the size and alignment of the struct
+  and, for a struct whose tables depend on more than that (such as the width
+  of the vectors it was compiled for), its own LAYOUT.
+*/
+template <typename Pattern> constexpr std::uint64_t pattern_layout() {
+  std::uint64_t layout = (std::uint64_t)sizeof(Pattern) << 32 |
+                         (std::uint64_t)alignof(Pattern);
+  if constexpr (requires { Pattern::LAYOUT; })
+    layout |= (std::uint64_t)Pattern::LAYOUT << 16;
+
+  return layout;
+}
+
+// A pattern type whose preprocessed form can be cached.
+template <typename Pattern>
+concept Cacheable = requires(Pattern &pattern, PatternWriter &writer,
+                             PatternReader &reader) {
+  pattern.fields(writer);
+  pattern.fields(reader);
+};
+
+#endif // !_PATTERN_HPP
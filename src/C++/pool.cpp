@@ -0,0 +1,168 @@
+/*
+  The thread-pool used by the runners when they are asked to spread the work
+  over more than one thread. See `pool.hpp` for an overview.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "pool.hpp"
+
+/*
+  Pack and unpack the [begin, end) pair of chunk indices kept in a Range.
+*/
+static inline std::uint64_t pack(std::uint64_t begin, std::uint64_t end) {
+  return begin << 32 | end;
+}
+static inline int range_begin(std::uint64_t bounds) { return bounds >> 32; }
+static inline int range_end(std::uint64_t bounds) {
+  return bounds & 0xffffffff;
+}
+
+ThreadPool::ThreadPool(int threads) : threads(threads) {
+  if (threads < 1)
+    throw std::runtime_error{"ThreadPool: thread count must be >= 1"};
+
+  ranges.reset(new Range[threads]);
+  times.assign(threads, 0.0);
+
+  // Thread 0 is whichever thread calls parallel_for(), so start one fewer.
+  workers.reserve(threads - 1);
+  for (int id = 1; id < threads; id++)
+    workers.emplace_back(&ThreadPool::worker, this, id);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_all();
+
+  for (auto &thread : workers)
+    thread.join();
+}
+
+/*
+  Run `task` over [0, count) in chunks of `chunk` indices, and return once all
+  of the chunks are done.
+*/
+void ThreadPool::run(int count, int chunk, Task const &task) {
+  if (count <= 0)
+    return;
+  int chunks = (count + chunk - 1) / chunk;
+
+  // Deal the chunks out in contiguous shares, so that each thread starts out
+  // walking its own part of the data in order.
+  for (int id = 0; id < threads; id++) {
+    std::uint64_t begin = (std::uint64_t)chunks * id / threads;
+    std::uint64_t end = (std::uint64_t)chunks * (id + 1) / threads;
+    ranges[id].bounds.store(pack(begin, end), std::memory_order_relaxed);
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    this->task = task;
+    this->count = count;
+    this->chunk = chunk;
+    pending = threads - 1;
+    generation++;
+  }
+  wake.notify_all();
+
+  work(0);
+
+  std::unique_lock<std::mutex> guard(lock);
+  done.wait(guard, [this] { return pending == 0; });
+  this->task = Task{};
+}
+
+/*
+  The loop each of the started threads runs: wait for a new generation of work
+  (or for the pool to stop), do it, and report back.
+*/
+void ThreadPool::worker(int id) {
+  unsigned long seen = 0;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      wake.wait(guard, [&] { return stopping || generation != seen; });
+      if (stopping)
+        return;
+      seen = generation;
+    }
+
+    work(id);
+
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      if (--pending == 0)
+        done.notify_one();
+    }
+  }
+}
+
+/*
+  Run chunks until there are none left anywhere, and note the time it took.
+*/
+void ThreadPool::work(int id) {
+  auto start = std::chrono::steady_clock::now();
+  int chunk_idx;
+
+  while (take_own(id, chunk_idx) || steal(id, chunk_idx)) {
+    int begin = chunk_idx * chunk;
+    int end = std::min(begin + chunk, count);
+    task.call(task.body, begin, end, id);
+  }
+
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  times[id] += elapsed.count();
+}
+
+/*
+  Take the next chunk from the front of this thread's own share.
+*/
+bool ThreadPool::take_own(int id, int &chunk_idx) {
+  std::atomic<std::uint64_t> &bounds = ranges[id].bounds;
+  std::uint64_t value = bounds.load(std::memory_order_relaxed);
+
+  while (range_begin(value) < range_end(value)) {
+    int begin = range_begin(value);
+    if (bounds.compare_exchange_weak(value, pack(begin + 1, range_end(value)),
+                                     std::memory_order_acquire)) {
+      chunk_idx = begin;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*
+  Take a chunk from the back of some other thread's share. The victims are
+  tried in order, starting with the next thread up.
+*/
+bool ThreadPool::steal(int id, int &chunk_idx) {
+  for (int offset = 1; offset < threads; offset++) {
+    std::atomic<std::uint64_t> &bounds = ranges[(id + offset) % threads].bounds;
+    std::uint64_t value = bounds.load(std::memory_order_relaxed);
+
+    while (range_begin(value) < range_end(value)) {
+      int end = range_end(value) - 1;
+      if (bounds.compare_exchange_weak(value, pack(range_begin(value), end),
+                                       std::memory_order_acquire)) {
+        chunk_idx = end;
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,78 @@
+/*
+  Header file for the thread-pool module used by the runners.
+*/
+
+#ifndef _POOL_HPP
+#define _POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+  A fixed-size pool of worker threads that runs a body over the index range
+  [0, count) in chunks. Each thread starts with a contiguous share of the
+  chunks and takes them from the front; a thread that runs dry steals chunks
+  from the back of the other threads' shares. The calling thread takes part as
+  thread 0, so a pool of N threads only starts N - 1 of its own.
+*/
+class ThreadPool {
+public:
+  explicit ThreadPool(int threads);
+  ~ThreadPool();
+
+  ThreadPool(ThreadPool const &) = delete;
+  ThreadPool &operator=(ThreadPool const &) = delete;
+
+  int size() const { return threads; }
+  // The body is called as body(begin, end, thread) for each chunk. It is only
+  // referred to, never copied, as the call waits for the chunks to be done;
+  // unlike wrapping it in a std::function, that allocates nothing.
+  template <typename Body>
+  void parallel_for(int count, int chunk, Body const &body) {
+    run(count, chunk,
+        {&body, [](void const *body, int begin, int end, int thread) {
+           (*static_cast<Body const *>(body))(begin, end, thread);
+         }});
+  }
+  // Seconds each thread has spent working, summed over all parallel_for calls.
+  std::vector<double> const &thread_times() const { return times; }
+
+private:
+  // One thread's remaining chunks, packed as (begin << 32 | end) so that the
+  // owner and the thieves can both claim a chunk with a single CAS. Padded to
+  // a cache line so that the threads don't false-share.
+  struct alignas(64) Range {
+    std::atomic<std::uint64_t> bounds{0};
+  };
+  // The body of a parallel_for(), with the function that calls it.
+  struct Task {
+    void const *body = nullptr;
+    void (*call)(void const *body, int begin, int end, int thread) = nullptr;
+  };
+
+  void run(int count, int chunk, Task const &task);
+  void worker(int id);
+  void work(int id);
+  bool take_own(int id, int &chunk_idx);
+  bool steal(int id, int &chunk_idx);
+
+  int threads;
+  std::vector<std::thread> workers;
+  std::unique_ptr<Range[]> ranges;
+  std::vector<double> times;
+
+  std::mutex lock;
+  std::condition_variable wake, done;
+  Task task;
+  int count = 0, chunk = 0;
+  unsigned long generation = 0;
+  int pending = 0;
+  bool stopping = false;
+};
+
+#endif // !_POOL_HPP
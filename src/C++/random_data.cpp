@@ -0,0 +1,709 @@
+/*
+  A native counterpart of `../util/random_data.py`, for data sets too large
+  for that to make: sequences files of many GB, with the answers computed as
+  the sequences are made, by all the threads at once.
+
+  The files are the same as the script writes: a sequences file, a patterns
+  file, the exact-matching answers and an answers file for each value of k
+  given with `-k`. Instead of drawing the patterns from the sequences, as the
+  script does, the patterns are random and copies of them are planted in the
+  sequences, so that the hit rate is set by `--density` rather than left to
+  chance. The lengths of the patterns (`--pattern-length`) and the gaps put
+  into the planted copies (`--gaps`, for the approximate matching) are drawn
+  from distributions given as SPECs: comma-separated items `N` or `LOW-HIGH`
+  (drawn evenly), each with an optional `:WEIGHT`. So `8-12` is any length from
+  8 to 12, and `0:8,1-3:2` leaves four gaps in five empty.
+
+  The sequences are made in chunks, each from a generator seeded with the
+  seed and the chunk's number, so the data for a seed is the same whatever
+  the number of threads. The lengths of the sequences are drawn first, which
+  places each chunk in the file, and so each thread writes its chunks (and
+  their columns of the answers) where they go, in whatever order it gets to
+  them. The answers are written in the binary format of `input.hpp`, which
+  has the same place for each count, and then (unless `--binary` is given)
+  written out again as text.
+
+  The answers are counted by the plain definition of a match rather than by
+  any of the algorithms, so as to check those. A pattern matches at a
+  position with gaps of at most k, when each of its characters after the
+  first comes within the k characters after the one before it, and none of
+  the characters in between is the same as it. That makes the place of each
+  character the first one like it in the k + 1 places after the last, so a
+  match is found by walking a trie of the patterns, and one walk down it from
+  each position finds the matches for every k at once: the widest gap on the
+  way decides which values of k it counts for.
+*/
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <unordered_set>
+#include <vector>
+
+#include "alphabet.hpp"
+#include "input.hpp"
+#include "pool.hpp"
+#include "run.hpp"
+
+// The defaults of the options, which are those of `random_data.py`.
+constexpr long long DEFAULT_COUNT = 100000;
+constexpr int DEFAULT_LENGTH = 1024;
+constexpr int DEFAULT_PATTERNS = 100;
+
+// A chunk of sequences holds about this much sequence data, and no more than
+// CHUNK_COUNTS counts of the answers (over all the answers files), which is
+// what a thread's memory comes to.
+constexpr std::size_t CHUNK_BYTES = 1 << 22;
+constexpr std::size_t CHUNK_COUNTS = 1 << 22;
+
+// The rows of text answers formatted by the threads at a time come to about
+// this many counts.
+constexpr std::size_t TEXT_COUNTS = 1 << 24;
+
+/*
+  A distribution of whole numbers given as a SPEC (see above).
+*/
+class Spread {
+public:
+  Spread(std::string const &spec, char const *what) {
+    std::istringstream items(spec);
+    std::string item;
+    double total = 0;
+
+    while (std::getline(items, item, ',')) {
+      std::size_t used = 0, colon = item.find(':'), dash = item.find('-');
+      try {
+        int first = std::stoi(item, &used);
+        if (used < item.size() && item[used] != '-' && item[used] != ':')
+          throw std::invalid_argument{item};
+        int last = dash != std::string::npos && dash < colon
+                       ? std::stoi(item.substr(dash + 1))
+                       : first;
+        double weight =
+            colon != std::string::npos ? std::stod(item.substr(colon + 1)) : 1;
+        if (first < 0 || last < first || !(weight > 0))
+          throw std::invalid_argument{item};
+        low.push_back(first);
+        high.push_back(last);
+        total += weight;
+        cumulative.push_back(total);
+      } catch (std::logic_error const &) {
+        std::ostringstream msg;
+        msg << "Bad item '" << item << "' in " << what << " '" << spec << "'";
+        throw std::runtime_error{msg.str()};
+      }
+    }
+    if (low.empty()) {
+      std::ostringstream msg;
+      msg << "Empty " << what;
+      throw std::runtime_error{msg.str()};
+    }
+  }
+
+  template <typename Rng> int operator()(Rng &rng) const {
+    std::size_t item = 0;
+    if (cumulative.size() > 1) {
+      std::uniform_real_distribution<double> pick(0, cumulative.back());
+      item = std::upper_bound(cumulative.begin(), cumulative.end(), pick(rng)) -
+             cumulative.begin();
+      item = std::min(item, cumulative.size() - 1);
+    }
+    return std::uniform_int_distribution<int>(low[item], high[item])(rng);
+  }
+
+  int min() const { return *std::min_element(low.begin(), low.end()); }
+  int max() const { return *std::max_element(high.begin(), high.end()); }
+
+private:
+  std::vector<int> low, high;
+  std::vector<double> cumulative;
+};
+
+struct Options {
+  std::string sequences_file = "sequences.txt";
+  std::string patterns_file = "patterns.txt";
+  std::string answers_file = "answers.txt";
+  std::string approx_answers_file = "answers-k-%d.txt";
+  long long count = DEFAULT_COUNT;
+  int length = DEFAULT_LENGTH;
+  int variance = 0;
+  int patterns = DEFAULT_PATTERNS;
+  std::string pattern_lengths = "9";
+  std::string gaps = "0";
+  double density = 0; // Planted copies per 1000 characters
+  std::vector<int> ks;
+  std::uint64_t seed = 0;
+  bool seeded = false;
+  int threads = 1;
+  bool binary = false;
+};
+
+/*
+  The trie of the patterns, over the encoded alphabet, with 0 for no edge. The
+  edges of state s are edges[edges_start[s]] up to edges[edges_start[s + 1]],
+  and the patterns that end at it are those of `ends` from ends_start[s] up to
+  ends_start[s + 1].
+*/
+struct PatternTrie {
+  struct Edge {
+    int c, state;
+  };
+
+  std::vector<std::array<int, DNA_ASIZE>> next;
+  std::vector<int> edges_start, ends_start;
+  std::vector<Edge> edges;
+  std::vector<int> ends;
+  int depth = 0; // The length of the longest pattern
+
+  explicit PatternTrie(std::vector<std::string> const &patterns) : next(1) {
+    std::vector<int> state_of;
+    next[0].fill(0);
+    for (std::string const &pattern : patterns) {
+      int state = 0;
+      for (char c : pattern) {
+        if (next[state][c] == 0) {
+          next[state][c] = next.size();
+          next.emplace_back().fill(0);
+        }
+        state = next[state][c];
+      }
+      state_of.push_back(state);
+      depth = std::max<int>(depth, pattern.size());
+    }
+
+    edges_start.assign(1, 0);
+    for (auto const &row : next) {
+      for (int c = 0; c < DNA_ASIZE; c++)
+        if (row[c] != 0)
+          edges.push_back(Edge{c, row[c]});
+      edges_start.push_back(edges.size());
+    }
+
+    ends_start.assign(next.size() + 1, 0);
+    for (int state : state_of)
+      ends_start[state + 1]++;
+    for (std::size_t s = 0; s < next.size(); s++)
+      ends_start[s + 1] += ends_start[s];
+    ends.resize(patterns.size());
+    std::vector<int> filled(ends_start.begin(), ends_start.end() - 1);
+    for (int p = 0; p < (int)patterns.size(); p++)
+      ends[filled[state_of[p]]++] = p;
+  }
+};
+
+// A state of the walk down the trie: the position its character was found
+// at, and the widest gap on the way to it.
+struct TrieStep {
+  int state, at, widest;
+};
+
+/*
+  What a thread keeps between its chunks: the chunk's sequences (encoded, back
+  to back), their text, the counts for each answers file as rows of the
+  chunk's columns, and the totals for the summary.
+*/
+struct ChunkScratch {
+  std::vector<int> lengths;
+  std::vector<char> codes;
+  std::vector<char> text;
+  std::vector<std::int32_t> counts;
+  std::vector<int> places;
+  std::vector<int> by_gap;
+  std::vector<TrieStep> stack;
+  long long planted = 0;
+  std::vector<long long> matches, hits;
+};
+
+static std::string usage(char const *program) {
+  std::ostringstream msg;
+  msg << "Usage: " << program
+      << " [ --seed N ] [ --threads N ] [ --sequences FILE ]"
+         " [ --patterns FILE ] [ --answers FILE ] [ --approx-answers FORMAT ]"
+         " [ --sequence-count N ] [ --sequence-length N ]"
+         " [ --sequence-variance N ] [ --pattern-count N ]"
+         " [ --pattern-length SPEC ] [ --density D ] [ --gaps SPEC ]"
+         " [ -k K[,K...] ] [ --binary ]";
+  return msg.str();
+}
+
+static Options parse_options(int argc, char *argv[]) {
+  Options options;
+  options.threads = std::max(1u, std::thread::hardware_concurrency());
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--binary") {
+      options.binary = true;
+      continue;
+    }
+    if (i + 1 == argc || !arg.starts_with("-"))
+      throw std::runtime_error{usage(argv[0])};
+    std::string value = argv[++i];
+
+    if (arg == "--seed") {
+      options.seed = std::stoull(value);
+      options.seeded = true;
+    } else if (arg == "--threads")
+      options.threads = std::stoi(value);
+    else if (arg == "--sequences")
+      options.sequences_file = value;
+    else if (arg == "--patterns")
+      options.patterns_file = value;
+    else if (arg == "--answers")
+      options.answers_file = value;
+    else if (arg == "--approx-answers")
+      options.approx_answers_file = value;
+    else if (arg == "--sequence-count")
+      options.count = std::stoll(value);
+    else if (arg == "--sequence-length")
+      options.length = std::stoi(value);
+    else if (arg == "--sequence-variance")
+      options.variance = std::stoi(value);
+    else if (arg == "--pattern-count")
+      options.patterns = std::stoi(value);
+    else if (arg == "--pattern-length")
+      options.pattern_lengths = value;
+    else if (arg == "--density")
+      options.density = std::stod(value);
+    else if (arg == "--gaps")
+      options.gaps = value;
+    else if (arg == "-k") {
+      std::istringstream items(value);
+      std::string item;
+      while (std::getline(items, item, ','))
+        options.ks.push_back(std::stoi(item));
+    } else
+      throw std::runtime_error{usage(argv[0])};
+  }
+
+  if (options.count < 1 || options.count > UINT32_MAX || options.patterns < 1)
+    throw std::runtime_error{"There must be at least one sequence and pattern"};
+  if (options.variance < 0 || options.length - options.variance < 1)
+    throw std::runtime_error{"The sequences must be at least 1 long"};
+  if (options.threads < 1)
+    throw std::runtime_error{"--threads must be at least 1"};
+  if (options.density < 0 || options.density > 1000)
+    throw std::runtime_error{"--density must be from 0 to 1000"};
+  for (int k : options.ks)
+    if (k < 0)
+      throw std::runtime_error{"The values of k can't be negative"};
+  if (!options.ks.empty() &&
+      options.approx_answers_file.find("%d") == std::string::npos)
+    throw std::runtime_error{"--approx-answers must have a %d for k"};
+
+  return options;
+}
+
+// A generator for stream `stream` of chunk `chunk`, so that each part of the
+// data has draws of its own.
+static std::mt19937_64 chunk_rng(std::uint64_t seed, std::size_t chunk,
+                                 int stream) {
+  std::seed_seq seq{seed, (std::uint64_t)chunk, (std::uint64_t)stream};
+  return std::mt19937_64(seq);
+}
+
+static std::runtime_error system_error(std::string const &what) {
+  std::ostringstream msg;
+  msg << what << ": " << std::strerror(errno);
+  return std::runtime_error{msg.str()};
+}
+
+static void write_at(int fd, char const *data, std::size_t size, off_t offset,
+                     std::string const &fname) {
+  while (size > 0) {
+    ssize_t put = pwrite(fd, data, size, offset);
+    if (put < 0 && errno == EINTR)
+      continue;
+    if (put <= 0)
+      throw system_error(fname);
+    data += put;
+    size -= put;
+    offset += put;
+  }
+}
+
+/*
+  Draw `count` distinct patterns, encoded, with lengths from `lengths`.
+*/
+static std::vector<std::string> make_patterns(int count, Spread const &lengths,
+                                              std::mt19937_64 &rng) {
+  std::vector<std::string> patterns;
+  std::unordered_set<std::string> seen;
+  long long attempts = 0;
+
+  while ((int)patterns.size() < count) {
+    if (++attempts > 100LL * count + 1000)
+      throw std::runtime_error{
+          "Couldn't draw that many distinct patterns of those lengths"};
+    std::string pattern(lengths(rng), '\0');
+    for (char &c : pattern)
+      c = rng() % DNA_ASIZE;
+    if (!pattern.empty() && seen.insert(pattern).second)
+      patterns.push_back(pattern);
+  }
+
+  return patterns;
+}
+
+/*
+  Fill `sequence` with random characters, and plant copies of the patterns in
+  it, a copy starting at each position with probability `density` / 1000. Each
+  copy has a gap drawn from `gaps` ahead of each of its characters after the
+  first, filled with characters other than that one. Returns the number of
+  copies planted.
+*/
+static long long fill_sequence(char *sequence, int length,
+                               std::vector<std::string> const &patterns,
+                               double density, Spread const &gaps,
+                               std::string &fragment, std::mt19937_64 &rng) {
+  for (int i = 0; i < length;) {
+    std::uint64_t bits = rng();
+    for (int j = 0; j < 32 && i < length; j++, bits >>= 2)
+      sequence[i++] = bits & 3;
+  }
+  if (density == 0)
+    return 0;
+
+  std::geometric_distribution<int> skip(density / 1000);
+  std::uniform_int_distribution<int> pick(0, patterns.size() - 1);
+  long long planted = 0;
+  for (long long at = skip(rng); at < length; at += skip(rng)) {
+    std::string const &pattern = patterns[pick(rng)];
+    fragment.assign(1, pattern[0]);
+    for (std::size_t i = 1; i < pattern.size(); i++) {
+      for (int gap = gaps(rng); gap > 0; gap--)
+        fragment += (pattern[i] + 1 + rng() % (DNA_ASIZE - 1)) % DNA_ASIZE;
+      fragment += pattern[i];
+    }
+    if (at + (long long)fragment.size() > length)
+      break;
+    std::copy(fragment.begin(), fragment.end(), sequence + at);
+    at += fragment.size();
+    planted++;
+  }
+
+  return planted;
+}
+
+/*
+  Count the matches in `sequence` of all the patterns in `trie`, for each of
+  the answers files' values of k, `file_ks`. The count for file f and pattern
+  p goes to counts[(f * patterns + p) * stride]. The matches are counted by
+  their widest gap first, and those counts summed for each k at the end.
+*/
+static void count_matches(PatternTrie const &trie, std::string_view sequence,
+                          std::vector<int> const &file_ks, int patterns,
+                          std::int32_t *counts, std::size_t stride,
+                          ChunkScratch &mine) {
+  int n = sequence.size();
+  int max_k = *std::max_element(file_ks.begin(), file_ks.end());
+
+  std::vector<int> &by_gap = mine.by_gap;
+  by_gap.assign((max_k + 1) * patterns, 0);
+  if (max_k == 0) {
+    // Without gaps, the walk from each position is a single path.
+    for (int i = 0; i < n; i++)
+      for (int at = i, state = trie.next[0][sequence[i]]; state != 0;
+           state = ++at < n ? trie.next[state][sequence[at]] : 0)
+        for (int e = trie.ends_start[state]; e < trie.ends_start[state + 1];
+             e++)
+          by_gap[trie.ends[e]]++;
+  } else {
+    // places[j * DNA_ASIZE + c] is the first position from j on that has c,
+    // or n if there is none, which is where a character after j - 1 is
+    // found.
+    std::vector<int> &places = mine.places;
+    places.resize((n + 1) * DNA_ASIZE);
+    std::fill_n(places.begin() + n * DNA_ASIZE, DNA_ASIZE, n);
+    for (int j = n - 1; j >= 0; j--) {
+      std::copy_n(places.begin() + (j + 1) * DNA_ASIZE, DNA_ASIZE,
+                  places.begin() + j * DNA_ASIZE);
+      places[j * DNA_ASIZE + sequence[j]] = j;
+    }
+
+    // The stack holds no more than the branches left on the way down. A step
+    // is written to it before it is known whether it is taken, so that the
+    // walk doesn't branch on the sequence.
+    mine.stack.resize(trie.depth * DNA_ASIZE + 1);
+    TrieStep *stack = mine.stack.data();
+    for (int i = 0; i < n; i++) {
+      int top = 0;
+      stack[top] = TrieStep{trie.next[0][sequence[i]], i, 0};
+      top += stack[top].state != 0;
+      while (top > 0) {
+        TrieStep step = stack[--top];
+        for (int e = trie.ends_start[step.state];
+             e < trie.ends_start[step.state + 1]; e++)
+          by_gap[step.widest * patterns + trie.ends[e]]++;
+
+        int const *after = &places[(step.at + 1) * DNA_ASIZE];
+        for (int e = trie.edges_start[step.state];
+             e < trie.edges_start[step.state + 1]; e++) {
+          PatternTrie::Edge edge = trie.edges[e];
+          int at = after[edge.c];
+          int gap = at - step.at - 1;
+          stack[top] = TrieStep{edge.state, at, std::max(step.widest, gap)};
+          top += at < n && gap <= max_k;
+        }
+      }
+    }
+  }
+
+  for (std::size_t f = 0; f < file_ks.size(); f++)
+    for (int p = 0; p < patterns; p++) {
+      std::int32_t total = 0;
+      for (int gap = 0; gap <= file_ks[f]; gap++)
+        total += by_gap[gap * patterns + p];
+      counts[(f * patterns + p) * stride] = total;
+    }
+}
+
+/*
+  Write the binary answers file `binary` out again as the text file `text`,
+  a block of rows at a time, each row formatted by one of the threads.
+*/
+static void write_text_answers(std::string const &binary,
+                               std::string const &text, ThreadPool &pool) {
+  int k = -1;
+  AnswersTable table = read_answers(binary, &k);
+  std::ofstream out(text, std::ios::binary);
+  if (!out)
+    throw system_error(text);
+  out << table.size() << " " << table.columns();
+  if (k >= 0)
+    out << " " << k;
+  out << "\n";
+
+  int rows = table.size();
+  int block = std::max<std::size_t>(pool.size(),
+                                    TEXT_COUNTS / std::max<std::size_t>(
+                                                      table.columns(), 1));
+  std::vector<std::string> lines(std::min(block, rows));
+  for (int start = 0; start < rows; start += block) {
+    int count = std::min(block, rows - start);
+    pool.parallel_for(count, 1, [&](int begin, int end, int) {
+      char number[16];
+      for (int r = begin; r < end; r++) {
+        std::int32_t const *row = table[start + r];
+        std::string &line = lines[r];
+        line.clear();
+        for (std::size_t s = 0; s < table.columns(); s++) {
+          if (s)
+            line += ',';
+          auto [last, failed] =
+              std::to_chars(number, number + sizeof(number), row[s]);
+          line.append(number, last);
+        }
+        line += '\n';
+      }
+    });
+    for (int r = 0; r < count; r++)
+      out << lines[r];
+  }
+
+  if (!out.flush())
+    throw system_error(text);
+}
+
+int main(int argc, char *argv[]) {
+  Options options = parse_options(argc, argv);
+  if (!options.seeded)
+    options.seed = std::random_device{}();
+  Spread lengths(options.pattern_lengths, "pattern lengths");
+  Spread gaps(options.gaps, "gaps");
+  if (lengths.min() < 1)
+    throw std::runtime_error{"The patterns must be at least 1 long"};
+
+  double start = get_time();
+  ThreadPool pool(options.threads);
+
+  // The patterns come from a generator of their own, ahead of the chunks'.
+  std::mt19937_64 rng = chunk_rng(options.seed, 0, 0);
+  std::vector<std::string> patterns =
+      make_patterns(options.patterns, lengths, rng);
+  PatternTrie trie(patterns);
+  int patterns_count = patterns.size();
+  {
+    std::ofstream out(options.patterns_file, std::ios::binary);
+    out << patterns_count << " " << lengths.max() << "\n";
+    for (std::string pattern : patterns) {
+      for (char &c : pattern)
+        c = DNA_ALPHABET[c];
+      out << pattern << "\n";
+    }
+    if (!out.flush())
+      throw system_error(options.patterns_file);
+  }
+
+  // The answers files: the exact answers first, as k = 0, then one for each
+  // k. With text answers, the binary ones are written next to them first.
+  std::vector<int> file_ks{0};
+  std::vector<std::string> names{options.answers_file};
+  for (int k : options.ks) {
+    std::string name = options.approx_answers_file;
+    name.replace(name.find("%d"), 2, std::to_string(k));
+    file_ks.push_back(k);
+    names.push_back(name);
+  }
+  int files = names.size();
+  std::size_t count = options.count;
+  std::vector<int> fds;
+  for (int f = 0; f < files; f++) {
+    std::string name = options.binary ? names[f] : names[f] + ".part";
+    int fd = open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+      throw system_error(name);
+    fds.push_back(fd);
+    AnswersHeader header{};
+    std::memcpy(header.magic, ANSWERS_MAGIC, sizeof(header.magic));
+    header.version = ANSWERS_VERSION;
+    header.rows = patterns_count;
+    header.columns = count;
+    header.k = f == 0 ? -1 : file_ks[f];
+    write_at(fd, reinterpret_cast<char const *>(&header), sizeof(header), 0,
+             name);
+    off_t size = ANSWERS_HEADER_SIZE + patterns_count * count * 4;
+    if (ftruncate(fd, size) < 0)
+      throw system_error(name);
+  }
+
+  // Cut the sequences into chunks, and place each chunk in the sequences file
+  // from the lengths of its sequences.
+  int longest = options.length + options.variance;
+  std::size_t per_chunk = std::max<std::size_t>(
+      1, std::min(CHUNK_BYTES / longest,
+                  CHUNK_COUNTS / ((std::size_t)files * patterns_count)));
+  std::size_t chunks = (count + per_chunk - 1) / per_chunk;
+  std::uniform_int_distribution<int> length_of(
+      options.length - options.variance, longest);
+  std::ostringstream first_line;
+  first_line << count << " " << longest << "\n";
+  std::string heading = first_line.str();
+  std::vector<off_t> offsets(chunks + 1, heading.size());
+  for (std::size_t c = 0; c < chunks; c++) {
+    std::mt19937_64 rng = chunk_rng(options.seed, c, 1);
+    std::size_t in_chunk = std::min(per_chunk, count - c * per_chunk);
+    off_t bytes = 0;
+    for (std::size_t s = 0; s < in_chunk; s++)
+      bytes += length_of(rng) + 1;
+    offsets[c + 1] = offsets[c] + bytes;
+  }
+
+  int sequences_fd =
+      open(options.sequences_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (sequences_fd < 0)
+    throw system_error(options.sequences_file);
+  write_at(sequences_fd, heading.data(), heading.size(), 0,
+           options.sequences_file);
+
+  std::vector<ChunkScratch> scratch(pool.size());
+  for (ChunkScratch &mine : scratch) {
+    mine.matches.assign(files, 0);
+    mine.hits.assign(files, 0);
+  }
+  pool.parallel_for(chunks, 1, [&](int begin, int end, int thread) {
+    ChunkScratch &mine = scratch[thread];
+    std::string fragment;
+    for (int c = begin; c < end; c++) {
+      std::size_t first = c * per_chunk;
+      std::size_t in_chunk = std::min(per_chunk, count - first);
+      std::mt19937_64 length_rng = chunk_rng(options.seed, c, 1);
+      std::mt19937_64 rng = chunk_rng(options.seed, c, 2);
+
+      mine.lengths.resize(in_chunk);
+      std::size_t total = 0;
+      for (int &length : mine.lengths) {
+        length = length_of(length_rng);
+        total += length;
+      }
+      mine.codes.resize(total);
+      mine.text.resize(offsets[c + 1] - offsets[c]);
+      mine.counts.assign(files * patterns_count * in_chunk, 0);
+
+      char *sequence = mine.codes.data();
+      char *text = mine.text.data();
+      for (std::size_t s = 0; s < in_chunk; s++) {
+        int length = mine.lengths[s];
+        mine.planted += fill_sequence(sequence, length, patterns,
+                                      options.density, gaps, fragment, rng);
+        count_matches(trie, std::string_view(sequence, length), file_ks,
+                      patterns_count, mine.counts.data() + s, in_chunk,
+                      mine);
+        for (int i = 0; i < length; i++)
+          *text++ = DNA_ALPHABET[sequence[i]];
+        *text++ = '\n';
+        sequence += length;
+      }
+      write_at(sequences_fd, mine.text.data(), mine.text.size(), offsets[c],
+               options.sequences_file);
+
+      for (int f = 0; f < files; f++)
+        for (int p = 0; p < patterns_count; p++) {
+          std::int32_t const *row =
+              mine.counts.data() + (f * patterns_count + p) * in_chunk;
+          for (std::size_t s = 0; s < in_chunk; s++) {
+            mine.matches[f] += row[s];
+            mine.hits[f] += row[s] != 0;
+          }
+          write_at(fds[f], reinterpret_cast<char const *>(row),
+                   in_chunk * sizeof(std::int32_t),
+                   ANSWERS_HEADER_SIZE + (p * count + first) * 4, names[f]);
+        }
+    }
+  });
+  close(sequences_fd);
+  for (int fd : fds)
+    close(fd);
+  double generate_time = get_time() - start;
+
+  if (!options.binary)
+    for (int f = 0; f < files; f++) {
+      write_text_answers(names[f] + ".part", names[f], pool);
+      std::remove((names[f] + ".part").c_str());
+    }
+  double total_time = get_time() - start;
+
+  long long planted = 0;
+  for (ChunkScratch const &mine : scratch)
+    planted += mine.planted;
+  std::cout << "seed: " << options.seed << "\n"
+            << "sequences: " << count << "\n"
+            << "sequence_bytes: " << offsets[chunks] - offsets[0] - count
+            << "\n"
+            << "patterns: " << patterns_count << "\n"
+            << "planted: " << planted << "\n"
+            << "threads: " << pool.size() << "\n"
+            << "generate_time: " << generate_time << "\n"
+            << "total_time: " << total_time << "\n"
+            << "answers:\n";
+  for (int f = 0; f < files; f++) {
+    long long matches = 0, hits = 0;
+    for (ChunkScratch const &mine : scratch) {
+      matches += mine.matches[f];
+      hits += mine.hits[f];
+    }
+    // The hit rate is the share of pattern/sequence pairs with a match, which
+    // is what `random_data.py` reports as its "matching".
+    std::cout << "  - file: " << names[f] << "\n"
+              << "    k: " << file_ks[f] << "\n"
+              << "    matches: " << matches << "\n"
+              << "    hit_rate: "
+              << (double)hits / ((double)patterns_count * count) << "\n";
+  }
+
+  return 0;
+}
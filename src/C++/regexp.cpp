@@ -1,70 +1,174 @@
 /*
   C++ implementation of the (tentatively-titled) DFA-Gap algorithm for
   approximate string matching, regular expression version.
+
+  This uses the PCRE2 library directly. Each pattern is compiled once, and
+  JIT-compiled when the library supports it. The state needed for matching
+  (the match data block and the JIT stack) is kept per thread and reused from
+  one sequence to the next, so that this can be run with `--threads`.
 */
 
-#include <regex>
+#include <memory>
 #include <sstream>
+#include <stdexcept>
 #include <string>
-#include <vector>
+#include <string_view>
+
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+
+#include "run.hpp"
+
+// The sizes for the per-thread JIT stack. The expressions are all a single
+// lookahead of bounded repeats, so this is generous.
+constexpr PCRE2_SIZE JIT_STACK_START = 32 * 1024;
+constexpr PCRE2_SIZE JIT_STACK_MAX = 1024 * 1024;
 
 /*
-  This file comes from the GitHub repo: https://github.com/jpcre2/jpcre2
+  The preprocessed form of a pattern: the compiled expression, which this
+  owns, and whether it was JIT-compiled.
 */
-#include "jpcre2.hpp"
-#include "run.hpp"
-typedef jpcre2::select<char> jp;
+struct RegexpPattern {
+  struct Free {
+    void operator()(pcre2_code *code) const { pcre2_code_free(code); }
+  };
+
+  std::unique_ptr<pcre2_code, Free> code;
+  bool jit = false;
+};
+
+/*
+  The per-thread state for matching: one match data block and one JIT stack,
+  created the first time a thread matches anything.
+*/
+struct Matcher {
+  pcre2_match_data *match_data;
+  pcre2_match_context *context;
+  pcre2_jit_stack *jit_stack;
+
+  Matcher() {
+    // Only the position of each match is used, so one pair suffices.
+    match_data = pcre2_match_data_create(1, nullptr);
+    context = pcre2_match_context_create(nullptr);
+    jit_stack = pcre2_jit_stack_create(JIT_STACK_START, JIT_STACK_MAX, nullptr);
+    if (!match_data || !context || !jit_stack)
+      throw std::runtime_error{"regexp: unable to allocate matcher state"};
+    pcre2_jit_stack_assign(context, nullptr, jit_stack);
+  }
+  ~Matcher() {
+    pcre2_jit_stack_free(jit_stack);
+    pcre2_match_context_free(context);
+    pcre2_match_data_free(match_data);
+  }
+};
+
+/*
+  Turn a PCRE2 error code into an exception.
+*/
+[[noreturn]] static void pcre2_failure(char const *what, int error_code) {
+  PCRE2_UCHAR message[256];
+  pcre2_get_error_message(error_code, message, sizeof(message));
 
-jp::Regex re;
+  std::ostringstream error;
+  error << "regexp: " << what << ": " << (char const *)message;
+  throw std::runtime_error{error.str()};
+}
 
 /*
-  Initialize the pattern given. This is a break from the usual init/algorithm
-  pattern, because adding the jp::Regex type to one of the std::variant defs
-  in `run.hpp` would have required all algorithm experiments to link against
-  the PCRE2 library. So, for here, I just use a global.
+  Initialize the pattern given, by building the expression for it and
+  compiling that. The return value is the compiled expression.
+
+  The expression is a lookahead only, so that overlapping matches at every
+  position are counted, and has no capturing group, since nothing is ever
+  extracted from the matches.
 */
-std::vector<ApproxPatternData> init_regexp(std::string const &pattern, int k) {
-  std::vector<ApproxPatternData> return_val;
-  return_val.reserve(1);
+RegexpPattern init_regexp(std::string const &pattern, int k) {
+  RegexpPattern return_val;
 
   std::ostringstream re_buf;
-  re_buf << "(?=(" << pattern[0];
+  re_buf << "(?=" << pattern[0];
   for (unsigned int i = 1; i < pattern.length(); i++) {
     re_buf << "[^" << pattern[i] << "]{0," << k << "}" << pattern[i];
   }
-  re_buf << "))";
+  re_buf << ")";
+  std::string expression = re_buf.str();
 
-  re.setPattern(re_buf.str()).compile();
+  int error_code;
+  PCRE2_SIZE error_offset;
+  pcre2_code *code =
+      pcre2_compile((PCRE2_SPTR)expression.data(), expression.length(), 0,
+                    &error_code, &error_offset, nullptr);
+  if (!code)
+    pcre2_failure("compile failed", error_code);
+  return_val.code.reset(code);
+
+  // If the library was built without JIT support this fails, and matching
+  // falls back to the interpreter.
+  return_val.jit = pcre2_jit_compile(code, PCRE2_JIT_COMPLETE) == 0;
 
   return return_val;
 }
 
 /*
   Perform the DFA-Gap-Regexp algorithm on the given (processed) pattern against
-  the given sequence.
+  the given sequence. The number of matches is returned, and each match is
+  reported to `sink` (see `run.hpp`).
 */
-int regexp(std::vector<ApproxPatternData> const &pat_data,
-           std::string const &sequence) {
-  // The pat_data vector is not actually used in this instance.
-  jp::VecNum match_vec;
-  jp::RegexMatch matcher;
-
-  size_t matches = matcher.setRegexObject(&re)
-                       .setSubject(&sequence)
-                       .addModifier("g")
-                       .setNumberedSubstringVector(&match_vec)
-                       .match();
-
-  return (int)matches;
+template <typename Sink>
+static int regexp_search(RegexpPattern const &pat_data,
+                         std::string_view sequence, Sink sink) {
+  pcre2_code const *code = pat_data.code.get();
+  bool jit = pat_data.jit;
+
+  thread_local Matcher matcher;
+  PCRE2_SIZE const *ovector = pcre2_get_ovector_pointer(matcher.match_data);
+  auto subject = (PCRE2_SPTR)sequence.data();
+  PCRE2_SIZE n = sequence.length();
+
+  int matches = 0;
+  PCRE2_SIZE start = 0;
+  // Every match is empty (the expression is all lookahead), so the next
+  // search starts one past the last match.
+  while (start <= n) {
+    int rc = jit ? pcre2_jit_match(code, subject, n, start, 0,
+                                   matcher.match_data, matcher.context)
+                 : pcre2_match(code, subject, n, start, 0, matcher.match_data,
+                               matcher.context);
+    if (rc == PCRE2_ERROR_NOMATCH)
+      break;
+    if (rc < 0)
+      pcre2_failure("match failed", rc);
+
+    matches++;
+    if constexpr (Sink::reports) {
+      sink(ovector[0]);
+      if (sink.full(matches))
+        break;
+    }
+    start = ovector[0] + 1;
+  }
+
+  return matches;
+}
+
+int regexp(RegexpPattern const &pat_data, std::string_view sequence) {
+  return regexp_search(pat_data, sequence, CountOnly{});
+}
+
+int regexp_locate(RegexpPattern const &pat_data, std::string_view sequence,
+                  HitSink sink) {
+  return regexp_search(pat_data, sequence, sink);
 }
 
 /*
   All that is done here is call the run_approx() function with a pointer to the
   algorithm initializer, a pointer to the algorithm implementation, the label
-  for the algorithm, and the argc/argv values.
+  for the algorithm, and the argc/argv values. The locating search is used for
+  `--positions`.
 */
 int main(int argc, char *argv[]) {
-  int return_code = run_approx(&init_regexp, &regexp, "regexp", argc, argv);
+  int return_code = run_approx(&init_regexp, &regexp, "regexp", argc, argv,
+                               Encoding::ascii, nullptr, &regexp_locate);
 
   return return_code;
 }
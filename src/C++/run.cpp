@@ -2,24 +2,99 @@
   This is the "runner" module. It provides the functions that will handle
   running the experiments. There are three primary runner functions here:
 
-    * run() - Runs a single-pattern, exact-matching algorithm
-    * run_multi() - Runs a multi-pattern, exact-matching algorithm
-    * run_approx() - Runs a single-pattern, approximate-matching algorithm
+    * run_matcher() - Runs a single-pattern, exact-matching algorithm
+    * run_multi_matcher() - Runs a multi-pattern, exact-matching algorithm
+    * run_approx_matcher() - Runs a single-pattern, approximate-matching
+      algorithm
 
   These are mostly identical, but just different-enough to require separate
-  functions. The data-input handling is brought in from `input.cpp`.
+  functions. Each works through a matcher interface from `run.hpp`, which the
+  run(), run_multi() and run_approx() templates there build from an
+  algorithm's functions. The data-input handling is brought in from
+  `input.cpp`.
+
+  Each runner accepts the option `--threads N` ahead of its usual arguments.
+  With N > 1 the sequences are sharded across a pool of N threads (see
+  `pool.cpp`); the answers are checked the same way either way.
+
+  The single-pattern runners also accept `--tile BYTES` (and, with it,
+  `--tile-patterns N`). Normally each pattern is taken across all of the
+  sequences in turn, which reads the whole of the sequence data once per
+  pattern. With tiling, the sequences are cut into tiles of about BYTES each,
+  and each tile is taken through a block of N patterns before moving on, so
+  the data is read once per block instead. The results are the same. Every
+  runner reports the number of bytes of sequence data it read, to compare the
+  two.
+
+  Every runner also accepts `--stream BYTES`. The sequences file is then read
+  in chunks of about BYTES, by a thread that reads the next chunk while the
+  current one is matched (see `SequenceStream` in `input.hpp`), and the
+  answers are read and checked a chunk at a time as well. All of the patterns
+  are prepared up front and each chunk is run against all of them, so the
+  memory used depends on the chunk size rather than on the size of the data.
+
+  And every runner accepts `--pattern-cache FILE`, to read the preprocessed
+  patterns from a cache file instead of preprocessing them (see `cache.hpp`).
+  The file is built, before the timer starts, if it is missing or was built
+  for other patterns or another k. The output says whether it was.
+
+  Finally, `--positions FILE` writes the offset of every match to FILE, one
+  "pattern,sequence,offset" line each (numbered from 0), through the locating
+  forms of the algorithms' searches (see HitSink in `run.hpp`). Each thread
+  gathers its hits in a buffer of its own, which is written out a batch at a
+  time. Without the option the counting searches are used as before.
+
+  The same locating searches give `--mode`. The default, `count`, counts every
+  match. `exists` stops each search at the first match of each pattern, and
+  `first:N` at the first N, so that the counts found are the answers capped at
+  1 (or N), which is what they are checked against. Hits are only written for
+  the matches that were found.
+
+  For benchmarking, `--bench N` reads the data once and then repeats the
+  timed part of the run N times (after `--warmup W` untimed runs, 1 by
+  default), timing the preparing of the patterns and the matching apart. Each
+  iteration is written as a YAML record of its own, and a summary follows (see
+  run_bench()).
+
+  And `--counters` adds, for each phase of the run (see `counters.hpp`), the
+  time, the hardware events and the energy used, as counted in-process.
+
+  Instead of matching a sequences file, `--serve ADDRESS` turns a runner into
+  a server (see `serve.hpp`): the patterns (and k) are given as usual, but no
+  sequences or answers. The patterns are prepared once, and the server then
+  answers requests for the counts of sets of sequences, sent on the standard
+  input or to a Unix socket, until it is stopped. Only `--threads` and
+  `--pattern-cache` apply to a server.
+
+  Apart from these, run_batch_matcher() runs the batch matchers, which match
+  the whole of the pattern/sequence matrix at once on an offload device. It
+  takes only the `--bench` and `--counters` options.
 */
 
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <sys/resource.h>
 #include <sys/time.h>
 #include <vector>
 
+#include "cache.hpp"
+#include "counters.hpp"
 #include "input.hpp"
+#include "pool.hpp"
 #include "run.hpp"
+#include "serve.hpp"
 
 // Identify the language by the compiler.
 #if defined(__INTEL_LLVM_COMPILER)
@@ -30,6 +105,77 @@
 #define LANG "cpp-gcc"
 #endif
 
+// The number of sequences in each chunk of work handed out by the thread
+// pool. Small enough for the pool to balance the load, large enough that the
+// cost of claiming a chunk disappears next to the matching.
+constexpr int CHUNK_SIZE = 64;
+
+// The default number of patterns in a block, when tiling.
+constexpr int TILE_PATTERNS = 16;
+
+// The number of hits that each thread's buffer holds, for `--positions`.
+constexpr std::size_t HIT_BUFFER = 4096;
+
+// The options that the single-pattern runners take, beyond the common ones.
+constexpr char SINGLE_OPTIONS[] = "[ --tile BYTES [ --tile-patterns N ] ] "
+                                  "[ --stream BYTES ] ";
+
+/*
+  The options that may be given ahead of the positional arguments. A
+  `tile_bytes` of 0 means no tiling, and an empty `pattern_cache` (or
+  `positions`) no cache (or no positions). `limit` is 0 in the `count` mode,
+  1 in `exists` and N in `first:N`.
+*/
+struct RunOptions {
+  int threads = 1;
+  int tile_bytes = 0;
+  int tile_patterns = TILE_PATTERNS;
+  int stream_bytes = 0;
+  int limit = 0; // From `--mode`: the matches wanted per pattern, 0 for all
+  int bench = 0;  // The iterations for `--bench`, 0 for a plain run
+  int warmup = 1;
+  bool counters = false; // `--counters`, for the counts of each phase
+  std::string pattern_cache;
+  std::string positions;
+  std::string serve; // The address of `--serve`, empty for a plain run
+};
+
+/*
+  A run of consecutive sequences, [begin, end), and the number of bytes of
+  sequence data in it.
+*/
+struct Tile {
+  int begin;
+  int end;
+  std::size_t bytes;
+};
+
+/*
+  A pattern/sequence pair for which the count found did not agree with the
+  answers file. The threaded runners gather these per-thread, and report them
+  in order once the threads are done.
+*/
+struct Mismatch {
+  int pattern;
+  int sequence;
+  int found;
+  int expected;
+};
+
+/*
+  What one run of the timed part of a runner measured: the time taken, and the
+  parts of it spent preparing the patterns (`init`) and matching them and
+  checking the counts (`match`), the bytes of sequence data read, and the
+  number of mismatches.
+*/
+struct Timing {
+  double runtime = 0;
+  double init = 0;
+  double match = 0;
+  std::size_t bytes = 0;
+  int mismatches = 0;
+};
+
 /*
   Simple measure of the wall-clock down to the usec. Adapted from StackOverflow.
 */
@@ -40,161 +186,1448 @@ double get_time() {
 }
 
 /*
-  The basic "runner" function. This takes pointers to the algorithm initializer
-  and implementation, the name of the algorithm, argc and argv from the
-  invocation, and runs the experiment over the given algorithm.
+  Pull the options out of argc/argv, leaving the program name and the
+  positional arguments behind in the same order. This way the argument checks
+  in the runners are the same with or without options.
+*/
+RunOptions parse_options(int &argc, char *argv[], std::string const &usage) {
+  RunOptions options;
+  int kept = 1;
+
+  // Read the value of the option at argv[i], which must be at least `least`.
+  auto value = [&](int &i, int least) {
+    int result;
+    if (i + 1 == argc)
+      throw std::runtime_error{usage};
+    try {
+      result = std::stoi(argv[++i]);
+    } catch (std::logic_error const &) {
+      throw std::runtime_error{usage};
+    }
+    if (result < least) {
+      std::ostringstream error;
+      error << argv[i - 1] << " must be at least " << least;
+      throw std::runtime_error{error.str()};
+    }
+
+    return result;
+  };
+  // Read the file name given to the option at argv[i].
+  auto path = [&](int &i) {
+    if (i + 1 == argc)
+      throw std::runtime_error{usage};
+    return std::string{argv[++i]};
+  };
+  // Read the match mode given to the option at argv[i], as a limit.
+  auto mode = [&](int &i) {
+    std::string name = path(i);
+    if (name == "count")
+      return 0;
+    if (name == "exists")
+      return 1;
+    int limit = 0;
+    if (name.rfind("first:", 0) == 0) {
+      auto [end, error] = std::from_chars(name.data() + 6,
+                                          name.data() + name.length(), limit);
+      if (error != std::errc{} || end != name.data() + name.length())
+        limit = 0;
+    }
+    if (limit < 1)
+      throw std::runtime_error{"--mode must be count, exists or first:N"};
+
+    return limit;
+  };
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--threads") == 0)
+      options.threads = value(i, 1);
+    else if (std::strcmp(argv[i], "--tile") == 0)
+      options.tile_bytes = value(i, 1);
+    else if (std::strcmp(argv[i], "--tile-patterns") == 0)
+      options.tile_patterns = value(i, 1);
+    else if (std::strcmp(argv[i], "--stream") == 0)
+      options.stream_bytes = value(i, 1);
+    else if (std::strcmp(argv[i], "--pattern-cache") == 0)
+      options.pattern_cache = path(i);
+    else if (std::strcmp(argv[i], "--positions") == 0)
+      options.positions = path(i);
+    else if (std::strcmp(argv[i], "--mode") == 0)
+      options.limit = mode(i);
+    else if (std::strcmp(argv[i], "--bench") == 0)
+      options.bench = value(i, 1);
+    else if (std::strcmp(argv[i], "--warmup") == 0)
+      options.warmup = value(i, 0);
+    else if (std::strcmp(argv[i], "--counters") == 0)
+      options.counters = true;
+    else if (std::strcmp(argv[i], "--serve") == 0)
+      options.serve = path(i);
+    else
+      argv[kept++] = argv[i];
+  }
+  argc = kept;
+  // A benchmark repeats the run over the same data, which a stream only gives
+  // once, and would write the positions over and over.
+  if (options.bench && (options.stream_bytes || !options.positions.empty()))
+    throw std::runtime_error{
+        "--bench can't be used with --stream or --positions"};
+  // A streamed run reads the input while it matches, so it has no phases.
+  if (options.counters && options.stream_bytes)
+    throw std::runtime_error{"--counters can't be used with --stream"};
+  // A server has no data of its own to benchmark, stream, tile or give the
+  // positions in, and its answers are always the counts.
+  if (!options.serve.empty() &&
+      (options.bench || options.stream_bytes || options.tile_bytes ||
+       !options.positions.empty() || options.limit || options.counters))
+    throw std::runtime_error{
+        "--serve only takes --threads and --pattern-cache"};
+
+  return options;
+}
+
+/*
+  Build the usage message for a runner, given the options beyond the common
+  ones that it takes and the positional arguments it expects.
+*/
+std::string usage(char const *program, char const *extra,
+                  char const *positional) {
+  std::ostringstream message;
+  message << "Usage: " << program
+          << " [ --threads N ] [ --pattern-cache FILE ] [ --positions FILE ] "
+          << "[ --mode count|exists|first:N ] [ --bench N [ --warmup N ] ] "
+          << "[ --counters ] " << extra << positional << "\n       "
+          << program << " --serve ADDRESS [ --threads N ] "
+          << "[ --pattern-cache FILE ] "
+          << (std::strncmp(positional, "<k> ", 4) ? "" : "<k> ")
+          << "<patterns>";
+
+  return message.str();
+}
+
+/*
+  Cut the sequences (a SequenceStore or a SequenceChunk) into tiles. With
+  `tile_bytes` set, each tile holds as many sequences as fit in that many bytes
+  (but at least one). Otherwise each tile is `count` sequences.
+*/
+template <typename Sequences>
+std::vector<Tile> make_tiles(Sequences const &sequences_data,
+                             std::size_t tile_bytes, int count) {
+  std::vector<Tile> tiles;
+  int sequences_count = sequences_data.size();
+
+  for (int sequence = 0; sequence < sequences_count;) {
+    Tile tile{sequence, sequence, 0};
+    while (tile.end < sequences_count) {
+      std::size_t length = sequences_data[tile.end].length();
+      if (tile_bytes ? tile.end > tile.begin && tile.bytes + length > tile_bytes
+                     : tile.end - tile.begin == count)
+        break;
+      tile.bytes += length;
+      tile.end++;
+    }
+    tiles.push_back(tile);
+    sequence = tile.end;
+  }
+
+  return tiles;
+}
+
+/*
+  Encode the sequences and the patterns into the DNA alphabet, for those
+  algorithms that have been written to use it.
+*/
+void encode_data(SequenceStore &sequences_data,
+                 std::vector<std::string> &patterns_data) {
+  sequences_data.encode();
+  for (auto &pattern : patterns_data)
+    pattern = encode_dna(pattern);
+}
+
+/*
+  Open the pattern cache named by `--pattern-cache`, if there is one. The
+  cache holds `entries` entries for the patterns, which `save(writer, entry)`
+  writes when the cache has to be built. The patterns (as given to the
+  algorithm), `name`, `encoding`, `k` and the `layout` of the algorithm's
+  pattern type are what the cache is checked against.
+*/
+std::unique_ptr<PatternCache>
+open_cache(RunOptions const &options, bool cacheable, std::uint64_t layout,
+           std::string const &name, Encoding encoding, int k,
+           std::vector<std::string> const &patterns, std::size_t entries,
+           PatternCache::Save const &save) {
+  if (options.pattern_cache.empty())
+    return nullptr;
+  if (!cacheable) {
+    std::ostringstream error;
+    error << "The patterns of " << name << " can't be cached";
+    throw std::runtime_error{error.str()};
+  }
+
+  CacheKey key{name, (int)encoding, k, hash_patterns(patterns), entries,
+               layout};
+  return std::make_unique<PatternCache>(options.pattern_cache, key, save);
+}
+
+/*
+  The file that `--positions` writes the hits to, and the per-thread buffers
+  that the hits are gathered in. A full buffer is formatted by the thread that
+  filled it, and only the write itself is done under the lock, so the lines
+  of different threads come out in no particular order. finish() writes out
+  what is left in the buffers, once the threads are done, and returns the
+  number of hits.
+*/
+class HitWriter {
+public:
+  HitWriter(std::string const &fname, int threads) : fname(fname) {
+    file.open(fname, std::ios::trunc);
+    if (!file) {
+      std::ostringstream error;
+      error << "Error opening " << fname << " for writing";
+      throw std::runtime_error{error.str()};
+    }
+    for (int thread = 0; thread < threads; thread++)
+      buffers.emplace_back(HIT_BUFFER, [this](Hit const *hits,
+                                              std::size_t count) {
+        write(hits, count);
+      });
+  }
+
+  HitBuffer &buffer(int thread) { return buffers[thread]; }
+
+  std::size_t finish() {
+    for (auto &buffer : buffers)
+      buffer.flush();
+    file.close();
+    if (!file) {
+      std::ostringstream error;
+      error << "Error writing positions to " << fname;
+      throw std::runtime_error{error.str()};
+    }
+
+    return written;
+  }
+
+private:
+  void write(Hit const *hits, std::size_t count) {
+    // Room for three numbers, two commas and a newline per hit.
+    std::vector<char> text(count * 48);
+    char *at = text.data();
+    for (std::size_t i = 0; i < count; i++) {
+      at = std::to_chars(at, at + 12, hits[i].pattern).ptr;
+      *at++ = ',';
+      at = std::to_chars(at, at + 12, hits[i].sequence).ptr;
+      *at++ = ',';
+      at = std::to_chars(at, at + 21, hits[i].offset).ptr;
+      *at++ = '\n';
+    }
+
+    std::lock_guard<std::mutex> hold(lock);
+    file.write(text.data(), at - text.data());
+    written += count;
+  }
+
+  std::string fname;
+  std::ofstream file;
+  std::mutex lock;
+  std::size_t written = 0;
+  std::vector<HitBuffer> buffers;
+};
+
+/*
+  Open the file for `--positions`, if it was given, with a buffer for each of
+  `threads` threads. Both it and `--mode` need the locating search, which is
+  checked for here.
+*/
+std::unique_ptr<HitWriter> open_hits(RunOptions const &options, bool locates,
+                                     std::string const &name, int threads) {
+  if (!locates && (options.limit || !options.positions.empty())) {
+    std::ostringstream error;
+    error << name
+          << (options.limit ? " can't stop at the first matches"
+                            : " can't report match positions");
+    throw std::runtime_error{error.str()};
+  }
+  if (options.positions.empty())
+    return nullptr;
+
+  return std::make_unique<HitWriter>(options.positions, threads);
+}
+
+/*
+  Whether a run needs the locating search, for the hits or for the limit.
+*/
+bool locating(HitWriter const *hits, int limit) { return hits || limit; }
+
+/*
+  The count that a run with `limit` should find, for a pattern whose answer
+  is `answer`.
+*/
+int expected_count(int answer, int limit) {
+  return limit ? std::min(answer, limit) : answer;
+}
+
+/*
+  The sink for a search of the given `sequence`, for a run with `hits` (which
+  may be null) and `limit`. `pattern` is the pattern of a single-pattern
+  search; a multi-pattern search gives the pattern `lengths` instead.
+*/
+HitSink make_sink(HitWriter *hits, int thread, int limit, int pattern,
+                  int sequence) {
+  return HitSink(hits ? &hits->buffer(thread) : nullptr, limit, pattern,
+                 sequence);
+}
+HitSink make_sink(HitWriter *hits, int thread, int limit, int sequence,
+                  std::vector<int> const &lengths) {
+  return HitSink(hits ? &hits->buffer(thread) : nullptr, limit, sequence,
+                 lengths.data());
+}
+
+/*
+  Report the match mode, unless it is the default of counting every match.
+*/
+void report_mode(RunOptions const &options) {
+  if (options.limit == 1)
+    std::cout << "mode: exists\n";
+  else if (options.limit)
+    std::cout << "mode: first:" << options.limit << "\n";
+}
+
+/*
+  Report the number of hits written for `--positions`, if there were any.
+*/
+void report_hits(HitWriter const *hits, std::size_t count) {
+  if (hits)
+    std::cout << "hits: " << count << "\n";
+}
+
+/*
+  Report whether the pattern cache (if any) was loaded or had to be built.
+*/
+void report_cache(PatternCache const *cache) {
+  if (cache)
+    std::cout << "pattern_cache: " << (cache->rebuilt() ? "rebuilt" : "loaded")
+              << "\n";
+}
+
+/*
+  Report the size of a multi-pattern matcher's prepared tables, which is what
+  the set of patterns costs in memory, if the matcher can tell.
+*/
+void report_tables(MultiMatcher &matcher) {
+  if (std::size_t bytes = matcher.table_bytes())
+    std::cout << "table_bytes: " << bytes << "\n";
+}
+
+/*
+  Report a single mismatch between a count and the answers table.
+*/
+void report_mismatch(int pattern, int sequence, int found, int expected) {
+  std::cerr << "Pattern " << pattern + 1 << " mismatch against sequence "
+            << sequence + 1 << " (" << found << " != " << expected << ")\n";
+}
+
+/*
+  Report the mismatches gathered by the threads of a threaded run, in the
+  order that the single-threaded run would have reported them. Returns the
+  number of mismatches.
+*/
+int report_mismatches(std::vector<std::vector<Mismatch>> &per_thread) {
+  std::vector<Mismatch> all;
+  for (auto &thread_list : per_thread)
+    all.insert(all.end(), thread_list.begin(), thread_list.end());
+
+  std::sort(all.begin(), all.end(), [](Mismatch const &a, Mismatch const &b) {
+    return a.pattern != b.pattern ? a.pattern < b.pattern
+                                  : a.sequence < b.sequence;
+  });
+  for (auto const &mismatch : all)
+    report_mismatch(mismatch.pattern, mismatch.sequence, mismatch.found,
+                    mismatch.expected);
+
+  return all.size();
+}
+
+/*
+  Write the thread count and the per-thread run-times of a threaded run, in
+  the same YAML-friendly form as the rest of the output.
+*/
+void report_threads(ThreadPool const &pool) {
+  std::vector<double> const &times = pool.thread_times();
+
+  std::cout << "threads: " << pool.size() << "\n"
+            << "thread_runtimes: [";
+  for (std::size_t i = 0; i < times.size(); i++)
+    std::cout << (i ? ", " : "") << std::setprecision(8) << times[i];
+  std::cout << "]\n";
+}
+
+/*
+  Write the number of bytes of sequence data read, and the tiling used (if
+  any).
+*/
+void report_reads(std::size_t bytes_read, RunOptions const &options) {
+  std::cout << "sequence_bytes_read: " << bytes_read << "\n";
+  if (options.tile_bytes)
+    std::cout << "tile_bytes: " << options.tile_bytes << "\n"
+              << "tile_patterns: " << options.tile_patterns << "\n";
+}
+
+/*
+  Take each of `tiles` through the patterns [first, last), which have been
+  prepared in slots 0 onwards. `match(slot, sequence, sink)` returns the count
+  and, when `checking`, `expected(pattern, sequence)` the answer to compare it
+  with. `sink` is null unless there are `hits` to gather or a `limit` to stop
+  at, in which case the matches are to be reported to it (and the answers are
+  capped at the limit). The sequence numbers are relative to the tiles, and
+  `offset` is added to them for the mismatches and the hits. The
+  tiles are shared out between the threads of `pool` if there is one, and the
+  mismatches are gathered per thread.
+*/
+template <typename Match, typename Expected>
+void run_tiles(std::vector<Tile> const &tiles, int first, int last,
+               ThreadPool *pool, Match match, Expected expected, bool checking,
+               int offset, std::vector<std::vector<Mismatch>> &mismatches,
+               HitWriter *hits, int limit) {
+  auto body = [&](int begin, int end, int thread) {
+    for (int tile = begin; tile < end; tile++)
+      for (int pattern = first; pattern < last; pattern++)
+        for (int sequence = tiles[tile].begin; sequence < tiles[tile].end;
+             sequence++) {
+          int matches;
+          if (locating(hits, limit)) {
+            HitSink sink =
+                make_sink(hits, thread, limit, pattern, offset + sequence);
+            matches = match(pattern - first, sequence, &sink);
+          } else
+            matches = match(pattern - first, sequence, nullptr);
+
+          if (checking) {
+            int wanted = expected_count(expected(pattern, sequence), limit);
+            if (matches != wanted)
+              mismatches[thread].push_back(
+                  {pattern, offset + sequence, matches, wanted});
+          }
+        }
+  };
+
+  if (pool)
+    pool->parallel_for(tiles.size(), 1, body);
+  else
+    body(0, tiles.size(), 0);
+}
+
+/*
+  The loop shared by the single-pattern runners. The patterns are taken in
+  blocks of `block_size`: `prepare(slot, pattern)` is called for each pattern
+  of a block, then every tile is taken through every pattern of the block
+  (see run_tiles()). The return value is the number of bytes of sequence data
+  read, and the time spent preparing and matching is added to `timing` (and
+  counted by `counters`, as the init and search phases).
+*/
+template <typename Prepare, typename Match>
+std::size_t run_blocks(int patterns_count, int block_size,
+                       std::vector<Tile> const &tiles, ThreadPool *pool,
+                       Prepare prepare, Match match,
+                       AnswersTable const &answers_data,
+                       std::vector<std::vector<Mismatch>> &mismatches,
+                       HitWriter *hits, int limit, Timing &timing,
+                       PhaseCounters &counters) {
+  std::size_t bytes_read = 0;
+
+  for (int first = 0; first < patterns_count; first += block_size) {
+    int last = std::min(first + block_size, patterns_count);
+    // Pre-process the block's patterns once, then share them (read-only)
+    // between the threads.
+    double prepare_start = get_time();
+    counters.start(Phase::init);
+    for (int pattern = first; pattern < last; pattern++)
+      prepare(pattern - first, pattern);
+    counters.stop(Phase::init);
+    double match_start = get_time();
+    timing.init += match_start - prepare_start;
+
+    PhaseScope search(counters, Phase::search);
+
+    run_tiles(
+        tiles, first, last, pool, match,
+        [&](int pattern, int sequence) {
+          return answers_data[pattern][sequence];
+        },
+        answers_data.size(), 0, mismatches, hits, limit);
+    timing.match += get_time() - match_start;
+
+    for (auto const &tile : tiles)
+      bytes_read += tile.bytes;
+  }
+
+  return bytes_read;
+}
+
+/*
+  Choose the tiles and the pattern block size for a single-pattern runner.
+  Without tiling, each pattern is a block of its own, and the sequences are
+  either one tile or (with threads) the usual chunks.
+*/
+std::vector<Tile> plan_tiles(SequenceStore const &sequences_data,
+                             RunOptions const &options, ThreadPool *pool,
+                             int &block_size) {
+  if (options.tile_bytes) {
+    block_size = options.tile_patterns;
+    return make_tiles(sequences_data, options.tile_bytes, 0);
+  }
+
+  block_size = 1;
+  return make_tiles(sequences_data, 0,
+                    pool ? CHUNK_SIZE : sequences_data.size());
+}
+
+/*
+  The inputs of a streamed run: the sequences and (if given) the answers are
+  read as the run goes, while the patterns are read in full.
+*/
+struct StreamInput {
+  std::unique_ptr<SequenceStream> sequences;
+  std::vector<std::string> patterns;
+  std::unique_ptr<AnswersStream> answers;
+};
+
+/*
+  What a streamed run measured: the time spent matching (and checking), the
+  time spent waiting for chunks that weren't read yet, the bytes of sequence
+  data matched and the number of chunks.
+*/
+struct StreamStats {
+  double run_time = 0;
+  double wait_time = 0;
+  std::size_t bytes = 0;
+  int chunks = 0;
+};
+
+/*
+  Open the inputs for a streamed run. `answers` may be null. When `k` is
+  given, the k of the answers file is stored there.
+*/
+StreamInput open_stream(char const *sequences, char const *patterns,
+                        char const *answers, int *k, RunOptions const &options,
+                        Encoding encoding) {
+  StreamInput input;
+
+  input.patterns = read_patterns(patterns);
+  if (answers) {
+    input.answers = std::make_unique<AnswersStream>(answers, k);
+    if (input.answers->size() != input.patterns.size())
+      throw std::runtime_error{
+          "Count mismatch between patterns file and answers file"};
+  }
+  if (encoding == Encoding::dna)
+    for (auto &pattern : input.patterns)
+      pattern = encode_dna(pattern);
+  input.sequences = std::make_unique<SequenceStream>(
+      sequences, options.stream_bytes, encoding == Encoding::dna);
+
+  return input;
+}
+
+/*
+  Run `each(chunk, rows)` over the chunks of a streamed run, where `rows` holds
+  the answers for the chunk (if there are answers). Only the time spent in
+  `each` counts as run time.
+*/
+template <typename Each>
+StreamStats stream_chunks(StreamInput &input, Each each) {
+  StreamStats stats;
+  SequenceChunk chunk;
+  std::vector<std::vector<int>> rows;
+
+  for (;;) {
+    double wait_start = get_time();
+    bool more = input.sequences->next(chunk);
+    stats.wait_time += get_time() - wait_start;
+    if (!more)
+      break;
+    if (input.answers)
+      input.answers->next(chunk.size(), rows);
+
+    double start_time = get_time();
+    each(chunk, rows);
+    stats.run_time += get_time() - start_time;
+
+    for (std::string_view sequence : chunk.sequences)
+      stats.bytes += sequence.length();
+    stats.chunks++;
+  }
+
+  return stats;
+}
+
+/*
+  Write the output of a streamed run. The run-time is the time taken to
+  prepare the patterns plus the time spent on the chunks. The chunk count and
+  the time spent waiting for chunks are added to the usual lines.
+*/
+void report_stream(std::string const &label, double prepare_time,
+                   StreamStats const &stats, RunOptions const &options,
+                   ThreadPool const *pool, PatternCache const *cache) {
+  std::cout << "language: " << LANG << "\n"
+            << "algorithm: " << label << "\n"
+            << "runtime: " << std::setprecision(8)
+            << prepare_time + stats.run_time << "\n";
+  report_reads(stats.bytes, options);
+  std::cout << "stream_bytes: " << options.stream_bytes << "\n"
+            << "stream_chunks: " << stats.chunks << "\n"
+            << "stream_wait: " << std::setprecision(8) << stats.wait_time
+            << "\n";
+  report_cache(cache);
+  if (pool)
+    report_threads(*pool);
+}
+
+/*
+  The value at `fraction` of the way through `values` (which are sorted), by
+  the nearest rank.
+*/
+double percentile(std::vector<double> const &values, double fraction) {
+  std::size_t rank = std::ceil(fraction * values.size());
+
+  return values[std::max<std::size_t>(rank, 1) - 1];
+}
+
+/*
+  The median of `values` (which are sorted).
+*/
+double median(std::vector<double> const &values) {
+  std::size_t middle = values.size() / 2;
+
+  return values.size() % 2 ? values[middle]
+                           : (values[middle - 1] + values[middle]) / 2;
+}
+
+/*
+  Write one of the figures of a benchmark summary: the min, median and 99th
+  percentile of the given values.
+*/
+void report_spread(char const *key, std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+
+  std::cout << key << ": {min: " << std::setprecision(8) << values.front()
+            << ", median: " << median(values)
+            << ", p99: " << percentile(values, 0.99) << "}\n";
+}
+
+/*
+  The rate at which `bytes` of sequence data were matched in `seconds`, in
+  MB/s.
+*/
+double throughput(std::size_t bytes, double seconds) {
+  return seconds > 0 ? bytes / seconds / 1e6 : 0;
+}
+
+/*
+  The `--bench` loop. `once(timing)` runs the timed part of the run, which the
+  loop calls `options.warmup` times untimed and then `options.bench` times.
+  Each iteration is written as a YAML document with the keys that the
+  harness's records have, so that `util/process_results.py` can read the
+  output as it reads the harness's. As the run is in-process, `runtime` and
+  `total_runtime` are the same, and `max_memory` is the peak resident size so
+  far, in KB. A last document, without an `iteration` key, sums up the
+  iterations: the spread of each phase, and the throughput at the median
+  match time, and the `counters` of the timed iterations, if there are any.
+  The return value is the most mismatches of any iteration.
+*/
+template <typename Once>
+int run_bench(RunOptions const &options, std::string const &label,
+              PhaseCounters &counters, Once once) {
+  for (int i = 0; i < options.warmup; i++) {
+    Timing timing;
+    once(timing);
+  }
+  counters.clear();
+
+  std::vector<double> runtimes, inits, matches;
+  std::size_t bytes = 0;
+  int worst = 0;
+  for (int i = 1; i <= options.bench; i++) {
+    Timing timing;
+    once(timing);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    std::cout << "---\n"
+              << "iteration: " << i << "\n"
+              << "success: " << (timing.mismatches ? "false" : "true") << "\n"
+              << "language: " << LANG << "\n"
+              << "algorithm: " << label << "\n"
+              << std::setprecision(8) << "runtime: " << timing.runtime << "\n"
+              << "total_runtime: " << timing.runtime << "\n"
+              << "init_time: " << timing.init << "\n"
+              << "match_time: " << timing.match << "\n"
+              << "throughput: " << throughput(timing.bytes, timing.match)
+              << "\n"
+              << "max_memory: " << usage.ru_maxrss << "\n";
+
+    runtimes.push_back(timing.runtime);
+    inits.push_back(timing.init);
+    matches.push_back(timing.match);
+    bytes = timing.bytes;
+    worst = std::max(worst, timing.mismatches);
+  }
+
+  std::vector<double> sorted = matches;
+  std::sort(sorted.begin(), sorted.end());
+  std::cout << "---\n"
+            << "language: " << LANG << "\n"
+            << "algorithm: " << label << "\n"
+            << "warmup: " << options.warmup << "\n"
+            << "iterations: " << options.bench << "\n"
+            << "success: " << (worst ? "false" : "true") << "\n"
+            << "sequence_bytes_read: " << bytes << "\n";
+  report_spread("runtime", runtimes);
+  report_spread("init_time", inits);
+  report_spread("match_time", matches);
+  std::cout << "throughput: " << std::setprecision(8)
+            << throughput(bytes, median(sorted)) << "\n";
+  if (options.threads > 1)
+    std::cout << "threads: " << options.threads << "\n";
+  counters.report(std::cout);
+
+  return worst;
+}
+
+/*
+  The streamed form of the single-pattern runners. `prepare(slot, pattern)` is
+  called for every pattern before the first chunk, then each chunk is cut into
+  tiles and they are taken through all of the patterns. `locates` says
+  whether the matcher can report positions. Output is written as the other
+  runners write it, under the algorithm label `label`.
+*/
+template <typename Prepare, typename Match>
+int run_streamed(StreamInput &input, RunOptions const &options,
+                 PatternCache const *cache, std::string const &label,
+                 bool locates, Prepare prepare, Match match) {
+  int patterns_count = input.patterns.size();
+
+  std::unique_ptr<ThreadPool> pool;
+  if (options.threads > 1)
+    pool = std::make_unique<ThreadPool>(options.threads);
+  std::vector<std::vector<Mismatch>> mismatches(pool ? pool->size() : 1);
+  std::unique_ptr<HitWriter> hits =
+      open_hits(options, locates, label, pool ? pool->size() : 1);
+
+  double start_time = get_time();
+  for (int pattern = 0; pattern < patterns_count; pattern++)
+    prepare(pattern, pattern);
+  double prepare_time = get_time() - start_time;
+
+  StreamStats stats = stream_chunks(
+      input, [&](SequenceChunk const &chunk,
+                 std::vector<std::vector<int>> const &rows) {
+        std::vector<Tile> tiles =
+            make_tiles(chunk, options.tile_bytes,
+                       pool ? CHUNK_SIZE : (int)chunk.size());
+
+        run_tiles(
+            tiles, 0, patterns_count, pool.get(),
+            [&](int slot, int sequence, HitSink const *sink) {
+              return match(slot, chunk[sequence], sink);
+            },
+            [&](int pattern, int sequence) { return rows[pattern][sequence]; },
+            input.answers != nullptr, chunk.first, mismatches, hits.get(),
+            options.limit);
+      });
+  std::size_t hits_count = hits ? hits->finish() : 0;
+
+  int return_code = report_mismatches(mismatches);
+  report_stream(label, prepare_time, stats, options, pool.get(), cache);
+  report_mode(options);
+  report_hits(hits.get(), hits_count);
+
+  return return_code;
+}
+
+/*
+  Read the patterns for a server, in the form named by `encoding`.
+*/
+std::vector<std::string> read_served_patterns(char const *patterns,
+                                              Encoding encoding) {
+  std::vector<std::string> patterns_data = read_patterns(patterns);
+  if (encoding == Encoding::dna)
+    for (auto &pattern : patterns_data)
+      pattern = encode_dna(pattern);
+
+  return patterns_data;
+}
+
+/*
+  The server of `--serve` (see `serve.hpp`), for all of the runners. The
+  patterns are prepared by `prepare()` once, before the first request is
+  read. Each batch of requests is then matched as a whole, with
+  `count(sequence, counts, thread)` filling in the counts of all of the
+  patterns against one sequence. Once the server stops, the summary is
+  written as the runners' output is, except that it goes to the standard
+  error when the answers went to the standard output.
+*/
+template <typename Prepare, typename Count, typename Report>
+int run_served(RunOptions const &options, std::string const &label,
+               int patterns_count, Encoding encoding, PatternCache const *cache,
+               Prepare prepare, Count count, Report report) {
+  std::unique_ptr<ThreadPool> pool;
+  if (options.threads > 1)
+    pool = std::make_unique<ThreadPool>(options.threads);
+
+  double start_time = get_time();
+  prepare();
+  double prepare_time = get_time() - start_time;
+
+  RequestServer server(options.serve, encoding == Encoding::dna);
+  std::vector<ServeRequest> batch;
+  std::vector<std::string_view> sequences;
+  std::vector<int> counts;
+  std::vector<double> latencies;
+  std::size_t bytes = 0;
+  int batches = 0;
+  double match_time = 0;
+  while (server.next(batch)) {
+    sequences.clear();
+    for (ServeRequest const &request : batch)
+      sequences.insert(sequences.end(), request.sequences.begin(),
+                       request.sequences.end());
+    counts.resize(sequences.size() * patterns_count);
+
+    // Each sequence is matched against every pattern, which is work enough to
+    // hand the sequences out one at a time. That way even a small batch is
+    // spread over all of the threads.
+    start_time = get_time();
+    auto body = [&](int begin, int end, int thread) {
+      for (int s = begin; s < end; s++)
+        count(sequences[s], counts.data() + (std::size_t)s * patterns_count,
+              thread);
+    };
+    if (pool)
+      pool->parallel_for(sequences.size(), 1, body);
+    else
+      body(0, sequences.size(), 0);
+    match_time += get_time() - start_time;
+
+    int const *at = counts.data();
+    for (ServeRequest const &request : batch) {
+      server.answer(request, at, patterns_count);
+      at += request.sequences.size() * patterns_count;
+      auto waited = std::chrono::steady_clock::now() - request.arrived;
+      latencies.push_back(std::chrono::duration<double>(waited).count());
+      for (std::string_view sequence : request.sequences)
+        bytes += sequence.length();
+    }
+    batches++;
+  }
+
+  std::streambuf *output = std::cout.rdbuf();
+  if (options.serve == "-")
+    std::cout.rdbuf(std::cerr.rdbuf());
+  std::cout << "language: " << LANG << "\n"
+            << "algorithm: " << label << "\n"
+            << "init_time: " << std::setprecision(8) << prepare_time << "\n"
+            << "match_time: " << match_time << "\n"
+            << "sequence_bytes_read: " << bytes << "\n"
+            << "serve_requests: " << latencies.size() << "\n"
+            << "serve_batches: " << batches << "\n";
+  if (!latencies.empty())
+    report_spread("serve_latency", latencies);
+  report_cache(cache);
+  report();
+  if (pool)
+    report_threads(*pool);
+  std::cout.flush();
+  std::cout.rdbuf(output);
+
+  return 0;
+}
+
+/*
+  The basic "runner" function. This takes the matcher for the algorithm (see
+  `run()` in `run.hpp`, which builds it from the algorithm's functions), the
+  name of the algorithm, argc and argv from the invocation, and runs the
+  experiment over the given algorithm. The sequences and patterns are given to
+  the algorithm in the form named by `encoding`.
 
   The return value is 0 if the experiment correctly identified all pattern
   instances in all sequences, and the number of misses otherwise. An exception
   is thrown on any non-recoverable errors.
 */
-int run(initializer init, algorithm code, std::string name, int argc,
-        char *argv[]) {
-  if (argc < 3 || argc > 4) {
-    std::ostringstream error;
-    error << "Usage: " << argv[0] << " <sequences> <patterns> [ <answers> ]";
-    throw std::runtime_error{error.str()};
+int run_matcher(SingleMatcher &matcher, std::string name, int argc,
+                char *argv[], Encoding encoding) {
+  std::string message =
+      usage(argv[0], SINGLE_OPTIONS,
+            "<sequences> <patterns> [ <answers> ]");
+  RunOptions options = parse_options(argc, argv, message);
+
+  if (!options.serve.empty()) {
+    if (argc != 2)
+      throw std::runtime_error{message};
+    std::vector<std::string> patterns_data =
+        read_served_patterns(argv[1], encoding);
+    int patterns_count = patterns_data.size();
+    matcher.resize(patterns_count);
+    std::unique_ptr<PatternCache> cache = open_cache(
+        options, matcher.cacheable(), matcher.layout(), name, encoding, -1,
+        patterns_data, patterns_count,
+        [&](PatternWriter &writer, std::size_t pattern) {
+          matcher.save(patterns_data[pattern], writer);
+        });
+
+    // Each pattern keeps a slot of its own, for as long as the server runs.
+    return run_served(
+        options, name, patterns_count, encoding, cache.get(),
+        [&] {
+          for (int pattern = 0; pattern < patterns_count; pattern++)
+            if (cache) {
+              PatternReader reader = cache->reader(pattern);
+              matcher.load(pattern, patterns_data[pattern], reader);
+            } else
+              matcher.prepare(pattern, patterns_data[pattern]);
+        },
+        [&](std::string_view sequence, int *counts, int) {
+          for (int pattern = 0; pattern < patterns_count; pattern++)
+            counts[pattern] = matcher.match(pattern, sequence);
+        },
+        [] {});
+  }
+
+  if (argc < 3 || argc > 4)
+    throw std::runtime_error{message};
+
+  if (options.stream_bytes) {
+    StreamInput input = open_stream(argv[1], argv[2],
+                                    argc == 4 ? argv[3] : nullptr, nullptr,
+                                    options, encoding);
+    matcher.resize(input.patterns.size());
+    std::unique_ptr<PatternCache> cache = open_cache(
+        options, matcher.cacheable(), matcher.layout(), name, encoding, -1,
+        input.patterns, input.patterns.size(),
+        [&](PatternWriter &writer, std::size_t pattern) {
+          matcher.save(input.patterns[pattern], writer);
+        });
+
+    return run_streamed(
+        input, options, cache.get(), name, matcher.locates(),
+        [&](int slot, int pattern) {
+          if (cache) {
+            PatternReader reader = cache->reader(pattern);
+            matcher.load(slot, input.patterns[pattern], reader);
+          } else
+            matcher.prepare(slot, input.patterns[pattern]);
+        },
+        [&](int slot, std::string_view sequence, HitSink const *sink) {
+          return sink ? matcher.locate(slot, sequence, *sink)
+                      : matcher.match(slot, sequence);
+        });
   }
 
   // Read the three data files. Any of these that encounter an error will
   // throw an exception. The filenames are in the order: sequences patterns
-  // answers.
-  std::vector<std::string> sequences_data = read_sequences(argv[1]);
-  int sequences_count = sequences_data.size();
+  // answers. The counters (if any) start first, so that they count the
+  // threads.
+  PhaseCounters counters(options.counters);
+  counters.start(Phase::load);
+  SequenceStore sequences_data = read_sequences(argv[1]);
   std::vector<std::string> patterns_data = read_patterns(argv[2]);
   int patterns_count = patterns_data.size();
-  std::vector<std::vector<int>> answers_data;
+  AnswersTable answers_data;
   if (argc == 4) {
     answers_data = read_answers(argv[3], nullptr);
     int answers_count = answers_data.size();
     if (answers_count != patterns_count)
       throw std::runtime_error{
           "Count mismatch between patterns file and answers file"};
+    if (answers_data.columns() != sequences_data.size())
+      throw std::runtime_error{
+          "Count mismatch between sequences file and answers file"};
   }
 
-  // Run it. For each sequence, try each pattern against it. The code function
-  // pointer will return the number of matches found, which will be compared to
-  // the table of answers for that pattern. Report any mismatches.
-  double start_time = get_time();
-  int return_code = 0; // Used for noting if some number of matches fail
-  for (int pattern = 0; pattern < patterns_count; pattern++) {
-    std::string pattern_str = patterns_data[pattern];
-    // Pre-process the pattern before applying it to all sequences.
-    std::vector<PatternData> pat_data = (*init)(pattern_str);
-
-    for (int sequence = 0; sequence < sequences_count; sequence++) {
-      std::string sequence_str = sequences_data[sequence];
-
-      int matches = (*code)(pat_data, sequence_str);
-
-      if (answers_data.size() && matches != answers_data[pattern][sequence]) {
-        std::cerr << "Pattern " << pattern + 1 << " mismatch against sequence "
-                  << sequence + 1 << " (" << matches
-                  << " != " << answers_data[pattern][sequence] << ")\n";
-        return_code++;
-      }
-    }
-  }
-  // Note the end time.
-  double end_time = get_time();
+  if (encoding == Encoding::dna)
+    encode_data(sequences_data, patterns_data);
+
+  // Open (or build) the pattern cache, if there is one, before the timer
+  // starts.
+  std::unique_ptr<PatternCache> cache = open_cache(
+      options, matcher.cacheable(), matcher.layout(), name, encoding, -1,
+      patterns_data, patterns_count,
+      [&](PatternWriter &writer, std::size_t pattern) {
+        matcher.save(patterns_data[pattern], writer);
+      });
+  counters.stop(Phase::load);
+
+  // Start the threads (if any) before the timer does.
+  std::unique_ptr<ThreadPool> pool;
+  if (options.threads > 1)
+    pool = std::make_unique<ThreadPool>(options.threads);
+  std::unique_ptr<HitWriter> hits =
+      open_hits(options, matcher.locates(), name, pool ? pool->size() : 1);
+
+  // Run it. For each sequence, try each pattern against it. The matcher will
+  // return the number of matches found, which will be compared to the table of
+  // answers for that pattern. Report any mismatches. For `--bench`, this is
+  // done once for each iteration.
+  std::size_t hits_count = 0;
+  auto run_once = [&](Timing &timing) {
+    double start_time = get_time();
+    int block_size;
+    std::vector<Tile> tiles =
+        plan_tiles(sequences_data, options, pool.get(), block_size);
+    std::vector<std::vector<Mismatch>> mismatches(pool ? pool->size() : 1);
+    matcher.resize(block_size);
+
+    timing.bytes = run_blocks(
+        patterns_count, block_size, tiles, pool.get(),
+        [&](int slot, int pattern) {
+          if (cache) {
+            PatternReader reader = cache->reader(pattern);
+            matcher.load(slot, patterns_data[pattern], reader);
+          } else
+            matcher.prepare(slot, patterns_data[pattern]);
+        },
+        [&](int slot, int sequence, HitSink const *sink) {
+          std::string_view sequence_str = sequences_data[sequence];
+          return sink ? matcher.locate(slot, sequence_str, *sink)
+                      : matcher.match(slot, sequence_str);
+        },
+        answers_data, mismatches, hits.get(), options.limit, timing, counters);
+    if (hits)
+      hits_count = hits->finish();
+
+    counters.start(Phase::verify);
+    timing.mismatches = report_mismatches(mismatches);
+    counters.stop(Phase::verify);
+    // Note the end time.
+    timing.runtime = get_time() - start_time;
+  };
+  if (options.bench)
+    return run_bench(options, name, counters, run_once);
+
+  Timing timing;
+  run_once(timing);
 
   std::cout << "language: " << LANG << "\n"
             << "algorithm: " << name << "\n"
-            << "runtime: " << std::setprecision(8) << end_time - start_time
-            << "\n";
+            << "runtime: " << std::setprecision(8) << timing.runtime << "\n";
+  report_reads(timing.bytes, options);
+  report_cache(cache.get());
+  report_mode(options);
+  report_hits(hits.get(), hits_count);
+  if (pool)
+    report_threads(*pool);
+  counters.report(std::cout);
 
-  return return_code;
+  return timing.mismatches;
 }
 
 /*
-  This is a variation of "run" that handles algorithms that do multi-pattern
-  matching.
+  The lengths of the patterns, for the HitSinks of a multi-pattern run.
 */
-int run_multi(mp_initializer init, mp_algorithm code, std::string name,
-              int argc, char *argv[]) {
-  if (argc < 3 || argc > 4) {
-    std::ostringstream error;
-    error << "Usage: " << argv[0] << " <sequences> <patterns> [ <answers> ]";
-    throw std::runtime_error{error.str()};
+std::vector<int> pattern_lengths(std::vector<std::string> const &patterns) {
+  std::vector<int> lengths;
+  for (auto const &pattern : patterns)
+    lengths.push_back(pattern.length());
+
+  return lengths;
+}
+
+/*
+  The multi-pattern runs, for both of the multi-pattern runners below. The
+  files are named by `sequences`, `patterns` and `answers` (which may be
+  null). `k` is -1 for exact matching, and otherwise must agree with the k of
+  the answers file. `name` is the algorithm, and `label` is how it is written
+  in the output.
+*/
+int run_multi_files(MultiMatcher &matcher, std::string const &name,
+                    std::string const &label, RunOptions const &options,
+                    char const *sequences, char const *patterns,
+                    char const *answers, int k, Encoding encoding) {
+  int k_read;
+
+  if (!options.serve.empty()) {
+    std::vector<std::string> patterns_data =
+        read_served_patterns(patterns, encoding);
+    int patterns_count = patterns_data.size();
+    std::unique_ptr<PatternCache> cache = open_cache(
+        options, matcher.cacheable(), matcher.layout(), name, encoding, k,
+        patterns_data, 1, [&](PatternWriter &writer, std::size_t) {
+          matcher.save(patterns_data, writer);
+        });
+    std::vector<std::vector<int>> matches(std::max(options.threads, 1));
+
+    return run_served(
+        options, label, patterns_count, encoding, cache.get(),
+        [&] {
+          if (cache) {
+            PatternReader reader = cache->reader(0);
+            matcher.load(reader);
+          } else
+            matcher.prepare(patterns_data);
+        },
+        [&](std::string_view sequence, int *counts, int thread) {
+          std::vector<int> &found = matches[thread];
+          matcher.match(sequence, found);
+          std::copy(found.begin(), found.end(), counts);
+        },
+        [&] { report_tables(matcher); });
+  }
+
+  if (options.stream_bytes) {
+    StreamInput input =
+        open_stream(sequences, patterns, answers, k < 0 ? nullptr : &k_read,
+                    options, encoding);
+    if (answers && k >= 0 && k != k_read)
+      throw std::runtime_error{"Mismatch in k value in answers file"};
+    int patterns_count = input.patterns.size();
+
+    std::unique_ptr<ThreadPool> pool;
+    if (options.threads > 1)
+      pool = std::make_unique<ThreadPool>(options.threads);
+    int threads = pool ? pool->size() : 1;
+    std::vector<std::vector<Mismatch>> mismatches(threads);
+    std::vector<std::vector<int>> matches(threads,
+                                          std::vector<int>(patterns_count, 0));
+    std::unique_ptr<PatternCache> cache = open_cache(
+        options, matcher.cacheable(), matcher.layout(), name, encoding, k,
+        input.patterns, 1, [&](PatternWriter &writer, std::size_t) {
+          matcher.save(input.patterns, writer);
+        });
+    std::unique_ptr<HitWriter> hits =
+        open_hits(options, matcher.locates(), name, threads);
+    std::vector<int> lengths = pattern_lengths(input.patterns);
+
+    double start_time = get_time();
+    if (cache) {
+      PatternReader reader = cache->reader(0);
+      matcher.load(reader);
+    } else
+      matcher.prepare(input.patterns);
+    double prepare_time = get_time() - start_time;
+
+    StreamStats stats = stream_chunks(
+        input, [&](SequenceChunk const &chunk,
+                   std::vector<std::vector<int>> const &rows) {
+          auto body = [&](int begin, int end, int thread) {
+            std::vector<int> &counts = matches[thread];
+
+            for (int sequence = begin; sequence < end; sequence++) {
+              if (locating(hits.get(), options.limit))
+                matcher.locate(chunk[sequence], counts,
+                               make_sink(hits.get(), thread, options.limit,
+                                         chunk.first + sequence, lengths));
+              else
+                matcher.match(chunk[sequence], counts);
+
+              if (input.answers) {
+                for (int pattern = 0; pattern < patterns_count; pattern++) {
+                  int wanted =
+                      expected_count(rows[pattern][sequence], options.limit);
+                  if (counts[pattern] != wanted)
+                    mismatches[thread].push_back(
+                        {pattern, (int)chunk.first + sequence, counts[pattern],
+                         wanted});
+                }
+              }
+            }
+          };
+
+          if (pool)
+            pool->parallel_for(chunk.size(), CHUNK_SIZE, body);
+          else
+            body(0, chunk.size(), 0);
+        });
+
+    std::size_t hits_count = hits ? hits->finish() : 0;
+
+    int return_code = report_mismatches(mismatches);
+    report_stream(label, prepare_time, stats, options, pool.get(), cache.get());
+    report_tables(matcher);
+    report_mode(options);
+    report_hits(hits.get(), hits_count);
+
+    return return_code;
   }
 
   // Read the three data files. Any of these that encounter an error will
   // throw an exception. The filenames are in the order: sequences patterns
-  // answers.
-  std::vector<std::string> sequences_data = read_sequences(argv[1]);
+  // answers. The counters (if any) start first, so that they count the
+  // threads.
+  PhaseCounters counters(options.counters);
+  counters.start(Phase::load);
+  SequenceStore sequences_data = read_sequences(sequences);
   int sequences_count = sequences_data.size();
-  std::vector<std::string> patterns_data = read_patterns(argv[2]);
+  std::vector<std::string> patterns_data = read_patterns(patterns);
   int patterns_count = patterns_data.size();
-  std::vector<std::vector<int>> answers_data;
-  if (argc == 4) {
-    answers_data = read_answers(argv[3], nullptr);
+  AnswersTable answers_data;
+  if (answers) {
+    answers_data = read_answers(answers, k < 0 ? nullptr : &k_read);
     int answers_count = answers_data.size();
     if (answers_count != patterns_count)
       throw std::runtime_error{
           "Count mismatch between patterns file and answers file"};
+    if (answers_data.columns() != sequences_data.size())
+      throw std::runtime_error{
+          "Count mismatch between sequences file and answers file"};
+    if (k >= 0 && k != k_read)
+      throw std::runtime_error{"Mismatch in k value in answers file"};
   }
 
+  if (encoding == Encoding::dna)
+    encode_data(sequences_data, patterns_data);
+
+  // Open (or build) the pattern cache, if there is one, before the timer
+  // starts. The whole set of patterns is a single entry.
+  std::unique_ptr<PatternCache> cache = open_cache(
+      options, matcher.cacheable(), matcher.layout(), name, encoding, k,
+      patterns_data, 1, [&](PatternWriter &writer, std::size_t) {
+        matcher.save(patterns_data, writer);
+      });
+  counters.stop(Phase::load);
+
+  // Start the threads (if any) before the timer does.
+  std::unique_ptr<ThreadPool> pool;
+  if (options.threads > 1)
+    pool = std::make_unique<ThreadPool>(options.threads);
+  std::unique_ptr<HitWriter> hits =
+      open_hits(options, matcher.locates(), name, pool ? pool->size() : 1);
+  std::vector<int> lengths = pattern_lengths(patterns_data);
+  // The per-pattern counts are written here by the algorithm, into a buffer
+  // for each thread. These are made once, so that nothing is allocated per
+  // sequence, nor per iteration of `--bench`.
+  int threads = pool ? pool->size() : 1;
+  std::vector<std::vector<int>> matches(threads,
+                                        std::vector<int>(patterns_count, 0));
+  std::vector<std::vector<Mismatch>> mismatches(threads);
+
   // Run it. For each sequence, try each pattern against it. The code function
   // pointer will return the number of matches found, which will be compared to
-  // the table of answers for that pattern. Report any mismatches.
-  double start_time = get_time();
-  int return_code = 0; // Used for noting if some number of matches fail
+  // the table of answers for that pattern. Report any mismatches. For
+  // `--bench`, this is done once for each iteration.
+  std::size_t hits_count = 0;
+  auto run_once = [&](Timing &timing) {
+    double start_time = get_time();
 
-  // Pre-process the patterns before applying to all sequences.
-  std::vector<MultiPatternData> pat_data = (*init)(patterns_data);
+    // Pre-process the patterns before applying to all sequences.
+    counters.start(Phase::init);
+    if (cache) {
+      PatternReader reader = cache->reader(0);
+      matcher.load(reader);
+    } else
+      matcher.prepare(patterns_data);
+    counters.stop(Phase::init);
+    double match_start = get_time();
+    timing.init = match_start - start_time;
+    // All of the patterns are matched in a single pass over the data.
+    for (std::string_view sequence : sequences_data)
+      timing.bytes += sequence.length();
 
-  for (int sequence = 0; sequence < sequences_count; sequence++) {
-    std::string sequence_str = sequences_data[sequence];
+    counters.start(Phase::search);
+    if (!pool) {
+      std::vector<int> &counts = matches[0];
 
-    std::vector<int> matches = (*code)(pat_data, sequence_str);
+      for (int sequence = 0; sequence < sequences_count; sequence++) {
+        std::string_view sequence_str = sequences_data[sequence];
 
-    if (answers_data.size()) {
-      for (int pattern = 0; pattern < patterns_count; pattern++) {
-        if (matches[pattern] != answers_data[pattern][sequence]) {
-          std::cerr << "Pattern " << pattern + 1
-                    << " mismatch against sequence " << sequence + 1 << " ("
-                    << matches[pattern]
-                    << " != " << answers_data[pattern][sequence] << ")\n";
-          return_code++;
+        if (locating(hits.get(), options.limit))
+          matcher.locate(sequence_str, counts,
+                         make_sink(hits.get(), 0, options.limit, sequence,
+                                   lengths));
+        else
+          matcher.match(sequence_str, counts);
+
+        if (answers_data.size()) {
+          for (int pattern = 0; pattern < patterns_count; pattern++) {
+            int wanted =
+                expected_count(answers_data[pattern][sequence], options.limit);
+            if (counts[pattern] != wanted) {
+              report_mismatch(pattern, sequence, counts[pattern], wanted);
+              timing.mismatches++;
+            }
+          }
         }
       }
+      counters.stop(Phase::search);
+    } else {
+      for (auto &thread_list : mismatches)
+        thread_list.clear();
+
+      pool->parallel_for(
+          sequences_count, CHUNK_SIZE, [&](int begin, int end, int thread) {
+            std::vector<int> &counts = matches[thread];
+
+            for (int sequence = begin; sequence < end; sequence++) {
+              if (locating(hits.get(), options.limit))
+                matcher.locate(sequences_data[sequence], counts,
+                               make_sink(hits.get(), thread, options.limit,
+                                         sequence, lengths));
+              else
+                matcher.match(sequences_data[sequence], counts);
+
+              if (answers_data.size()) {
+                for (int pattern = 0; pattern < patterns_count; pattern++) {
+                  int wanted = expected_count(answers_data[pattern][sequence],
+                                              options.limit);
+                  if (counts[pattern] != wanted)
+                    mismatches[thread].push_back(
+                        {pattern, sequence, counts[pattern], wanted});
+                }
+              }
+            }
+          });
+      counters.stop(Phase::search);
+
+      counters.start(Phase::verify);
+      timing.mismatches = report_mismatches(mismatches);
+      counters.stop(Phase::verify);
     }
-  }
-  // Note the end time.
-  double end_time = get_time();
+    if (hits)
+      hits_count = hits->finish();
+    // Note the end time.
+    double end_time = get_time();
+    timing.match = end_time - match_start;
+    timing.runtime = end_time - start_time;
+  };
+  if (options.bench)
+    return run_bench(options, label, counters, run_once);
+
+  Timing timing;
+  run_once(timing);
 
   std::cout << "language: " << LANG << "\n"
-            << "algorithm: " << name << "\n"
-            << "runtime: " << std::setprecision(8) << end_time - start_time
-            << "\n";
+            << "algorithm: " << label << "\n"
+            << "runtime: " << std::setprecision(8) << timing.runtime << "\n";
+  report_reads(timing.bytes, options);
+  report_cache(cache.get());
+  report_tables(matcher);
+  report_mode(options);
+  report_hits(hits.get(), hits_count);
+  if (pool)
+    report_threads(*pool);
+  counters.report(std::cout);
 
-  return return_code;
+  return timing.mismatches;
 }
 
 /*
-  This is a variation of `run` that handles algorithms that do approximate
-  matching. It has the same signature as `run`, above. Here, we have to contend
-  with an additional command-line parameter that specifies the value of k for
-  the approximate-matching process.
+  This is a variation of "run_matcher" that handles algorithms that do
+  multi-pattern matching.
 */
-int run_approx(am_initializer init, am_algorithm code, std::string name,
-               int argc, char *argv[]) {
-  if (argc < 4 || argc > 5) {
-    std::ostringstream error;
-    error << "Usage: " << argv[0]
-          << " <k> <sequences> <patterns> [ <answers> ]";
-    throw std::runtime_error{error.str()};
+int run_multi_matcher(MultiMatcher &matcher, std::string name, int argc,
+                      char *argv[], Encoding encoding) {
+  std::string message =
+      usage(argv[0], "[ --stream BYTES ] ",
+            "<sequences> <patterns> [ <answers> ]");
+  RunOptions options = parse_options(argc, argv, message);
+  if (!options.serve.empty()) {
+    if (argc != 2)
+      throw std::runtime_error{message};
+    return run_multi_files(matcher, name, name, options, nullptr, argv[1],
+                           nullptr, -1, encoding);
+  }
+  if (argc < 3 || argc > 4)
+    throw std::runtime_error{message};
+  if (options.tile_bytes)
+    throw std::runtime_error{"--tile only applies to single-pattern runners"};
+
+  return run_multi_files(matcher, name, name, options, argv[1], argv[2],
+                         argc == 4 ? argv[3] : nullptr, -1, encoding);
+}
+
+/*
+  This is a variation of `run_matcher` that handles algorithms that do
+  approximate matching. It has the same signature as `run_matcher`, above.
+  Here, we have to contend with an additional command-line parameter that
+  specifies the value of k for the approximate-matching process.
+*/
+int run_approx_matcher(ApproxMatcher &matcher, std::string name, int argc,
+                       char *argv[], Encoding encoding) {
+  std::string message =
+      usage(argv[0], SINGLE_OPTIONS,
+            "<k> <sequences> <patterns> [ <answers> ]");
+  RunOptions options = parse_options(argc, argv, message);
+
+  if (!options.serve.empty()) {
+    if (argc != 3)
+      throw std::runtime_error{message};
+    int k = std::stoi(argv[1]);
+    std::vector<std::string> patterns_data =
+        read_served_patterns(argv[2], encoding);
+    int patterns_count = patterns_data.size();
+    matcher.resize(patterns_count);
+    std::unique_ptr<PatternCache> cache = open_cache(
+        options, matcher.cacheable(), matcher.layout(), name, encoding, k,
+        patterns_data, patterns_count,
+        [&](PatternWriter &writer, std::size_t pattern) {
+          matcher.save(patterns_data[pattern], k, writer);
+        });
+
+    std::ostringstream label;
+    label << name << "(" << k << ")";
+    return run_served(
+        options, label.str(), patterns_count, encoding, cache.get(),
+        [&] {
+          for (int pattern = 0; pattern < patterns_count; pattern++)
+            if (cache) {
+              PatternReader reader = cache->reader(pattern);
+              matcher.load(pattern, patterns_data[pattern], k, reader);
+            } else
+              matcher.prepare(pattern, patterns_data[pattern], k);
+        },
+        [&](std::string_view sequence, int *counts, int) {
+          for (int pattern = 0; pattern < patterns_count; pattern++)
+            counts[pattern] = matcher.match(pattern, sequence);
+        },
+        [] {});
+  }
+
+  if (argc < 4 || argc > 5)
+    throw std::runtime_error{message};
+
+  if (options.stream_bytes) {
+    int k = std::stoi(argv[1]), k_read;
+    char answers_file[256];
+    if (argc == 5)
+      sprintf(answers_file, argv[4], k);
+    StreamInput input = open_stream(argv[2], argv[3],
+                                    argc == 5 ? answers_file : nullptr,
+                                    &k_read, options, encoding);
+    if (argc == 5 && k != k_read)
+      throw std::runtime_error{"Mismatch in k value in answers file"};
+    matcher.resize(input.patterns.size());
+    std::unique_ptr<PatternCache> cache = open_cache(
+        options, matcher.cacheable(), matcher.layout(), name, encoding, k,
+        input.patterns, input.patterns.size(),
+        [&](PatternWriter &writer, std::size_t pattern) {
+          matcher.save(input.patterns[pattern], k, writer);
+        });
+
+    std::ostringstream label;
+    label << name << "(" << k << ")";
+    return run_streamed(
+        input, options, cache.get(), label.str(), matcher.locates(),
+        [&](int slot, int pattern) {
+          if (cache) {
+            PatternReader reader = cache->reader(pattern);
+            matcher.load(slot, input.patterns[pattern], k, reader);
+          } else
+            matcher.prepare(slot, input.patterns[pattern], k);
+        },
+        [&](int slot, std::string_view sequence, HitSink const *sink) {
+          return sink ? matcher.locate(slot, sequence, *sink)
+                      : matcher.match(slot, sequence);
+        });
   }
 
   // Read the initial integer and three data files. Any of these that encounter
   // an error will throw an exception. The filenames are in the order: sequences
-  // patterns answers.
+  // patterns answers. The counters (if any) start first, so that they count the
+  // threads.
+  PhaseCounters counters(options.counters);
+  counters.start(Phase::load);
   int k = std::stoi(argv[1]);
-  std::vector<std::string> sequences_data = read_sequences(argv[2]);
-  int sequences_count = sequences_data.size();
+  SequenceStore sequences_data = read_sequences(argv[2]);
   std::vector<std::string> patterns_data = read_patterns(argv[3]);
   int patterns_count = patterns_data.size();
-  std::vector<std::vector<int>> answers_data;
+  AnswersTable answers_data;
   if (argc == 5) {
     int k_read;
     char answers_file[256];
@@ -204,41 +1637,272 @@ int run_approx(am_initializer init, am_algorithm code, std::string name,
     if (answers_count != patterns_count)
       throw std::runtime_error{
           "Count mismatch between patterns file and answers file"};
+    if (answers_data.columns() != sequences_data.size())
+      throw std::runtime_error{
+          "Count mismatch between sequences file and answers file"};
     if (k != k_read)
       throw std::runtime_error{"Mismatch in k value in answers file"};
   }
 
-  // Run it. For each sequence, try each pattern against it. The code
-  // function pointer will return the number of matches found, which will be
-  // compared to the table of answers for that pattern. Report any
-  // mismatches.
-  double start_time = get_time();
-  int return_code = 0; // Used for noting if some number of matches fail
-  for (int pattern = 0; pattern < patterns_count; pattern++) {
-    std::string pattern_str = patterns_data[pattern];
-    // Pre-process the pattern before applying it to all sequences.
-    std::vector<ApproxPatternData> pat_data = (*init)(pattern_str, k);
-
-    for (int sequence = 0; sequence < sequences_count; sequence++) {
-      std::string sequence_str = sequences_data[sequence];
-
-      int matches = (*code)(pat_data, sequence_str);
-
-      if (answers_data.size() && matches != answers_data[pattern][sequence]) {
-        std::cerr << "Pattern " << pattern + 1 << " mismatch against sequence "
-                  << sequence + 1 << " (" << matches
-                  << " != " << answers_data[pattern][sequence] << ")\n";
-        return_code++;
-      }
-    }
+  if (encoding == Encoding::dna)
+    encode_data(sequences_data, patterns_data);
+
+  // Open (or build) the pattern cache, if there is one, before the timer
+  // starts.
+  std::unique_ptr<PatternCache> cache = open_cache(
+      options, matcher.cacheable(), matcher.layout(), name, encoding, k,
+      patterns_data, patterns_count,
+      [&](PatternWriter &writer, std::size_t pattern) {
+        matcher.save(patterns_data[pattern], k, writer);
+      });
+  counters.stop(Phase::load);
+
+  // Start the threads (if any) before the timer does.
+  std::unique_ptr<ThreadPool> pool;
+  if (options.threads > 1)
+    pool = std::make_unique<ThreadPool>(options.threads);
+  std::unique_ptr<HitWriter> hits =
+      open_hits(options, matcher.locates(), name, pool ? pool->size() : 1);
+
+  // Run it. For each sequence, try each pattern against it. The matcher will
+  // return the number of matches found, which will be compared to the table of
+  // answers for that pattern. Report any mismatches. For `--bench`, this is
+  // done once for each iteration.
+  std::size_t hits_count = 0;
+  auto run_once = [&](Timing &timing) {
+    double start_time = get_time();
+    int block_size;
+    std::vector<Tile> tiles =
+        plan_tiles(sequences_data, options, pool.get(), block_size);
+    std::vector<std::vector<Mismatch>> mismatches(pool ? pool->size() : 1);
+    matcher.resize(block_size);
+
+    timing.bytes = run_blocks(
+        patterns_count, block_size, tiles, pool.get(),
+        [&](int slot, int pattern) {
+          if (cache) {
+            PatternReader reader = cache->reader(pattern);
+            matcher.load(slot, patterns_data[pattern], k, reader);
+          } else
+            matcher.prepare(slot, patterns_data[pattern], k);
+        },
+        [&](int slot, int sequence, HitSink const *sink) {
+          std::string_view sequence_str = sequences_data[sequence];
+          return sink ? matcher.locate(slot, sequence_str, *sink)
+                      : matcher.match(slot, sequence_str);
+        },
+        answers_data, mismatches, hits.get(), options.limit, timing, counters);
+    if (hits)
+      hits_count = hits->finish();
+
+    counters.start(Phase::verify);
+    timing.mismatches = report_mismatches(mismatches);
+    counters.stop(Phase::verify);
+    // Note the end time.
+    timing.runtime = get_time() - start_time;
+  };
+  std::ostringstream label;
+  label << name << "(" << k << ")";
+  if (options.bench)
+    return run_bench(options, label.str(), counters, run_once);
+
+  Timing timing;
+  run_once(timing);
+
+  std::cout << "language: " << LANG << "\n"
+            << "algorithm: " << label.str() << "\n"
+            << "runtime: " << std::setprecision(8) << timing.runtime << "\n";
+  report_reads(timing.bytes, options);
+  report_cache(cache.get());
+  report_mode(options);
+  report_hits(hits.get(), hits_count);
+  if (pool)
+    report_threads(*pool);
+  counters.report(std::cout);
+
+  return timing.mismatches;
+}
+
+/*
+  A MultiApproxMatcher with its k given, so that run_multi_files() can take it
+  as it takes the exact matchers.
+*/
+class FixedKMatcher : public MultiMatcher {
+public:
+  FixedKMatcher(MultiApproxMatcher &matcher, int k) : matcher(matcher), k(k) {}
+
+  void prepare(std::vector<std::string> const &patterns) override {
+    matcher.prepare(patterns, k);
+  }
+  void match(std::string_view sequence,
+             std::vector<int> &matches) const override {
+    matcher.match(sequence, matches);
+  }
+  bool locates() const override { return matcher.locates(); }
+  void locate(std::string_view sequence, std::vector<int> &matches,
+              HitSink sink) const override {
+    matcher.locate(sequence, matches, sink);
+  }
+
+  bool cacheable() const override { return matcher.cacheable(); }
+  std::uint64_t layout() const override { return matcher.layout(); }
+  void save(std::vector<std::string> const &patterns,
+            PatternWriter &writer) override {
+    matcher.save(patterns, k, writer);
+  }
+  void load(PatternReader &reader) override { matcher.load(reader); }
+  std::size_t table_bytes() override { return matcher.table_bytes(); }
+
+private:
+  MultiApproxMatcher &matcher;
+  int k;
+};
+
+/*
+  The runner for the algorithms that do multi-pattern, approximate matching.
+  The arguments are those of `run_approx_matcher`, and the run is that of
+  `run_multi_matcher`: each sequence is matched against all of the patterns in
+  a single pass.
+*/
+int run_multi_approx_matcher(MultiApproxMatcher &matcher, std::string name,
+                             int argc, char *argv[], Encoding encoding) {
+  std::string message =
+      usage(argv[0], "[ --stream BYTES ] ",
+            "<k> <sequences> <patterns> [ <answers> ]");
+  RunOptions options = parse_options(argc, argv, message);
+  if (!options.serve.empty() ? argc != 3 : argc < 4 || argc > 5)
+    throw std::runtime_error{message};
+  if (options.tile_bytes)
+    throw std::runtime_error{"--tile only applies to single-pattern runners"};
+
+  int k = std::stoi(argv[1]);
+  std::ostringstream label;
+  label << name << "(" << k << ")";
+  FixedKMatcher fixed(matcher, k);
+  if (!options.serve.empty())
+    return run_multi_files(fixed, name, label.str(), options, nullptr, argv[2],
+                           nullptr, k, encoding);
+
+  char answers_file[256];
+  if (argc == 5)
+    sprintf(answers_file, argv[4], k);
+
+  return run_multi_files(fixed, name, label.str(), options, argv[2], argv[3],
+                         argc == 5 ? answers_file : nullptr, k, encoding);
+}
+
+/*
+  The runner for the batch matchers, which match every pattern against every
+  sequence at once on an offload device. The arguments are those of
+  `run_multi_matcher` or, with `approx`, those of `run_approx_matcher`, and
+  the counts are checked against the answers as they are there. The
+  sequences are copied to the device once, with the input, before the timer
+  starts. Each run (or iteration of `--bench`) then prepares the patterns
+  (`init_time`) and matches the whole of the count matrix (`match_time`).
+  As the device does the work, the options for the host's threads, tiles,
+  streams, caches and positions don't apply.
+*/
+int run_batch_matcher(BatchMatcher &matcher, std::string name, int argc,
+                      char *argv[], Encoding encoding, bool approx) {
+  std::ostringstream message;
+  message << "Usage: " << argv[0]
+          << " [ --bench N [ --warmup N ] ] [ --counters ] "
+          << (approx ? "<k> " : "") << "<sequences> <patterns> [ <answers> ]";
+  RunOptions options = parse_options(argc, argv, message.str());
+  int first = approx ? 2 : 1; // The first of the files
+  if (argc < first + 2 || argc > first + 3)
+    throw std::runtime_error{message.str()};
+  if (options.threads > 1 || options.tile_bytes || options.stream_bytes ||
+      !options.pattern_cache.empty() || !options.positions.empty() ||
+      options.limit || !options.serve.empty())
+    throw std::runtime_error{
+        "A batch runner only takes --bench, --warmup and --counters"};
+
+  // Read the data files, and copy the sequences to the device.
+  PhaseCounters counters(options.counters);
+  counters.start(Phase::load);
+  int k = approx ? std::stoi(argv[1]) : -1;
+  SequenceStore sequences_data = read_sequences(argv[first]);
+  int sequences_count = sequences_data.size();
+  std::vector<std::string> patterns_data = read_patterns(argv[first + 1]);
+  int patterns_count = patterns_data.size();
+  AnswersTable answers_data;
+  if (argc == first + 3) {
+    int k_read;
+    char answers_file[256];
+    sprintf(answers_file, argv[first + 2], k);
+    answers_data = read_answers(answers_file, approx ? &k_read : nullptr);
+    int answers_count = answers_data.size();
+    if (answers_count != patterns_count)
+      throw std::runtime_error{
+          "Count mismatch between patterns file and answers file"};
+    if (answers_data.columns() != sequences_data.size())
+      throw std::runtime_error{
+          "Count mismatch between sequences file and answers file"};
+    if (approx && k != k_read)
+      throw std::runtime_error{"Mismatch in k value in answers file"};
   }
-  // Note the end time.
-  double end_time = get_time();
+
+  if (encoding == Encoding::dna)
+    encode_data(sequences_data, patterns_data);
+  matcher.load(sequences_data);
+  counters.stop(Phase::load);
+
+  // Each work-item on the device reads the sequence of its pair, so the data
+  // is read once per pattern, as it is by the single-pattern runners.
+  std::size_t bytes = 0;
+  for (std::string_view sequence : sequences_data)
+    bytes += sequence.length();
+  bytes *= patterns_count;
+
+  std::vector<int> counts;
+  auto run_once = [&](Timing &timing) {
+    double start_time = get_time();
+    counters.start(Phase::init);
+    matcher.prepare(patterns_data, k);
+    counters.stop(Phase::init);
+    double match_start = get_time();
+    timing.init = match_start - start_time;
+
+    counters.start(Phase::search);
+    matcher.match(counts);
+    counters.stop(Phase::search);
+    timing.bytes = bytes;
+
+    counters.start(Phase::verify);
+    if (answers_data.size()) {
+      for (int pattern = 0; pattern < patterns_count; pattern++)
+        for (int sequence = 0; sequence < sequences_count; sequence++) {
+          int found = counts[(std::size_t)pattern * sequences_count + sequence];
+          int wanted = answers_data[pattern][sequence];
+          if (found != wanted) {
+            report_mismatch(pattern, sequence, found, wanted);
+            timing.mismatches++;
+          }
+        }
+    }
+    counters.stop(Phase::verify);
+    // Note the end time.
+    double end_time = get_time();
+    timing.match = end_time - match_start;
+    timing.runtime = end_time - start_time;
+  };
+  std::ostringstream label;
+  label << name;
+  if (approx)
+    label << "(" << k << ")";
+  if (options.bench)
+    return run_bench(options, label.str(), counters, run_once);
+
+  Timing timing;
+  run_once(timing);
 
   std::cout << "language: " << LANG << "\n"
-            << "algorithm: " << name << "(" << k << ")\n"
-            << "runtime: " << std::setprecision(8) << end_time - start_time
-            << "\n";
+            << "algorithm: " << label.str() << "\n"
+            << "runtime: " << std::setprecision(8) << timing.runtime << "\n";
+  report_reads(timing.bytes, options);
+  std::cout << "device: " << matcher.device() << "\n";
+  counters.report(std::cout);
 
-  return return_code;
+  return timing.mismatches;
 }
@@ -1,47 +1,647 @@
 /*
   Header file for the runner module.
+
+  Each algorithm preprocesses a pattern (or, for the multi-pattern ones, the
+  whole set of patterns) into an object of a type of its own, and its matcher
+  takes that object by const reference. The runner functions are templates
+  over that type. They wrap the algorithm's functions in one of the small
+  interfaces below, and the actual running is done behind those interfaces in
+  `run.cpp`.
 */
 
 #ifndef _RUN_HPP
 #define _RUN_HPP
 
-#include <regex>
-#include <set>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <string>
-#include <variant>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-// Typedefs for the function-pointer signatures, and the extern definition of,
-// the single-pattern, exact-matching runner.
-typedef std::variant<std::string, std::vector<int>, unsigned long,
-                     std::vector<unsigned long>>
-    PatternData;
-typedef int (*algorithm)(std::vector<PatternData> const &, std::string const &);
-typedef std::vector<PatternData> (*initializer)(std::string const &);
-extern int run(initializer init, algorithm algo, std::string name, int argc,
-               char *argv[]);
-
-// Typedefs for the function-pointer signatures, and the extern definition of,
-// the multi-pattern, exact-matching runner.
-typedef std::variant<int, std::vector<int>, std::vector<std::vector<int>>,
-                     std::vector<std::set<int>>>
-    MultiPatternData;
-typedef std::vector<int> (*mp_algorithm)(std::vector<MultiPatternData> const &,
-                                         std::string const &);
-typedef std::vector<MultiPatternData> (*mp_initializer)(
-    std::vector<std::string> const &);
-extern int run_multi(mp_initializer init, mp_algorithm algo, std::string name,
-                     int argc, char *argv[]);
-
-// Typedefs for the function-pointer signatures, and the extern definition of,
-// the single-pattern, approximate-matching runner.
-typedef std::variant<int, std::vector<std::vector<int>>, void *>
-    ApproxPatternData;
-typedef int (*am_algorithm)(std::vector<ApproxPatternData> const &,
-                            std::string const &);
-typedef std::vector<ApproxPatternData> (*am_initializer)(std::string const &,
-                                                         int);
-extern int run_approx(am_initializer init, am_algorithm algo, std::string name,
-                      int argc, char *argv[]);
+#include "alphabet.hpp"
+#include "pattern.hpp"
+
+// The form in which a runner hands the sequences and patterns to an algorithm:
+// as they were read, or with A/C/G/T encoded as 0-3 (see `alphabet.hpp`). The
+// encoding is done as part of loading the data, before the timer starts.
+enum class Encoding { ascii, dna };
+
+// A compile-time list of values, for the dispatch to specialized matchers.
+template <int... Values> struct ValueSet {};
+
+// The pattern lengths for which the algorithms can provide matchers
+// specialized at compile time. Any other pattern uses the generic matcher.
+typedef ValueSet<16, 20, 25, 32> FixedLengths;
+
+/*
+  Pick a specialized matcher. `make` is called with whichever of `Values`
+  equals `value`, as a std::integral_constant, and returns the matcher (a
+  function pointer) built for it. The result is nullptr if `value` is not one
+  of `Values`.
+*/
+template <typename Make, int First, int... Rest>
+auto select_fixed(int value, Make make, ValueSet<First, Rest...>) {
+  auto chosen = make(std::integral_constant<int, First>{});
+  if (value == First)
+    return chosen;
+  if constexpr (sizeof...(Rest) == 0)
+    return decltype(chosen){nullptr};
+  else
+    return select_fixed(value, make, ValueSet<Rest...>{});
+}
+
+/*
+  A match position: the pattern and sequence (numbered from 0, in the order of
+  their files) and the offset in the sequence at which the match starts.
+*/
+struct Hit {
+  std::int32_t pattern;
+  std::int32_t sequence;
+  std::int64_t offset;
+};
+
+/*
+  A fixed-size buffer of hits, one per thread, so that adding a hit is a store
+  and nothing is shared between threads. When the buffer is full (and when the
+  runner calls flush() at the end) its hits are handed to `flush` as a batch.
+*/
+class HitBuffer {
+public:
+  typedef std::function<void(Hit const *, std::size_t)> Flush;
+
+  HitBuffer(std::size_t capacity, Flush flush)
+      : hits(capacity), flush_hits(std::move(flush)) {}
+
+  void add(Hit hit) {
+    if (count == hits.size())
+      flush();
+    hits[count++] = hit;
+  }
+  void flush() {
+    if (count)
+      flush_hits(hits.data(), count);
+    count = 0;
+  }
+
+private:
+  std::vector<Hit> hits;
+  std::size_t count = 0;
+  Flush flush_hits;
+};
+
+/*
+  The sinks that a search reports its matches to. An algorithm's search is a
+  template over the sink: its counting form is instantiated with CountOnly,
+  whose calls are empty and compile away, and its locating form with HitSink.
+  A single-pattern search calls `sink(offset)` with the offset at which a
+  match starts. A multi-pattern search calls `sink(pattern, end)` with the
+  offset of the last character instead, which HitSink turns into the start
+  using the pattern lengths it is given. The approximate multi-pattern
+  searches, whose matches are not of the pattern's length, call
+  `sink.at(pattern, offset)` with the start.
+
+  The searches make their calls to the sink under `if constexpr
+  (Sink::reports)`, along with any work that only finding the offsets needs,
+  so that the counting form is the same code as before. (Even a call to an
+  empty function can change how the compiler lays out the loop around it.)
+
+  A HitSink may also carry a limit, for the runners' `--mode`: once full()
+  says that a pattern has that many matches, the search stops looking for
+  more of them (a multi-pattern search stops once every pattern is full). A
+  HitSink with no buffer only counts, which is how the early-exit modes run
+  without `--positions`.
+*/
+struct CountOnly {
+  static constexpr bool reports = false;
+
+  void operator()(int) const {}
+  void operator()(int, int) const {}
+  void at(int, int) const {}
+  bool full(int) const { return false; }
+};
+
+class HitSink {
+public:
+  static constexpr bool reports = true;
+
+  HitSink(HitBuffer *buffer, int limit, int pattern, int sequence)
+      : buffer(buffer), limit(limit), pattern(pattern), sequence(sequence) {}
+  HitSink(HitBuffer *buffer, int limit, int sequence, int const *lengths)
+      : buffer(buffer), limit(limit), sequence(sequence), lengths(lengths) {}
+
+  void operator()(int offset) const {
+    if (buffer)
+      buffer->add({pattern, sequence, offset});
+  }
+  void operator()(int which, int end) const {
+    if (buffer)
+      buffer->add({which, sequence, end - lengths[which] + 1});
+  }
+  void at(int which, int offset) const {
+    if (buffer)
+      buffer->add({which, sequence, offset});
+  }
+
+  // Whether `matches` matches of a pattern are all that is wanted of it.
+  bool full(int matches) const { return limit && matches >= limit; }
+
+private:
+  HitBuffer *buffer;
+  int limit; // 0 for no limit
+  int pattern = -1;
+  int sequence;
+  int const *lengths = nullptr;
+};
+
+/*
+  The interfaces that the runners in `run.cpp` work through. prepare() is
+  called once for each pattern (or once, for the set of patterns), and then
+  match() is called for each sequence. match() may be called from several
+  threads at once, so it must not change the matcher.
+
+  The single-pattern matchers hold a block of prepared patterns at once, one
+  per slot, so that the runners can take a block of sequences through several
+  patterns while it is still in cache. resize() sets the number of slots.
+
+  For a pattern cache (see `cache.hpp`), save() preprocesses a pattern and
+  writes it out, and load() fills a slot from what save() wrote, in place of
+  prepare(). cacheable() is false if the algorithm's pattern type can't be
+  cached, in which case these do nothing. layout() is the pattern type's
+  pattern_layout(), which the cache is checked against.
+
+  locate() is match() that also reports each match to `sink`, for the runners'
+  `--positions`. locates() is false if the algorithm has no locating search.
+
+  table_bytes() is the size of the multi-pattern matchers' prepared tables
+  (by way of PatternSizer), or what the pattern type's own table_bytes() gives
+  if it has no fields() to size, or else 0.
+*/
+class SingleMatcher {
+public:
+  virtual ~SingleMatcher() = default;
+  virtual void resize(int slots) = 0;
+  virtual void prepare(int slot, std::string const &pattern) = 0;
+  virtual int match(int slot, std::string_view sequence) const = 0;
+  virtual bool locates() const = 0;
+  virtual int locate(int slot, std::string_view sequence,
+                     HitSink sink) const = 0;
+
+  virtual bool cacheable() const = 0;
+  virtual std::uint64_t layout() const = 0;
+  virtual void save(std::string const &pattern, PatternWriter &writer) = 0;
+  virtual void load(int slot, std::string const &pattern,
+                    PatternReader &reader) = 0;
+};
+
+class MultiMatcher {
+public:
+  virtual ~MultiMatcher() = default;
+  virtual void prepare(std::vector<std::string> const &patterns) = 0;
+  virtual void match(std::string_view sequence,
+                     std::vector<int> &matches) const = 0;
+  virtual bool locates() const = 0;
+  virtual void locate(std::string_view sequence, std::vector<int> &matches,
+                      HitSink sink) const = 0;
+
+  virtual bool cacheable() const = 0;
+  virtual std::uint64_t layout() const = 0;
+  virtual void save(std::vector<std::string> const &patterns,
+                    PatternWriter &writer) = 0;
+  virtual void load(PatternReader &reader) = 0;
+  virtual std::size_t table_bytes() = 0;
+};
+
+class ApproxMatcher {
+public:
+  virtual ~ApproxMatcher() = default;
+  virtual void resize(int slots) = 0;
+  virtual void prepare(int slot, std::string const &pattern, int k) = 0;
+  virtual int match(int slot, std::string_view sequence) const = 0;
+  virtual bool locates() const = 0;
+  virtual int locate(int slot, std::string_view sequence,
+                     HitSink sink) const = 0;
+
+  virtual bool cacheable() const = 0;
+  virtual std::uint64_t layout() const = 0;
+  virtual void save(std::string const &pattern, int k,
+                    PatternWriter &writer) = 0;
+  virtual void load(int slot, std::string const &pattern, int k,
+                    PatternReader &reader) = 0;
+};
+
+class MultiApproxMatcher {
+public:
+  virtual ~MultiApproxMatcher() = default;
+  virtual void prepare(std::vector<std::string> const &patterns, int k) = 0;
+  virtual void match(std::string_view sequence,
+                     std::vector<int> &matches) const = 0;
+  virtual bool locates() const = 0;
+  virtual void locate(std::string_view sequence, std::vector<int> &matches,
+                      HitSink sink) const = 0;
+
+  virtual bool cacheable() const = 0;
+  virtual std::uint64_t layout() const = 0;
+  virtual void save(std::vector<std::string> const &patterns, int k,
+                    PatternWriter &writer) = 0;
+  virtual void load(PatternReader &reader) = 0;
+  virtual std::size_t table_bytes() = 0;
+};
+
+class SequenceStore;
+
+/*
+  The interface of the batch matchers, which take every pattern against every
+  sequence at once on an offload device (see `sycl_batch.hpp`), rather than
+  one search at a time. load() copies the sequences to the device, once for
+  the run. prepare() preprocesses the patterns (for k, or -1 for the exact
+  algorithms) and copies them over, and match() fills `counts` with the count
+  of each pattern against each sequence: pattern p against sequence s is at
+  counts[p * sequences + s], as the answers table has them. device() names
+  the device, for the output.
+*/
+class BatchMatcher {
+public:
+  virtual ~BatchMatcher() = default;
+  virtual void load(SequenceStore const &sequences) = 0;
+  virtual void prepare(std::vector<std::string> const &patterns, int k) = 0;
+  virtual void match(std::vector<int> &counts) = 0;
+  virtual std::string device() const = 0;
+};
+
+extern int run_matcher(SingleMatcher &matcher, std::string name, int argc,
+                       char *argv[], Encoding encoding);
+extern int run_multi_matcher(MultiMatcher &matcher, std::string name,
+                             int argc, char *argv[], Encoding encoding);
+extern int run_approx_matcher(ApproxMatcher &matcher, std::string name,
+                              int argc, char *argv[], Encoding encoding);
+extern int run_multi_approx_matcher(MultiApproxMatcher &matcher,
+                                    std::string name, int argc, char *argv[],
+                                    Encoding encoding);
+extern int run_batch_matcher(BatchMatcher &matcher, std::string name,
+                             int argc, char *argv[], Encoding encoding,
+                             bool approx);
+
+// The pieces of the runners that the programs measuring something else (such
+// as `aho_corasick_updates.cpp`) report with, so that their output reads the
+// same.
+extern double get_time();
+extern double median(std::vector<double> const &values);
+extern void report_mismatch(int pattern, int sequence, int found,
+                            int expected);
+extern void report_spread(char const *key, std::vector<double> values);
+
+// The signatures of the functions of a single-pattern, exact-matching
+// algorithm. A specializer is given the length of a pattern, and returns the
+// specialized matcher for it or nullptr to use the generic one. A locator is
+// the matcher's locating form (see HitSink, above).
+template <typename Pattern>
+using initializer = Pattern (*)(std::string const &);
+template <typename Pattern>
+using algorithm = int (*)(Pattern const &, std::string_view);
+template <typename Pattern> using specializer = algorithm<Pattern> (*)(int);
+template <typename Pattern>
+using locator = int (*)(Pattern const &, std::string_view, HitSink);
+
+/*
+  The SingleMatcher for an algorithm's functions.
+*/
+template <typename Pattern> class TypedSingleMatcher : public SingleMatcher {
+public:
+  TypedSingleMatcher(initializer<Pattern> init, algorithm<Pattern> code,
+                     specializer<Pattern> special, locator<Pattern> locator)
+      : init(init), code(code), special(special), locator_fn(locator) {}
+
+  void resize(int slots) override {
+    patterns.resize(slots);
+    chosen.resize(slots, nullptr);
+    arenas.resize(slots);
+  }
+  void prepare(int slot, std::string const &pattern_str) override {
+    // The tables of the slot's last pattern are done with.
+    arenas[slot].reset();
+    ArenaScope scope(arenas[slot]);
+    patterns[slot] = (*init)(pattern_str);
+    choose(slot, pattern_str.length());
+  }
+  int match(int slot, std::string_view sequence) const override {
+    return (*chosen[slot])(patterns[slot], sequence);
+  }
+  bool locates() const override { return locator_fn != nullptr; }
+  int locate(int slot, std::string_view sequence,
+             HitSink sink) const override {
+    return (*locator_fn)(patterns[slot], sequence, sink);
+  }
+
+  bool cacheable() const override { return Cacheable<Pattern>; }
+  std::uint64_t layout() const override {
+    return pattern_layout<Pattern>();
+  }
+  void save(std::string const &pattern_str, PatternWriter &writer) override {
+    if constexpr (Cacheable<Pattern>) {
+      Pattern pattern = (*init)(pattern_str);
+      pattern.fields(writer);
+    }
+  }
+  void load(int slot, std::string const &pattern_str,
+            PatternReader &reader) override {
+    if constexpr (Cacheable<Pattern>) {
+      patterns[slot] = Pattern{};
+      patterns[slot].fields(reader);
+      choose(slot, pattern_str.length());
+    }
+  }
+
+private:
+  void choose(int slot, int m) {
+    chosen[slot] = special ? (*special)(m) : nullptr;
+    if (!chosen[slot])
+      chosen[slot] = code;
+  }
+
+  initializer<Pattern> init;
+  algorithm<Pattern> code;
+  specializer<Pattern> special;
+  locator<Pattern> locator_fn;
+  std::vector<Pattern> patterns;
+  std::vector<algorithm<Pattern>> chosen;
+  // The storage of the slots' tables (see `pattern.hpp`).
+  std::vector<Arena> arenas;
+};
+
+/*
+  The single-pattern, exact-matching runner. The pattern type is taken from
+  the initializer.
+*/
+template <typename Pattern>
+int run(initializer<Pattern> init,
+        std::type_identity_t<algorithm<Pattern>> code, std::string name,
+        int argc, char *argv[],
+        Encoding encoding = Encoding::ascii,
+        std::type_identity_t<specializer<Pattern>> special = nullptr,
+        std::type_identity_t<locator<Pattern>> locate = nullptr) {
+  TypedSingleMatcher<Pattern> matcher(init, code, special, locate);
+
+  return run_matcher(matcher, name, argc, argv, encoding);
+}
+
+// The signatures of the functions of a multi-pattern, exact-matching
+// algorithm. The algorithm writes its per-pattern counts into the vector
+// passed in, which the runner allocates once.
+template <typename Pattern>
+using mp_initializer = Pattern (*)(std::vector<std::string> const &);
+template <typename Pattern>
+using mp_algorithm = void (*)(Pattern const &, std::string_view,
+                              std::vector<int> &);
+template <typename Pattern>
+using mp_locator = void (*)(Pattern const &, std::string_view,
+                            std::vector<int> &, HitSink);
+
+/*
+  The MultiMatcher for an algorithm's functions.
+*/
+template <typename Pattern> class TypedMultiMatcher : public MultiMatcher {
+public:
+  TypedMultiMatcher(mp_initializer<Pattern> init, mp_algorithm<Pattern> code,
+                    mp_locator<Pattern> locator)
+      : init(init), code(code), locator_fn(locator) {}
+
+  void prepare(std::vector<std::string> const &patterns_data) override {
+    arena.reset();
+    ArenaScope scope(arena);
+    patterns = (*init)(patterns_data);
+  }
+  void match(std::string_view sequence,
+             std::vector<int> &matches) const override {
+    (*code)(patterns, sequence, matches);
+  }
+  bool locates() const override { return locator_fn != nullptr; }
+  void locate(std::string_view sequence, std::vector<int> &matches,
+              HitSink sink) const override {
+    (*locator_fn)(patterns, sequence, matches, sink);
+  }
+
+  bool cacheable() const override { return Cacheable<Pattern>; }
+  std::uint64_t layout() const override {
+    return pattern_layout<Pattern>();
+  }
+  void save(std::vector<std::string> const &patterns_data,
+            PatternWriter &writer) override {
+    if constexpr (Cacheable<Pattern>) {
+      Pattern prepared = (*init)(patterns_data);
+      prepared.fields(writer);
+    }
+  }
+  void load(PatternReader &reader) override {
+    if constexpr (Cacheable<Pattern>) {
+      patterns = Pattern{};
+      patterns.fields(reader);
+    }
+  }
+  std::size_t table_bytes() override {
+    PatternSizer sizer;
+    if constexpr (Cacheable<Pattern>)
+      patterns.fields(sizer);
+    else if constexpr (requires { patterns.table_bytes(); })
+      sizer.bytes = patterns.table_bytes();
+    return sizer.bytes;
+  }
+
+private:
+  mp_initializer<Pattern> init;
+  mp_algorithm<Pattern> code;
+  mp_locator<Pattern> locator_fn;
+  Pattern patterns;
+  Arena arena;
+};
+
+/*
+  The multi-pattern, exact-matching runner.
+*/
+template <typename Pattern>
+int run_multi(mp_initializer<Pattern> init,
+              std::type_identity_t<mp_algorithm<Pattern>> code,
+              std::string name, int argc, char *argv[],
+              Encoding encoding = Encoding::ascii,
+              std::type_identity_t<mp_locator<Pattern>> locate = nullptr) {
+  TypedMultiMatcher<Pattern> matcher(init, code, locate);
+
+  return run_multi_matcher(matcher, name, argc, argv, encoding);
+}
+
+// The signatures of the functions of a single-pattern, approximate-matching
+// algorithm. A specializer is given the length of a pattern and k, and
+// returns the specialized matcher for them or nullptr to use the generic one.
+template <typename Pattern>
+using am_initializer = Pattern (*)(std::string const &, int);
+template <typename Pattern>
+using am_algorithm = int (*)(Pattern const &, std::string_view);
+template <typename Pattern>
+using am_specializer = am_algorithm<Pattern> (*)(int, int);
+template <typename Pattern>
+using am_locator = int (*)(Pattern const &, std::string_view, HitSink);
+
+/*
+  The ApproxMatcher for an algorithm's functions.
+*/
+template <typename Pattern> class TypedApproxMatcher : public ApproxMatcher {
+public:
+  TypedApproxMatcher(am_initializer<Pattern> init, am_algorithm<Pattern> code,
+                     am_specializer<Pattern> special,
+                     am_locator<Pattern> locator)
+      : init(init), code(code), special(special), locator_fn(locator) {}
+
+  void resize(int slots) override {
+    patterns.resize(slots);
+    chosen.resize(slots, nullptr);
+    arenas.resize(slots);
+  }
+  void prepare(int slot, std::string const &pattern_str, int k) override {
+    arenas[slot].reset();
+    ArenaScope scope(arenas[slot]);
+    patterns[slot] = (*init)(pattern_str, k);
+    choose(slot, pattern_str.length(), k);
+  }
+  int match(int slot, std::string_view sequence) const override {
+    return (*chosen[slot])(patterns[slot], sequence);
+  }
+  bool locates() const override { return locator_fn != nullptr; }
+  int locate(int slot, std::string_view sequence,
+             HitSink sink) const override {
+    return (*locator_fn)(patterns[slot], sequence, sink);
+  }
+
+  bool cacheable() const override { return Cacheable<Pattern>; }
+  std::uint64_t layout() const override {
+    return pattern_layout<Pattern>();
+  }
+  void save(std::string const &pattern_str, int k,
+            PatternWriter &writer) override {
+    if constexpr (Cacheable<Pattern>) {
+      Pattern pattern = (*init)(pattern_str, k);
+      pattern.fields(writer);
+    }
+  }
+  void load(int slot, std::string const &pattern_str, int k,
+            PatternReader &reader) override {
+    if constexpr (Cacheable<Pattern>) {
+      patterns[slot] = Pattern{};
+      patterns[slot].fields(reader);
+      choose(slot, pattern_str.length(), k);
+    }
+  }
+
+private:
+  void choose(int slot, int m, int k) {
+    chosen[slot] = special ? (*special)(m, k) : nullptr;
+    if (!chosen[slot])
+      chosen[slot] = code;
+  }
+
+  am_initializer<Pattern> init;
+  am_algorithm<Pattern> code;
+  am_specializer<Pattern> special;
+  am_locator<Pattern> locator_fn;
+  std::vector<Pattern> patterns;
+  std::vector<am_algorithm<Pattern>> chosen;
+  std::vector<Arena> arenas;
+};
+
+/*
+  The single-pattern, approximate-matching runner.
+*/
+template <typename Pattern>
+int run_approx(am_initializer<Pattern> init,
+               std::type_identity_t<am_algorithm<Pattern>> code,
+               std::string name, int argc, char *argv[],
+               Encoding encoding = Encoding::ascii,
+               std::type_identity_t<am_specializer<Pattern>> special = nullptr,
+               std::type_identity_t<am_locator<Pattern>> locate = nullptr) {
+  TypedApproxMatcher<Pattern> matcher(init, code, special, locate);
+
+  return run_approx_matcher(matcher, name, argc, argv, encoding);
+}
+
+// The signatures of the functions of a multi-pattern, approximate-matching
+// algorithm. These are those of the multi-pattern, exact-matching algorithms,
+// but for the k given to the initializer.
+template <typename Pattern>
+using mam_initializer = Pattern (*)(std::vector<std::string> const &, int);
+
+/*
+  The MultiApproxMatcher for an algorithm's functions.
+*/
+template <typename Pattern>
+class TypedMultiApproxMatcher : public MultiApproxMatcher {
+public:
+  TypedMultiApproxMatcher(mam_initializer<Pattern> init,
+                          mp_algorithm<Pattern> code,
+                          mp_locator<Pattern> locator)
+      : init(init), code(code), locator_fn(locator) {}
+
+  void prepare(std::vector<std::string> const &patterns_data,
+               int k) override {
+    arena.reset();
+    ArenaScope scope(arena);
+    patterns = (*init)(patterns_data, k);
+  }
+  void match(std::string_view sequence,
+             std::vector<int> &matches) const override {
+    (*code)(patterns, sequence, matches);
+  }
+  bool locates() const override { return locator_fn != nullptr; }
+  void locate(std::string_view sequence, std::vector<int> &matches,
+              HitSink sink) const override {
+    (*locator_fn)(patterns, sequence, matches, sink);
+  }
+
+  bool cacheable() const override { return Cacheable<Pattern>; }
+  std::uint64_t layout() const override {
+    return pattern_layout<Pattern>();
+  }
+  void save(std::vector<std::string> const &patterns_data, int k,
+            PatternWriter &writer) override {
+    if constexpr (Cacheable<Pattern>) {
+      Pattern prepared = (*init)(patterns_data, k);
+      prepared.fields(writer);
+    }
+  }
+  void load(PatternReader &reader) override {
+    if constexpr (Cacheable<Pattern>) {
+      patterns = Pattern{};
+      patterns.fields(reader);
+    }
+  }
+  std::size_t table_bytes() override {
+    PatternSizer sizer;
+    if constexpr (Cacheable<Pattern>)
+      patterns.fields(sizer);
+    return sizer.bytes;
+  }
+
+private:
+  mam_initializer<Pattern> init;
+  mp_algorithm<Pattern> code;
+  mp_locator<Pattern> locator_fn;
+  Pattern patterns;
+  Arena arena;
+};
+
+/*
+  The multi-pattern, approximate-matching runner.
+*/
+template <typename Pattern>
+int run_multi_approx(mam_initializer<Pattern> init,
+                     std::type_identity_t<mp_algorithm<Pattern>> code,
+                     std::string name, int argc, char *argv[],
+                     Encoding encoding = Encoding::ascii,
+                     std::type_identity_t<mp_locator<Pattern>> locate =
+                         nullptr) {
+  TypedMultiApproxMatcher<Pattern> matcher(init, code, locate);
+
+  return run_multi_approx_matcher(matcher, name, argc, argv, encoding);
+}
 
 #endif // !_RUN_HPP
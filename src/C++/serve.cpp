@@ -0,0 +1,433 @@
+/*
+  The server of the runners' `--serve`. See `serve.hpp` for the protocol.
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <csignal>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+#include "input.hpp"
+#include "serve.hpp"
+
+// The size the buffer of a client's reading starts at. It grows to hold the
+// longest line read.
+constexpr std::size_t READ_BYTES = 1 << 16;
+
+/*
+  An error from a system call, with the reason for it.
+*/
+static std::runtime_error system_error(std::string const &what) {
+  std::ostringstream msg;
+  msg << what << ": " << std::strerror(errno);
+  return std::runtime_error{msg.str()};
+}
+
+/*
+  A client of the server: the descriptors its requests are read from and its
+  answers are written to, which are the same one for a socket. The lines are
+  read by the client's reading thread. The answers are queued by the matching
+  and written by the client's writing thread, which runs until the reading
+  has ended and every request read has been answered. Once a write fails (the
+  client has gone, or stopped reading), the rest of its answers are dropped.
+*/
+class ServeClient {
+public:
+  ServeClient(int in, int out, bool socket)
+      : in(in), out(out), socket(socket), buffer(READ_BYTES) {}
+  ~ServeClient() {
+    if (socket)
+      close(in);
+  }
+
+  ServeClient(ServeClient const &) = delete;
+  ServeClient &operator=(ServeClient const &) = delete;
+
+  bool read_line(std::string_view &line);
+  // Note a request read, which is to be answered with answer().
+  void expect_answer();
+  void answer(std::string text);
+  // Note that no more requests will be read. `last` (if any) is written after
+  // the answers to those that were.
+  void end_reading(std::string last);
+  void write_answers();
+  // Make the reading see the end of the input, to stop the client's thread.
+  void stop_reading() {
+    if (socket)
+      shutdown(in, SHUT_RD);
+  }
+
+private:
+  int in, out;
+  bool socket;
+  std::vector<char> buffer;
+  std::size_t start = 0, end = 0; // The part of `buffer` not yet taken
+
+  void write(std::string const &text);
+
+  std::mutex answers_lock;
+  std::condition_variable answers_changed;
+  std::deque<std::string> answers; // Queued, not yet written
+  std::size_t unanswered = 0;
+  bool reading = true;
+  std::string last;
+  bool broken = false; // Only touched by the writing thread
+};
+
+/*
+  Read the next line (without its newline, or a carriage return before it),
+  which stays valid until the next call. The last line needn't end in a
+  newline. Returns false at the end of the input.
+*/
+bool ServeClient::read_line(std::string_view &line) {
+  for (;;) {
+    char *first = buffer.data() + start;
+    char *newline = static_cast<char *>(std::memchr(first, '\n', end - start));
+    if (newline) {
+      start = newline + 1 - buffer.data();
+      if (newline > first && newline[-1] == '\r')
+        newline--;
+      line = std::string_view(first, newline - first);
+      return true;
+    }
+
+    // Move what is left of the buffer to the front, or grow it if that is a
+    // whole buffer of one line.
+    if (start > 0) {
+      std::memmove(buffer.data(), first, end - start);
+      end -= start;
+      start = 0;
+    } else if (end == buffer.size())
+      buffer.resize(2 * buffer.size());
+    ssize_t got = read(in, buffer.data() + end, buffer.size() - end);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0) {
+      if (end == start)
+        return false;
+      line = std::string_view(buffer.data() + start, end - start);
+      start = end;
+      return true;
+    }
+    end += got;
+  }
+}
+
+void ServeClient::expect_answer() {
+  std::lock_guard<std::mutex> guard(answers_lock);
+  unanswered++;
+}
+
+void ServeClient::answer(std::string text) {
+  std::lock_guard<std::mutex> guard(answers_lock);
+  answers.push_back(std::move(text));
+  unanswered--;
+  answers_changed.notify_one();
+}
+
+void ServeClient::end_reading(std::string last) {
+  std::lock_guard<std::mutex> guard(answers_lock);
+  reading = false;
+  this->last = std::move(last);
+  answers_changed.notify_one();
+}
+
+/*
+  The body of the client's writing thread: write the answers as they are
+  queued, and then the last line, once there are no more to come.
+*/
+void ServeClient::write_answers() {
+  std::unique_lock<std::mutex> guard(answers_lock);
+
+  for (;;) {
+    answers_changed.wait(guard, [this] {
+      return !answers.empty() || (!reading && unanswered == 0);
+    });
+    if (answers.empty())
+      break;
+    std::string text = std::move(answers.front());
+    answers.pop_front();
+    guard.unlock();
+    write(text);
+    guard.lock();
+  }
+  guard.unlock();
+  write(last);
+}
+
+/*
+  Write all of `text` to the client. A socket's sends time out (see
+  SERVE_SEND_SECONDS), which counts as a failure.
+*/
+void ServeClient::write(std::string const &text) {
+  std::size_t written = 0;
+
+  while (!broken && written < text.size()) {
+    ssize_t put = socket ? send(out, text.data() + written,
+                                text.size() - written, MSG_NOSIGNAL)
+                         : ::write(out, text.data() + written,
+                                   text.size() - written);
+    if (put < 0 && errno == EINTR)
+      continue;
+    if (put <= 0)
+      broken = true;
+    else
+      written += put;
+  }
+}
+
+/*
+  Start serving: the thread reading the standard input, or the one accepting
+  the clients of the socket at `address`. A socket left at `address` by an
+  earlier server is replaced, but not any other kind of file.
+*/
+RequestServer::RequestServer(std::string const &address, bool encode)
+    : address(address), encode(encode) {
+  // A client that goes away shows up as a failed write, rather than the
+  // signal that would end the process.
+  std::signal(SIGPIPE, SIG_IGN);
+
+  if (address == "-") {
+    start_client(std::make_shared<ServeClient>(STDIN_FILENO, STDOUT_FILENO,
+                                               false));
+    return;
+  }
+
+  sockaddr_un name{};
+  name.sun_family = AF_UNIX;
+  if (address.size() >= sizeof(name.sun_path))
+    throw std::runtime_error{"Socket path too long: " + address};
+  std::memcpy(name.sun_path, address.c_str(), address.size() + 1);
+  struct stat info;
+  if (stat(address.c_str(), &info) == 0 && S_ISSOCK(info.st_mode))
+    unlink(address.c_str());
+
+  listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0)
+    throw system_error("socket");
+  if (bind(listener, reinterpret_cast<sockaddr *>(&name), sizeof(name)) < 0 ||
+      listen(listener, SOMAXCONN) < 0) {
+    std::runtime_error failure = system_error(address);
+    close(listener);
+    throw failure;
+  }
+  acceptor = std::thread(&RequestServer::accept_clients, this);
+}
+
+RequestServer::~RequestServer() {
+  stop();
+  if (acceptor.joinable())
+    acceptor.join();
+  // Once the acceptor is done, no more threads are started.
+  for (auto &thread : threads)
+    thread.join();
+  if (listener >= 0) {
+    close(listener);
+    unlink(address.c_str());
+  }
+}
+
+/*
+  Take a client on, with its reading and its writing threads. The caller
+  holds the lock, or is the constructor.
+*/
+void RequestServer::start_client(std::shared_ptr<ServeClient> client) {
+  // Join the threads of the clients that have gone, so that a server that
+  // runs for long doesn't keep hold of them. They have done all but return.
+  for (std::thread::id id : finished) {
+    auto thread = std::find_if(threads.begin(), threads.end(),
+                               [id](auto const &started) {
+                                 return started.get_id() == id;
+                               });
+    thread->join();
+    threads.erase(thread);
+  }
+  finished.clear();
+
+  // The list only holds the clients for stop(); they are kept alive by their
+  // threads and their requests.
+  std::erase_if(clients, [](auto const &weak) { return weak.expired(); });
+  clients.push_back(client);
+  readers++;
+  threads.emplace_back(&RequestServer::read_requests, this, client);
+  threads.emplace_back(&RequestServer::write_answers, this, client);
+}
+
+/*
+  The body of the accepting thread, which starts a reading thread for each
+  client until the server stops.
+*/
+void RequestServer::accept_clients() {
+  for (;;) {
+    int fd = accept(listener, nullptr, nullptr);
+    std::lock_guard<std::mutex> guard(lock);
+    if (stopping) {
+      if (fd >= 0)
+        close(fd);
+      return;
+    }
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      error = std::make_exception_ptr(system_error("accept"));
+      stopping = true;
+      changed.notify_all();
+      return;
+    }
+    timeval timeout{SERVE_SEND_SECONDS, 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    start_client(std::make_shared<ServeClient>(fd, fd, true));
+  }
+}
+
+/*
+  The body of a client's reading thread, which queues its requests as they
+  are read. The end of the standard input stops the server; the end of a
+  socket connection only ends its client.
+*/
+void RequestServer::read_requests(std::shared_ptr<ServeClient> client) {
+  std::string_view line;
+  std::string last;
+
+  try {
+    while (client->read_line(line)) {
+      if (line.empty())
+        continue;
+      if (line == "quit") {
+        stop();
+        break;
+      }
+
+      std::size_t count = 0;
+      auto [end, failed] =
+          std::from_chars(line.data(), line.data() + line.size(), count);
+      if (failed != std::errc{} ||
+          (end != line.data() + line.size() && *end != ' '))
+        throw std::runtime_error{"Request must start with a count"};
+
+      ServeRequest request;
+      request.client = client;
+      // The count is the client's word alone, so nothing is sized by it.
+      std::vector<std::size_t> ends;
+      for (std::size_t i = 0; i < count; i++) {
+        if (!client->read_line(line))
+          throw std::runtime_error{"Request ended early"};
+        request.data.insert(request.data.end(), line.begin(), line.end());
+        ends.push_back(request.data.size());
+      }
+      if (encode)
+        encode_dna(std::string_view(request.data.data(), request.data.size()),
+                   request.data.data());
+      std::size_t begin = 0;
+      for (std::size_t end : ends) {
+        request.sequences.emplace_back(request.data.data() + begin,
+                                       end - begin);
+        begin = end;
+      }
+      request.arrived = std::chrono::steady_clock::now();
+
+      client->expect_answer();
+      std::lock_guard<std::mutex> guard(lock);
+      waiting.push_back(std::move(request));
+      changed.notify_all();
+    }
+  } catch (std::exception const &failure) {
+    last = std::string("error: ") + failure.what() + "\n";
+  }
+  client->end_reading(std::move(last));
+
+  std::lock_guard<std::mutex> guard(lock);
+  readers--;
+  if (listener < 0)
+    stopping = true;
+  finished.push_back(std::this_thread::get_id());
+  changed.notify_all();
+}
+
+/*
+  The body of a client's writing thread, which writes its answers until it
+  has had all of them.
+*/
+void RequestServer::write_answers(std::shared_ptr<ServeClient> client) {
+  client->write_answers();
+
+  std::lock_guard<std::mutex> guard(lock);
+  finished.push_back(std::this_thread::get_id());
+}
+
+/*
+  Stop taking requests: wake the acceptor and the readers, which then see
+  that the server is stopping (or the end of their input).
+*/
+void RequestServer::stop() {
+  std::lock_guard<std::mutex> guard(lock);
+  stopping = true;
+  if (listener >= 0)
+    shutdown(listener, SHUT_RDWR);
+  for (auto const &weak : clients)
+    if (auto client = weak.lock())
+      client->stop_reading();
+  changed.notify_all();
+}
+
+/*
+  Wait for requests, and move those waiting into `batch`, in the order they
+  arrived, up to SERVE_BATCH_BYTES of them. Returns false once the server has
+  stopped and every request has been taken.
+*/
+bool RequestServer::next(std::vector<ServeRequest> &batch) {
+  batch.clear();
+  std::unique_lock<std::mutex> guard(lock);
+  changed.wait(guard, [this] {
+    return !waiting.empty() || error || (stopping && readers == 0);
+  });
+  if (error)
+    std::rethrow_exception(error);
+
+  std::size_t bytes = 0;
+  while (!waiting.empty() &&
+         (batch.empty() ||
+          bytes + waiting.front().data.size() <= SERVE_BATCH_BYTES)) {
+    bytes += waiting.front().data.size();
+    batch.push_back(std::move(waiting.front()));
+    waiting.pop_front();
+  }
+
+  return !batch.empty();
+}
+
+/*
+  Send the answer to `request`: `counts` holds the counts of the `patterns`
+  patterns against each of its sequences in turn.
+*/
+void RequestServer::answer(ServeRequest const &request, int const *counts,
+                           int patterns) {
+  std::size_t sequences = request.sequences.size();
+  std::string text = std::to_string(sequences) + " " +
+                     std::to_string(patterns) + "\n";
+  char number[16];
+
+  text.reserve(text.size() + sequences * patterns * 2);
+  for (std::size_t s = 0; s < sequences; s++) {
+    for (int p = 0; p < patterns; p++) {
+      if (p)
+        text += ',';
+      auto [end, failed] =
+          std::to_chars(number, number + sizeof(number), *counts++);
+      text.append(number, end);
+    }
+    text += '\n';
+  }
+  request.client->answer(std::move(text));
+}
@@ -0,0 +1,108 @@
+/*
+  Header file for the server of the runners' `--serve ADDRESS`, under which a
+  runner prepares its patterns once and then answers requests for counts
+  until it is told to stop, rather than matching the one sequences file.
+
+  ADDRESS is `-` for the standard input and output, or else the path of a Unix
+  socket to listen on, which any number of clients can be connected to at
+  once. A request is a set of sequences, written as a sequences file is: a
+  line with the number of them (anything after the number is ignored), then
+  the sequences, a line each. Its answer is a line with the number of
+  sequences and the number of patterns, then a line for each sequence, with
+  the count of each pattern in it, separated by commas. Each connection gets
+  its answers in the order of its requests, so a client can send requests
+  without waiting for the answers to those before them.
+
+  A line `quit` in place of a request stops the server, once the requests
+  already read have been answered. On the standard input, so does the end of
+  the input. A request that can't be read is answered with a line `error:`
+  and the reason, and its connection is closed.
+
+  Each client has a thread of its own that reads (and encodes, if asked) its
+  requests, so that the reading overlaps the matching. The matching takes the
+  requests that are waiting together as a batch, of up to about
+  SERVE_BATCH_BYTES of sequence data, so that under load the cost of handing
+  a batch out to the threads is shared between the requests in it. The
+  answers are queued for another thread of the client's, which writes them,
+  so that a client that is slow to read its answers holds up only itself. A
+  socket client that takes none of its answers for SERVE_SEND_SECONDS is
+  dropped.
+*/
+
+#ifndef _SERVE_HPP
+#define _SERVE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// The most sequence data taken into a batch, unless a single request is
+// larger. Big enough for all the threads to have work, small enough that a
+// request isn't kept waiting long behind the others in its batch.
+constexpr std::size_t SERVE_BATCH_BYTES = 1 << 20;
+
+// How long the writing of an answer to a socket may go without progress
+// before the client is taken to have stopped reading, and is dropped.
+constexpr int SERVE_SEND_SECONDS = 30;
+
+class ServeClient;
+
+/*
+  A request as read from a client. The views of `sequences` point into
+  `data`, which holds the sequences back to back. `arrived` is when the last
+  line of it was read, for the latency of the answer.
+*/
+struct ServeRequest {
+  std::shared_ptr<ServeClient> client;
+  std::vector<char> data;
+  std::vector<std::string_view> sequences;
+  std::chrono::steady_clock::time_point arrived;
+};
+
+class RequestServer {
+public:
+  // With `encode`, the sequences are given to the matching in the DNA
+  // encoding.
+  RequestServer(std::string const &address, bool encode);
+  ~RequestServer();
+
+  RequestServer(RequestServer const &) = delete;
+  RequestServer &operator=(RequestServer const &) = delete;
+
+  bool next(std::vector<ServeRequest> &batch);
+  void answer(ServeRequest const &request, int const *counts, int patterns);
+
+private:
+  void accept_clients();
+  void read_requests(std::shared_ptr<ServeClient> client);
+  void write_answers(std::shared_ptr<ServeClient> client);
+  void start_client(std::shared_ptr<ServeClient> client);
+  void stop();
+
+  std::string address;
+  bool encode;
+  int listener = -1;
+
+  std::mutex lock;
+  std::condition_variable changed;
+  std::deque<ServeRequest> waiting;
+  std::vector<std::weak_ptr<ServeClient>> clients;
+  int readers = 0; // The reading threads still running
+  bool stopping = false;
+  std::exception_ptr error;
+  std::thread acceptor;
+  // The clients' reading and writing threads, and those of them that have
+  // finished, which are joined as the next client comes.
+  std::vector<std::thread> threads;
+  std::vector<std::thread::id> finished;
+};
+
+#endif // !_SERVE_HPP
@@ -3,33 +3,51 @@
 
   This is based heavily on the code given in chapter 5 of the book, "Handbook
   of Exact String-Matching Algorithms," by Christian Charras and Thierry Lecroq.
+
+  Patterns longer than one machine word are handled by keeping the state in an
+  array of words, with the shift carrying from each word into the next.
 */
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "run.hpp"
 
-// Define the alphabet size, part of the Shift-Or pre-processing. Here, we
-// are just using ASCII characters, so 128 is fine.
-constexpr int ASIZE = 128;
+// Define the alphabet size, part of the Shift-Or pre-processing. The runner
+// encodes the DNA alphabet as 0-3 (see `alphabet.hpp`), so four is enough.
+constexpr int ASIZE = DNA_ASIZE;
 
 // We need to also know the word size in bits. For this, we're going to use
-// `unsigned long` values. This allows a search pattern of up to 64 characters,
-// even though the experimental data doesn't go nearly this high. This is a
-// sort of "insurance" against adding other experiments that might push this
-// limit.
+// `unsigned long` values. A pattern of up to 64 characters fits in a single
+// word, which is the fast path. Longer patterns use as many words as they need.
 constexpr int WORD = 64;
 typedef unsigned long WORD_TYPE;
 
+/*
+  The preprocessed form of a pattern. For a pattern longer than WORD, `lim` is
+  instead the mask of the last pattern position (see calc_s_positions_multi()),
+  and `s_positions` holds `words` words for each character.
+*/
+struct alignas(CACHE_LINE) ShiftOrPattern {
+  WORD_TYPE lim = 0;
+  int words = 0;
+  AlignedArray<WORD_TYPE> s_positions;
+
+  template <typename Archive> void fields(Archive &archive) {
+    archive(lim, words, s_positions);
+  }
+};
+
 /*
   Preprocessing step: Calculate the positions of each character of the
   alphabet within the pattern `pat`.
 */
 WORD_TYPE calc_s_positions(std::string const &pat, int m,
-                           std::vector<WORD_TYPE> &s_positions) {
+                           AlignedArray<WORD_TYPE> &s_positions) {
   WORD_TYPE j, lim;
   int i;
 
@@ -42,54 +60,173 @@ WORD_TYPE calc_s_positions(std::string const &pat, int m,
   return lim;
 }
 
+/*
+  Preprocessing step for patterns longer than a word: the same as above, but
+  the positions of each character take up `words` words, stored together, with
+  bit i of the pattern in word i / WORD. The return value is the mask of the
+  bit for the last position of the pattern, within the last word.
+*/
+WORD_TYPE calc_s_positions_multi(std::string const &pat, int m, int words,
+                                 AlignedArray<WORD_TYPE> &s_positions) {
+  for (int i = 0; i < m; ++i)
+    s_positions[pat[i] * words + i / WORD] &= ~((WORD_TYPE)1 << (i % WORD));
+
+  return (WORD_TYPE)1 << ((m - 1) % WORD);
+}
+
 /*
   Initialize the structure for Shift-Or (Bitap). Here, that means setting up
-  the `s_positions` array and calculating `lim`. The return value is a vector
-  of the `PatternData` type, which is a type-safe union of sorts that covers
-  the different types that have to be returned.
+  the `s_positions` array and calculating `lim`. The return value is the
+  preprocessed pattern.
 */
-std::vector<PatternData> init_shift_or(std::string const &pattern) {
+ShiftOrPattern init_shift_or(std::string const &pattern) {
   int m = pattern.length();
-  if (m > WORD) {
+  if (m < 1) {
     std::ostringstream error;
-    error << "shift_or: pattern size must be <= " << WORD;
+    error << "shift_or: pattern size must be >= 1";
     throw std::runtime_error{error.str()};
   }
+  int words = (m + WORD - 1) / WORD;
 
-  std::vector<PatternData> return_val;
-  return_val.reserve(2);
-  // Declare and initialize the s_positions vector:
-  std::vector<WORD_TYPE> s_positions(ASIZE, ~0);
+  ShiftOrPattern return_val;
+  return_val.words = words;
+  // Declare and initialize the s_positions table:
+  return_val.s_positions = AlignedArray<WORD_TYPE>(ASIZE * words, ~0);
+  auto &s_positions = return_val.s_positions;
 
   /* Preprocessing */
-  WORD_TYPE lim = calc_s_positions(pattern, m, s_positions);
-
-  return_val.push_back(lim);
-  return_val.push_back(s_positions);
+  return_val.lim = words == 1
+                       ? calc_s_positions(pattern, m, s_positions)
+                       : calc_s_positions_multi(pattern, m, words, s_positions);
 
   return return_val;
 }
 
+/*
+  The multi-word search. A 0 bit can only move up the state one position per
+  character, starting from bit 0, so the words past the first stay all ones
+  until the last bit of the first word goes to 0. Until then only the first
+  word is updated, which is as cheap as the single-word search. After that,
+  each step updates just the words up to one past the highest word that still
+  holds a 0. On data where partial matches die out quickly, this keeps the cost
+  per character close to that of one word, whatever the length of the pattern.
+*/
+template <typename Sink>
+static int shift_or_multi_word(WORD_TYPE last_bit,
+                               AlignedArray<WORD_TYPE> const &s_positions,
+                               int words, std::string_view sequence,
+                               Sink sink) {
+  constexpr WORD_TYPE high_bit = (WORD_TYPE)1 << (WORD - 1);
+  int m = (words - 1) * WORD + __builtin_ctzl(last_bit) + 1;
+  // The state is kept from call to call, so the search doesn't allocate.
+  thread_local std::vector<WORD_TYPE> state;
+  state.assign(words, ~(WORD_TYPE)0);
+  WORD_TYPE first_word[ASIZE];
+  int matches = 0;
+  int j = 0;
+
+  for (int c = 0; c < ASIZE; c++)
+    first_word[c] = s_positions[c * words];
+
+  int n = sequence.length();
+
+  while (j < n) {
+    // Only the first word is live while its last bit is 1.
+    WORD_TYPE first = state[0];
+    while (j < n && (first & high_bit))
+      first = (first << 1) | first_word[(int)sequence[j++]];
+    state[0] = first;
+
+    int top = 0; // The highest word of `state` that has a 0 bit
+    while (j < n && (top > 0 || !(state[0] & high_bit))) {
+      WORD_TYPE const *t = &s_positions[sequence[j++] * words];
+      int active = std::min(top + 1, words - 1);
+
+      for (int k = active; k > 0; --k)
+        state[k] = (state[k] << 1 | state[k - 1] >> (WORD - 1)) | t[k];
+      state[0] = (state[0] << 1) | t[0];
+
+      for (top = active; top > 0 && state[top] == ~(WORD_TYPE)0; --top)
+        ;
+      if (top == words - 1 && !(state[top] & last_bit)) {
+        matches++;
+        if constexpr (Sink::reports) {
+          sink(j - m);
+          if (sink.full(matches))
+            return matches;
+        }
+      }
+    }
+  }
+
+  return matches;
+}
+
 /*
   Perform the Shift-Or algorithm on the given pattern of length m, against
-  the sequence of length n.
+  the sequence of length n, reporting each match to `sink` (see `run.hpp`).
 */
-int shift_or(std::vector<PatternData> const &pat_data,
-             std::string const &sequence) {
+template <typename Sink>
+static int shift_or_search(ShiftOrPattern const &pat_data,
+                           std::string_view sequence, Sink sink) {
   WORD_TYPE state;
   int matches = 0;
   int j;
 
-  // Unpack pat_data:
-  WORD_TYPE lim = std::get<WORD_TYPE>(pat_data[0]);
-  auto const &s_positions = std::get<std::vector<WORD_TYPE>>(pat_data[1]);
+  WORD_TYPE lim = pat_data.lim;
+  auto const &s_positions = pat_data.s_positions;
+  int words = pat_data.words;
 
-  // Get the size of the sequence. Pattern size is not needed here.
+  if (words > 1)
+    return shift_or_multi_word(lim, s_positions, words, sequence, sink);
+
+  // Get the size of the sequence. The pattern size is only needed for the
+  // offsets of the matches, which are found at their last character.
   int n = sequence.length();
+  int m = __builtin_popcountl(~lim) + 1;
 
   /* Searching */
   for (state = ~0, j = 0; j < n; ++j) {
     state = (state << 1) | s_positions[sequence[j]];
+    if (state < lim) {
+      matches++;
+      if constexpr (Sink::reports) {
+        sink(j - m + 1);
+        if (sink.full(matches))
+          break;
+      }
+    }
+  }
+
+  return matches;
+}
+
+int shift_or(ShiftOrPattern const &pat_data, std::string_view sequence) {
+  return shift_or_search(pat_data, sequence, CountOnly{});
+}
+
+int shift_or_locate(ShiftOrPattern const &pat_data, std::string_view sequence,
+                    HitSink sink) {
+  return shift_or_search(pat_data, sequence, sink);
+}
+
+/*
+  The single-word search again, specialized for a pattern length M known at
+  compile time (see `FixedLengths` in `run.hpp`). `lim` is a constant, and the
+  table is read through a pointer to the (single-word) aligned table.
+*/
+template <int M>
+int shift_or_fixed(ShiftOrPattern const &pat_data, std::string_view sequence) {
+  static_assert(M <= WORD, "fixed-length patterns must fit in a word");
+  constexpr WORD_TYPE lim = ~(((WORD_TYPE)1 << (M - 1)) - 1);
+  WORD_TYPE const *s_positions = pat_data.s_positions.data();
+
+  WORD_TYPE state = ~0;
+  int matches = 0;
+  int n = sequence.length();
+
+  for (int j = 0; j < n; ++j) {
+    state = (state << 1) | s_positions[(int)sequence[j]];
     if (state < lim)
       matches++;
   }
@@ -97,13 +234,28 @@ int shift_or(std::vector<PatternData> const &pat_data,
   return matches;
 }
 
+/*
+  Return the specialized search for patterns of length m, if there is one.
+*/
+algorithm<ShiftOrPattern> specialize_shift_or(int m) {
+  return select_fixed(
+      m,
+      [](auto M) -> algorithm<ShiftOrPattern> {
+        return &shift_or_fixed<decltype(M)::value>;
+      },
+      FixedLengths{});
+}
+
 /*
   All that is done here is call the run() function with a pointer to the
   algorithm implementation, the label for the algorithm, and the argc/argv
-  values.
+  values. The data is asked for in the DNA encoding, and the specialized
+  searches are used for the lengths that have them. The locating search is
+  used for `--positions`.
 */
 int main(int argc, char *argv[]) {
-  int return_code = run(&init_shift_or, &shift_or, "shift_or", argc, argv);
+  int return_code = run(&init_shift_or, &shift_or, "shift_or", argc, argv,
+                        Encoding::dna, &specialize_shift_or, &shift_or_locate);
 
   return return_code;
 }
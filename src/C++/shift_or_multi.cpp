@@ -0,0 +1,256 @@
+/*
+  Implementation of a multi-pattern, bit-parallel variant of the Shift-Or
+  (Bitap) algorithm.
+
+  The single-pattern Shift-Or in `shift_or.cpp` keeps one pattern in one
+  machine word. Here the patterns are packed side-by-side into 64-bit words
+  (as many as fit in each), and the words are grouped into SIMD vectors of
+  LANES words each. One pass over a sequence then advances every pattern in a
+  group at once. The only change to the usual update is that the bit carried
+  into the first position of each pattern, from the last position of the
+  pattern below it, has to be masked off:
+
+    D = ((D << 1) & ~first) | T[c]
+
+  and pattern p has matched when the bit of its last position in D is 0.
+
+  This is a runner for `run_multi`, so its results have the same shape as
+  those of Aho-Corasick.
+*/
+
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include "run.hpp"
+
+// The runner encodes the DNA alphabet as 0-3 (see `alphabet.hpp`).
+constexpr int ASIZE = DNA_ASIZE;
+
+// The patterns are packed into 64-bit words, so no single pattern can be
+// longer than that.
+constexpr int WORD = 64;
+typedef unsigned long WORD_TYPE;
+
+// The number of words advanced by each vector operation. This follows the
+// widest vector unit the compiler has been told it may use (see SIMDFLAGS in
+// the Makefile). The GCC/Clang vector extensions keep the code itself the same
+// for every width.
+#if defined(__AVX512F__)
+constexpr int LANES = 8;
+#elif defined(__AVX2__)
+constexpr int LANES = 4;
+#else
+constexpr int LANES = 2;
+#endif
+typedef WORD_TYPE lanes_t
+    __attribute__((vector_size(LANES * sizeof(WORD_TYPE))));
+
+/*
+  The preprocessed form of the set of patterns (see init_shift_or_multi()).
+  Each table starts on a cache line, and each group's part of `masks`, `first`
+  and `last` is a whole number of vectors, so no group's loads straddle more
+  lines than they have to.
+*/
+struct alignas(CACHE_LINE) ShiftOrMultiPattern {
+  int patterns_count = 0;
+  int groups = 0;
+  AlignedArray<WORD_TYPE> masks;
+  AlignedArray<WORD_TYPE> first;
+  AlignedArray<WORD_TYPE> last;
+  AlignedArray<int> owner;
+
+  // The tables are interleaved by lane, so a cache is only good for builds
+  // with the same LANES (see pattern_layout()).
+  static constexpr int LAYOUT = LANES;
+
+  template <typename Archive> void fields(Archive &archive) {
+    archive(patterns_count, groups, masks, first, last, owner);
+  }
+};
+
+/*
+  Test whether any bit of any lane of `v` is set.
+*/
+static inline bool any_set(lanes_t v) {
+#if defined(__AVX512F__)
+  return _mm512_test_epi64_mask((__m512i)v, (__m512i)v) != 0;
+#elif defined(__AVX2__)
+  return !_mm256_testz_si256((__m256i)v, (__m256i)v);
+#else
+  WORD_TYPE any = 0;
+  for (int l = 0; l < LANES; l++)
+    any |= v[l];
+  return any != 0;
+#endif
+}
+
+/*
+  Load LANES consecutive words from `words`, with no alignment requirement.
+*/
+static inline lanes_t load(WORD_TYPE const *words) {
+  lanes_t v;
+  std::memcpy(&v, words, sizeof(v));
+  return v;
+}
+
+/*
+  Initialize the structure for the multi-pattern Shift-Or. The patterns are
+  packed into words in order, starting a new word whenever the next pattern
+  will not fit in the current one. For each group of LANES words this builds:
+
+    * T[c]: the Shift-Or mask of every character c, 0 where the pattern has c
+    * first: the bit of the first position of each pattern
+    * last: the bit of the last position of each pattern
+
+  plus a table mapping each last-position bit back to its pattern. The return
+  value is the preprocessed set of patterns.
+*/
+ShiftOrMultiPattern
+init_shift_or_multi(std::vector<std::string> const &patterns_data) {
+  int patterns_count = patterns_data.size();
+
+  // First, assign each pattern a word and a starting bit.
+  std::vector<int> word_of(patterns_count), offset_of(patterns_count);
+  int words = 0, used = WORD;
+  for (int p = 0; p < patterns_count; p++) {
+    int m = patterns_data[p].length();
+    if (m < 1 || m > WORD) {
+      std::ostringstream error;
+      error << "shift_or_multi: pattern size must be 1.." << WORD;
+      throw std::runtime_error{error.str()};
+    }
+    if (used + m > WORD) {
+      words++;
+      used = 0;
+    }
+    word_of[p] = words - 1;
+    offset_of[p] = used;
+    used += m;
+  }
+
+  // Round up to whole groups. Padding words never match: their masks are all
+  // ones and they have no last-position bits.
+  int groups = (words + LANES - 1) / LANES;
+  int padded = groups * LANES;
+  ShiftOrMultiPattern return_val;
+  return_val.patterns_count = patterns_count;
+  return_val.groups = groups;
+  return_val.masks = AlignedArray<WORD_TYPE>(padded * ASIZE, ~(WORD_TYPE)0);
+  return_val.first = AlignedArray<WORD_TYPE>(padded, 0);
+  return_val.last = AlignedArray<WORD_TYPE>(padded, 0);
+  return_val.owner = AlignedArray<int>(padded * WORD, -1);
+  auto &masks = return_val.masks;
+  auto &first = return_val.first;
+  auto &last = return_val.last;
+  auto &owner = return_val.owner;
+
+  for (int p = 0; p < patterns_count; p++) {
+    std::string const &pat = patterns_data[p];
+    int m = pat.length();
+    int w = word_of[p], group = w / LANES, lane = w % LANES;
+
+    for (int i = 0; i < m; i++) {
+      WORD_TYPE bit = (WORD_TYPE)1 << (offset_of[p] + i);
+      masks[(group * ASIZE + pat[i]) * LANES + lane] &= ~bit;
+    }
+    first[w] |= (WORD_TYPE)1 << offset_of[p];
+    last[w] |= (WORD_TYPE)1 << (offset_of[p] + m - 1);
+    owner[w * WORD + offset_of[p] + m - 1] = p;
+  }
+
+  return return_val;
+}
+
+/*
+  Run the multi-pattern Shift-Or against the given sequence. Each group of
+  words makes its own pass over the sequence, which keeps all of a group's
+  state and masks in registers while the sequence itself stays in L1. Each
+  match is also reported to `sink` (see `run.hpp`), at the offset where it
+  ends.
+*/
+template <typename Sink>
+static void shift_or_multi_search(ShiftOrMultiPattern const &pat_data,
+                                  std::string_view sequence,
+                                  std::vector<int> &matches, Sink sink) {
+  int pattern_count = pat_data.patterns_count;
+  int groups = pat_data.groups;
+  WORD_TYPE const *masks = pat_data.masks.data();
+  WORD_TYPE const *first = pat_data.first.data();
+  WORD_TYPE const *last = pat_data.last.data();
+  int const *owner = pat_data.owner.data();
+
+  int n = sequence.length();
+  matches.assign(pattern_count, 0);
+
+  for (int group = 0; group < groups; group++) {
+    lanes_t t[ASIZE];
+    for (int c = 0; c < ASIZE; c++)
+      t[c] = load(masks + (group * ASIZE + c) * LANES);
+    lanes_t not_first = ~load(first + group * LANES);
+    lanes_t last_bits = load(last + group * LANES);
+    lanes_t state = ~(lanes_t){};
+
+    for (int j = 0; j < n; j++) {
+      state = ((state << 1) & not_first) | t[(int)sequence[j]];
+
+      lanes_t hits = ~state & last_bits;
+      if (any_set(hits)) {
+        for (int lane = 0; lane < LANES; lane++) {
+          WORD_TYPE bits = hits[lane];
+          int const *lane_owner = owner + (group * LANES + lane) * WORD;
+          while (bits) {
+            int bit = __builtin_ctzl(bits);
+            int pattern = lane_owner[bit];
+            bits &= bits - 1;
+            matches[pattern]++;
+            if constexpr (Sink::reports) {
+              sink(pattern, j);
+              // As in aho_corasick(), a full pattern stops being counted:
+              // its end bit is taken out of the group's.
+              if (sink.full(matches[pattern]))
+                last_bits[lane] &= ~((WORD_TYPE)1 << bit);
+            }
+          }
+        }
+        // The group's pass is over once all of its patterns are full.
+        if constexpr (Sink::reports)
+          if (!any_set(last_bits))
+            break;
+      }
+    }
+  }
+
+  return;
+}
+
+void shift_or_multi(ShiftOrMultiPattern const &pat_data,
+                    std::string_view sequence, std::vector<int> &matches) {
+  shift_or_multi_search(pat_data, sequence, matches, CountOnly{});
+}
+
+void shift_or_multi_locate(ShiftOrMultiPattern const &pat_data,
+                           std::string_view sequence,
+                           std::vector<int> &matches, HitSink sink) {
+  shift_or_multi_search(pat_data, sequence, matches, sink);
+}
+
+/*
+  All that is done here is call the run_multi() function with the argc/argv
+  values, asking for the data in the DNA encoding, and with the locating
+  search for `--positions`.
+*/
+int main(int argc, char *argv[]) {
+  int return_code =
+      run_multi(&init_shift_or_multi, &shift_or_multi, "shift_or_multi", argc,
+                argv, Encoding::dna, &shift_or_multi_locate);
+
+  return return_code;
+}
@@ -0,0 +1,88 @@
+/*
+  Shift-Or (see `shift_or.cpp`) as a batch matcher, matching every pattern
+  against every sequence at once on an offload device (see `sycl_batch.hpp`).
+
+  A work-item keeps the state of its pattern in registers, as up to MAX_WORDS
+  words with the shift carrying from each into the next, as the multi-word
+  search of `shift_or.cpp` does. Unlike that search, every word is updated on
+  every character, so that the work-items of a pattern stay in step with each
+  other.
+*/
+
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "sycl_batch.hpp"
+
+// The runner encodes the DNA alphabet as 0-3 (see `alphabet.hpp`), so there
+// are four masks per word of a pattern.
+constexpr int ASIZE = DNA_ASIZE;
+
+// The bits in a word, and the most words that a pattern may take.
+constexpr int WORD = 64;
+constexpr int MAX_WORDS = 8;
+
+struct ShiftOrSycl {
+  using Word = std::uint64_t;
+
+  /*
+    The masks of the positions of each character in the pattern, as in
+    calc_s_positions_multi(): `words` words for each character, with bit i of
+    the pattern in word i / WORD, 0 where the pattern has the character.
+  */
+  static void prepare(std::string const &pattern, int,
+                      std::vector<Word> &table) {
+    int m = pattern.length();
+    int words = (m + WORD - 1) / WORD;
+    if (m < 1 || words > MAX_WORDS) {
+      std::ostringstream error;
+      error << "shift_or_sycl: pattern size must be from 1 to "
+            << MAX_WORDS * WORD;
+      throw std::runtime_error{error.str()};
+    }
+
+    std::size_t base = table.size();
+    table.resize(base + ASIZE * words, ~(Word)0);
+    for (int i = 0; i < m; i++)
+      table[base + pattern[i] * words + i / WORD] &= ~((Word)1 << (i % WORD));
+  }
+
+  static int count(Word const *table, int m, int, char const *sequence,
+                   int n) {
+    int words = (m + WORD - 1) / WORD;
+    Word last_bit = (Word)1 << ((m - 1) % WORD);
+    Word state[MAX_WORDS];
+    int matches = 0;
+
+    for (int w = 0; w < words; w++)
+      state[w] = ~(Word)0;
+    for (int j = 0; j < n; j++) {
+      Word const *masks = table + sequence[j] * words;
+      Word carry = 0;
+      for (int w = 0; w < words; w++) {
+        Word high = state[w] >> (WORD - 1);
+        state[w] = (state[w] << 1 | carry) | masks[w];
+        carry = high;
+      }
+      if (!(state[words - 1] & last_bit))
+        matches++;
+    }
+
+    return matches;
+  }
+};
+
+/*
+  All that is done here is call the batch runner with the argc/argv values,
+  asking for the data in the DNA encoding.
+*/
+int main(int argc, char *argv[]) {
+  SyclBatchMatcher<ShiftOrSycl> matcher;
+  int return_code = run_batch_matcher(matcher, "shift_or_sycl", argc, argv,
+                                      Encoding::dna, false);
+
+  return return_code;
+}
@@ -0,0 +1,66 @@
+/*
+  Header file for the SIMD candidate filter used by the `*_simd` variants of
+  the single-pattern algorithms.
+
+  A match of a pattern of length m at position p needs sequence[p] to be the
+  first character of the pattern and sequence[p + m - 1] to be the last. The
+  filter compares both of those against a whole vector of positions at a time
+  (32 with AVX2, 64 with AVX-512BW) and returns the first position where both
+  agree. The algorithm then only has to verify that candidate, and can ask for
+  the next one whenever it has no partial match in progress.
+*/
+
+#ifndef _SIMD_FILTER_HPP
+#define _SIMD_FILTER_HPP
+
+#include <cstdint>
+#include <string_view>
+
+#if defined(__AVX2__) || defined(__AVX512BW__)
+#include <immintrin.h>
+#endif
+
+/*
+  Return the first position p >= `from` at which a pattern of length `m` that
+  starts with `first` and ends with `last` could match `sequence`. If there is
+  none, the return value is the first position at which the pattern no longer
+  fits (n - m + 1).
+*/
+inline int next_candidate(std::string_view sequence, int from, int m,
+                          char first, char last) {
+  char const *data = sequence.data();
+  int end = (int)sequence.length() - m + 1;
+
+#if defined(__AVX512BW__)
+  __m512i first_v = _mm512_set1_epi8(first);
+  __m512i last_v = _mm512_set1_epi8(last);
+  for (; from + 64 <= end; from += 64) {
+    __m512i head = _mm512_loadu_si512(data + from);
+    __m512i tail = _mm512_loadu_si512(data + from + m - 1);
+    std::uint64_t mask = _mm512_cmpeq_epi8_mask(head, first_v) &
+                         _mm512_cmpeq_epi8_mask(tail, last_v);
+    if (mask)
+      return from + __builtin_ctzll(mask);
+  }
+#elif defined(__AVX2__)
+  __m256i first_v = _mm256_set1_epi8(first);
+  __m256i last_v = _mm256_set1_epi8(last);
+  for (; from + 32 <= end; from += 32) {
+    __m256i head = _mm256_loadu_si256((__m256i const *)(data + from));
+    __m256i tail = _mm256_loadu_si256((__m256i const *)(data + from + m - 1));
+    std::uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(
+        _mm256_cmpeq_epi8(head, first_v), _mm256_cmpeq_epi8(tail, last_v)));
+    if (mask)
+      return from + __builtin_ctz(mask);
+  }
+#endif
+
+  // Whatever is left over (or everything, without SIMD support):
+  for (; from < end; from++)
+    if (data[from] == first && data[from + m - 1] == last)
+      return from;
+
+  return end < from ? from : end;
+}
+
+#endif // !_SIMD_FILTER_HPP
@@ -0,0 +1,168 @@
+/*
+  Header file for the SYCL batch matchers (see BatchMatcher in `run.hpp`),
+  which the `*_sycl` programs build for the algorithm they run.
+
+  The sequences are copied to the device once, as a single block of data with
+  the offset of each sequence in it. The patterns are preprocessed on the
+  host, into one table for all of them, and copied over. The matching is then
+  a single kernel over the whole pattern/sequence matrix, with a work-item
+  for each pair. Work-items next to each other take the same pattern against
+  consecutive sequences, so that they read the same part of the table.
+
+  An algorithm is given as a struct with:
+
+    * `Word`, the type of the items of its table
+    * `static void prepare(std::string const &pattern, int k,
+      std::vector<Word> &table)`, which appends the part of the table for
+      `pattern` on the host
+    * `static int count(Word const *table, int m, int k, char const *sequence,
+      int n)`, which counts the matches of the pattern of length m (with its
+      part of the table) in the sequence of length n, on the device
+
+  The device is SYCL's default, which the `ONEAPI_DEVICE_SELECTOR` environment
+  variable chooses (a GPU if there is one, otherwise the host's CPU).
+*/
+
+#ifndef _SYCL_BATCH_HPP
+#define _SYCL_BATCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+
+#include "input.hpp"
+#include "run.hpp"
+
+/*
+  An array in the memory of the device of `queue`, which is freed with it.
+  Its storage is only reallocated when it has to grow.
+*/
+template <typename T> class DeviceArray {
+public:
+  explicit DeviceArray(sycl::queue &queue) : queue(queue) {}
+  ~DeviceArray() { release(); }
+
+  DeviceArray(DeviceArray const &) = delete;
+  DeviceArray &operator=(DeviceArray const &) = delete;
+
+  T *data() const { return items; }
+
+  // Make room for `count` items. The contents are not kept.
+  void resize(std::size_t count) {
+    if (count > capacity) {
+      release();
+      items = sycl::malloc_device<T>(count, queue);
+      if (!items)
+        throw std::bad_alloc{};
+      capacity = count;
+    }
+  }
+  // Replace the contents with a copy of `values`.
+  void assign(std::vector<T> const &values) {
+    resize(values.size());
+    if (!values.empty())
+      queue.memcpy(items, values.data(), values.size() * sizeof(T)).wait();
+  }
+
+private:
+  void release() {
+    if (items)
+      sycl::free(items, queue);
+    items = nullptr;
+    capacity = 0;
+  }
+
+  sycl::queue &queue;
+  T *items = nullptr;
+  std::size_t capacity = 0;
+};
+
+/*
+  The BatchMatcher for an algorithm, as described above.
+*/
+template <typename Algorithm> class SyclBatchMatcher : public BatchMatcher {
+public:
+  using Word = typename Algorithm::Word;
+
+  SyclBatchMatcher()
+      : data(queue), offsets(queue), tables(queue), table_offsets(queue),
+        lengths(queue), results(queue) {}
+
+  void load(SequenceStore const &sequences) override {
+    std::vector<char> block;
+    std::vector<std::uint64_t> starts{0};
+    for (std::string_view sequence : sequences) {
+      block.insert(block.end(), sequence.begin(), sequence.end());
+      starts.push_back(block.size());
+    }
+    data.assign(block);
+    offsets.assign(starts);
+    sequences_count = sequences.size();
+  }
+
+  void prepare(std::vector<std::string> const &patterns, int k) override {
+    std::vector<Word> table;
+    std::vector<std::uint64_t> starts;
+    std::vector<int> ms;
+    for (std::string const &pattern : patterns) {
+      starts.push_back(table.size());
+      ms.push_back(pattern.length());
+      Algorithm::prepare(pattern, k, table);
+    }
+    tables.assign(table);
+    table_offsets.assign(starts);
+    lengths.assign(ms);
+    results.resize(patterns.size() * sequences_count);
+    patterns_count = patterns.size();
+    this->k = k;
+  }
+
+  void match(std::vector<int> &counts) override {
+    std::size_t rows = patterns_count, columns = sequences_count;
+    counts.resize(rows * columns);
+    if (counts.empty())
+      return;
+
+    // The kernel takes copies of these, rather than of the matcher.
+    char const *sequences = data.data();
+    std::uint64_t const *starts = offsets.data();
+    Word const *table = tables.data();
+    std::uint64_t const *table_starts = table_offsets.data();
+    int const *ms = lengths.data();
+    int *out = results.data();
+    int k = this->k;
+    queue
+        .parallel_for(sycl::range<2>(rows, columns),
+                      [=](sycl::item<2> item) {
+                        std::size_t p = item[0], s = item[1];
+                        out[p * columns + s] = Algorithm::count(
+                            table + table_starts[p], ms[p], k,
+                            sequences + starts[s], starts[s + 1] - starts[s]);
+                      })
+        .wait();
+    queue.memcpy(counts.data(), out, counts.size() * sizeof(int)).wait();
+  }
+
+  std::string device() const override {
+    return queue.get_device().get_info<sycl::info::device::name>();
+  }
+
+private:
+  sycl::queue queue;
+  DeviceArray<char> data;
+  DeviceArray<std::uint64_t> offsets;
+  DeviceArray<Word> tables;
+  DeviceArray<std::uint64_t> table_offsets;
+  DeviceArray<int> lengths;
+  DeviceArray<int> results;
+  std::size_t sequences_count = 0;
+  std::size_t patterns_count = 0;
+  int k = -1;
+};
+
+#endif // !_SYCL_BATCH_HPP
@@ -30,19 +30,19 @@ define RUN_test_approx_experiment
 endef
 
 define RUN_experiment
-@$(HARNESS) -v -n $(RUNCOUNT) -f $(EXPERIMENTS_FILE) $(1) $(SEQUENCES) $(PATTERNS) $(ANSWERS)
+@$(HARNESS) $(HARNESS_OPTS) -v -n $(RUNCOUNT) -f $(EXPERIMENTS_FILE) $(1) $(SEQUENCES) $(PATTERNS) $(ANSWERS)
 
 endef
 define RUN_long_experiment
-@$(HARNESS) -v -s -n $(LONG_RUNCOUNT) -f $(EXPERIMENTS_FILE) $(1) $(SEQUENCES) $(PATTERNS) $(ANSWERS)
+@$(HARNESS) $(HARNESS_OPTS) -v -s -n $(LONG_RUNCOUNT) -f $(EXPERIMENTS_FILE) $(1) $(SEQUENCES) $(PATTERNS) $(ANSWERS)
 
 endef
 define RUN_approx_experiment
-@$(HARNESS) -v -s -n $(APPROX_RUNCOUNT) -f $(EXPERIMENTS_FILE) $(1) $(2) $(SEQUENCES) $(PATTERNS) $(APPROX_ANSWERS)
+@$(HARNESS) $(HARNESS_OPTS) -v -s -n $(APPROX_RUNCOUNT) -f $(EXPERIMENTS_FILE) $(1) $(2) $(SEQUENCES) $(PATTERNS) $(APPROX_ANSWERS)
 
 endef
 define RUN_long_approx_experiment
-@$(HARNESS) -v -s -n $(APPROX_LONG_RUNCOUNT) -f $(EXPERIMENTS_FILE) $(1) $(2) $(SEQUENCES) $(PATTERNS) $(APPROX_ANSWERS)
+@$(HARNESS) $(HARNESS_OPTS) -v -s -n $(APPROX_LONG_RUNCOUNT) -f $(EXPERIMENTS_FILE) $(1) $(2) $(SEQUENCES) $(PATTERNS) $(APPROX_ANSWERS)
 
 endef
 
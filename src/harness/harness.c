@@ -3,11 +3,15 @@
   https://github.com/greensoftwarelab/Energy-Languages
  */
 
+#define _GNU_SOURCE
+
 #include <getopt.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "rapl.h"
@@ -20,8 +24,40 @@
  */
 #include "subprocess.h"
 
+/* The core whose MSRs are read, unless `-c` names others. */
 const int CORE = 0;
 
+/* The most cores that `-c` may list. */
+#define MAX_CORES 256
+
+/*
+  A package (socket) that experiments run on in the parallel mode: the core
+  that its energy counters are read through (the first of its cores that was
+  listed), the last reading of them, and the number of experiments running on
+  it since then.
+ */
+struct package_s {
+  int id;
+  int core;
+  struct rapl_reading last;
+  int running;
+};
+
+/*
+  An iteration running in the parallel mode, on the core `core` of the package
+  `package`, the energy it has been given so far, and the most iterations (its
+  own included) that have shared the package with it at once so far.
+ */
+struct job_s {
+  struct subprocess_s process;
+  int iteration;
+  int core;
+  struct package_s *package;
+  double start_time;
+  struct rapl_energy energy;
+  int most_running;
+};
+
 /*
   Simple measure of the wall-clock down to the usec. Adapted from StackOverflow.
 */
@@ -31,13 +67,248 @@ double get_time() {
   return t.tv_sec + t.tv_usec * 1e-6;
 }
 
+/*
+  Parse a list of cores such as "0,2,4-7" into `cores`, returning the number
+  of them, or -1 if the list is malformed.
+ */
+int parse_cores(const char *list, int *cores) {
+  int count = 0;
+  const char *p = list;
+
+  while (*p) {
+    char *end;
+    long first = strtol(p, &end, 10), last;
+    if (end == p || first < 0)
+      return -1;
+    last = first;
+    if (*end == '-') {
+      p = end + 1;
+      last = strtol(p, &end, 10);
+      if (end == p || last < first)
+        return -1;
+    }
+    for (long core = first; core <= last; core++) {
+      if (count == MAX_CORES)
+        return -1;
+      cores[count++] = core;
+    }
+    if (*end == ',')
+      end++;
+    else if (*end)
+      return -1;
+    p = end;
+  }
+
+  return count;
+}
+
+/*
+  The package that `core` is on, from sysfs (0 if it can't be read).
+ */
+int package_of(int core) {
+  char filename[80];
+  int package = 0;
+  FILE *file;
+
+  sprintf(filename,
+          "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", core);
+  file = fopen(filename, "r");
+  if (file) {
+    if (fscanf(file, "%d", &package) != 1)
+      package = 0;
+    fclose(file);
+  }
+
+  return package;
+}
+
+/*
+  Pin the calling process (and so the processes it starts from now on) to
+  `core`.
+ */
+void pin_to_core(int core) {
+  cpu_set_t set;
+
+  CPU_ZERO(&set);
+  CPU_SET(core, &set);
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+    perror("harness: sched_setaffinity");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*
+  Write the record for one iteration, less its energy readings: the iteration
+  number, success, the runtime and the program's output.
+ */
+void write_record(FILE *file, struct subprocess_s *process, int iteration,
+                  int ret, double runtime) {
+  char line[80];
+
+  fprintf(file, "---\n");
+  fprintf(file, "iteration: %d\n", iteration);
+  fprintf(file, "success: %s\n", ret == 0 ? "true" : "false");
+  fprintf(file, "total_runtime: %.8g\n", runtime);
+
+  // Capture the stdout of the process.
+  FILE *stdout_file = subprocess_stdout(process);
+  while (fgets(line, 80, stdout_file) != NULL)
+    fputs(line, file);
+
+  // Capture the stderr and add it.
+  FILE *stderr_file = subprocess_stderr(process);
+  while (fgets(line, 80, stderr_file) != NULL) {
+    if (strstr(line, "max_memory: "))
+      fputs(line, file);
+  }
+}
+
+/*
+  Share out the energy that each package has used since its last reading
+  between the experiments running on it, evenly. This is called whenever an
+  experiment starts or ends, so that over each stretch of time between those
+  the set of experiments on a package does not change. The most experiments
+  each one has shared its package with are counted here too.
+ */
+void share_energy(struct package_s *packages, int package_count,
+                  struct job_s *jobs, int job_count) {
+  for (int p = 0; p < package_count; p++) {
+    struct package_s *package = &packages[p];
+    struct rapl_reading now;
+    struct rapl_energy used = {0, 0, 0};
+
+    // The count of those sharing the package is kept even without readings.
+    for (int j = 0; j < job_count; j++)
+      if (jobs[j].process.child && jobs[j].package == package &&
+          package->running > jobs[j].most_running)
+        jobs[j].most_running = package->running;
+    if (rapl_read(package->core, &now) != 0)
+      continue;
+    if (package->running) {
+      rapl_add_energy(&used, &package->last, &now);
+      for (int j = 0; j < job_count; j++)
+        if (jobs[j].process.child && jobs[j].package == package) {
+          jobs[j].energy.package += used.package / package->running;
+          jobs[j].energy.pp0 += used.pp0 / package->running;
+          jobs[j].energy.dram += used.dram / package->running;
+        }
+    }
+    package->last = now;
+  }
+}
+
+/*
+  The parallel mode: run the iterations from `first` to `last`, as many at a
+  time as there are `cores`, each pinned to a core of its own. An iteration
+  is started on a core as soon as the one before it there ends. The energy of
+  an iteration is its share of its package's (see share_energy()), so it is
+  only its own when it has the package to itself; the records give the most
+  that shared its package at once while it ran, as `concurrent`. Iteration 0
+  (see `-s`) is run by itself first, as the warm-up it is in the serial mode,
+  and the last ones run with fewer at once as the cores free up.
+ */
+void run_parallel(char **exec_argv, FILE *file, int first, int last,
+                  int *cores, int core_count, int verbose) {
+  struct package_s packages[MAX_CORES];
+  struct job_s *jobs = calloc(core_count, sizeof(struct job_s));
+  int package_count = 0, running = 0, next = first, warming_up = 0;
+  cpu_set_t own;
+
+  // Find the packages of the cores, and start their readings.
+  for (int c = 0; c < core_count; c++) {
+    int id = package_of(cores[c]), p;
+    for (p = 0; p < package_count; p++)
+      if (packages[p].id == id)
+        break;
+    if (p == package_count) {
+      packages[p].id = id;
+      packages[p].core = cores[c];
+      packages[p].running = 0;
+      rapl_read(cores[c], &packages[p].last);
+      package_count++;
+    }
+    jobs[c].core = cores[c];
+    jobs[c].package = &packages[p];
+  }
+  sched_getaffinity(0, sizeof(own), &own);
+
+  while (next <= last || running) {
+    // Start an iteration on each free core, unless the warm-up is running.
+    for (int c = 0; c < core_count && next <= last && !warming_up; c++) {
+      if (jobs[c].process.child)
+        continue;
+
+      if (verbose)
+        fprintf(stdout, "  Iteration %d/%d on core %d\n", next, last,
+                cores[c]);
+      share_energy(packages, package_count, jobs, core_count);
+      memset(&jobs[c].energy, 0, sizeof(jobs[c].energy));
+      jobs[c].most_running = 0;
+      jobs[c].iteration = next++;
+      jobs[c].start_time = get_time();
+      pin_to_core(cores[c]);
+      int result = subprocess_create((const char *const *)exec_argv, 0,
+                                     &jobs[c].process);
+      sched_setaffinity(0, sizeof(own), &own);
+      if (0 != result) {
+        fprintf(stderr, "harness: Error creating subprocess: %d\n", result);
+        exit(EXIT_FAILURE);
+      }
+      jobs[c].package->running++;
+      running++;
+      warming_up = jobs[c].iteration == 0;
+    }
+
+    // Wait for one of them to end, and write its record.
+    int status;
+    pid_t pid = waitpid(-1, &status, 0);
+    if (pid == -1) {
+      perror("harness: waitpid");
+      exit(EXIT_FAILURE);
+    }
+    double end_time = get_time();
+    share_energy(packages, package_count, jobs, core_count);
+    for (int c = 0; c < core_count; c++) {
+      struct job_s *job = &jobs[c];
+      int ret;
+      if (job->process.child != pid)
+        continue;
+
+      // The process has been waited on here, so subprocess_join() only
+      // closes it and hands back the status recorded here.
+      job->process.child = 0;
+      job->process.return_status =
+          WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE;
+      subprocess_join(&job->process, &ret);
+      job->package->running--;
+      running--;
+      warming_up = 0;
+
+      if (job->iteration != 0) {
+        write_record(file, &job->process, job->iteration, ret,
+                     end_time - job->start_time);
+        fprintf(file, "core: %d\n", job->core);
+        fprintf(file, "concurrent: %d\n", job->most_running);
+        fprintf(file, "package: %.14f\n", job->energy.package);
+        fprintf(file, "pp0: %.14f\n", job->energy.pp0);
+        if (dram_avail)
+          fprintf(file, "dram: %.14f\n", job->energy.dram);
+        fflush(file);
+      }
+      subprocess_destroy(&job->process);
+    }
+  }
+
+  free(jobs);
+}
+
 int main(int argc, char **argv) {
   int opt, run_count = 10, show_info = 0, verbose = 0, skip0 = 0;
+  int jobs = 1, core_count = 0, cores[MAX_CORES];
   char *output_file = (char *)calloc(256, sizeof(char));
-  char **exec_argv = (char **)calloc(12, sizeof(char *));
   FILE *file;
 
-  while ((opt = getopt(argc, argv, "vin:f:s")) != -1) {
+  while ((opt = getopt(argc, argv, "vin:f:sj:c:")) != -1) {
     switch (opt) {
     case 'i':
       show_info = 1;
@@ -54,20 +325,44 @@ int main(int argc, char **argv) {
     case 's':
       skip0 = 1;
       break;
+    case 'j':
+      jobs = atoi(optarg);
+      break;
+    case 'c':
+      core_count = parse_cores(optarg, cores);
+      if (core_count < 1) {
+        fprintf(stderr, "%s: bad list of cores '%s'\n", argv[0], optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
     default:
-      fprintf(
-          stderr,
-          "Usage: %s [ -v ] [ -i ] [ -s ] [ -n count ] [ -f output ] <files>\n",
-          argv[0]);
+      fprintf(stderr,
+              "Usage: %s [ -v ] [ -i ] [ -s ] [ -n count ] [ -f output ] "
+              "[ -j jobs ] [ -c cores ] <files>\n",
+              argv[0]);
       exit(EXIT_FAILURE);
     }
   }
   // Default output_file if it wasn't given:
   if (output_file[0] == '\0')
     strcpy(output_file, "experiments_data.yml");
+  // The parallel mode needs a core for each job, 0 onwards by default.
+  if (jobs < 1 || (core_count && jobs > core_count)) {
+    fprintf(stderr, "%s: -j must be from 1 to the number of cores given\n",
+            argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (!core_count && jobs > 1) {
+    for (int c = 0; c < jobs; c++)
+      cores[c] = c;
+    core_count = jobs;
+  }
 
   // Make sure there are enough arguments still in argv:
   int remaining = argc - optind;
+  // Room for /bin/time and its two arguments, the program and its arguments
+  // (options such as `--mode` included), and the terminating NULL:
+  char **exec_argv = (char **)calloc(remaining + 4, sizeof(char *));
   if (!show_info && remaining < 3) {
     fprintf(stderr, "Wrong number of arguments (%d) given to %s\n", remaining,
             argv[0]);
@@ -87,12 +382,15 @@ int main(int argc, char **argv) {
     }
   }
 
-  rapl_init(CORE, show_info);
+  // The serial mode reads the energy through the core it runs on, if it was
+  // given one.
+  int rapl_core = core_count ? cores[0] : CORE;
+  rapl_init(rapl_core, show_info);
 
   // If the user passed -i, just show some CPU/core info and exit.
   if (show_info) {
-    show_power_info(CORE);
-    show_power_limit(CORE);
+    show_power_info(rapl_core);
+    show_power_limit(rapl_core);
     exit(EXIT_SUCCESS);
   }
 
@@ -101,15 +399,27 @@ int main(int argc, char **argv) {
     fprintf(stdout, "Starting run of %d iterations of %s\n",
             run_count + 1 - skip0, argv[optind]);
 
+  if (jobs > 1) {
+    run_parallel(exec_argv, file, skip0, run_count, cores, jobs, verbose);
+    fclose(file);
+    free(output_file);
+    free(exec_argv);
+    return 0;
+  }
+
+  // The serial mode, for the final numbers: one iteration at a time, so that
+  // each has the whole package's energy to itself. With `-c`, it runs on the
+  // first of the cores given.
+  if (core_count)
+    pin_to_core(rapl_core);
   for (int i = skip0; i <= run_count; i++) {
     int result, ret;
     struct subprocess_s process;
-    char *line = (char *)calloc(80, sizeof(char));
 
     if (verbose)
       fprintf(stdout, "  Iteration %d/%d\n", i, run_count);
 
-    rapl_before(CORE);
+    rapl_before(rapl_core);
     double start_time = get_time();
 
     result = subprocess_create((const char *const *)exec_argv, 0, &process);
@@ -126,25 +436,10 @@ int main(int argc, char **argv) {
     if (i != 0) {
       // Note the end time.
       double end_time = get_time();
-      fprintf(file, "---\n");
-      fprintf(file, "iteration: %d\n", i);
-      fprintf(file, "success: %s\n", ret == 0 ? "true" : "false");
-      fprintf(file, "total_runtime: %.8g\n", end_time - start_time);
-
-      // Capture the stdout of the process.
-      FILE *stdout_file = subprocess_stdout(&process);
-      while (fgets(line, 80, stdout_file) != NULL)
-        fputs(line, file);
-
-      // Capture the stderr and add it.
-      FILE *stderr_file = subprocess_stderr(&process);
-      while (fgets(line, 80, stderr_file) != NULL) {
-        if (strstr(line, "max_memory: "))
-          fputs(line, file);
-      }
+      write_record(file, &process, i, ret, end_time - start_time);
 
       // Capture the energy readings.
-      rapl_after(file, CORE);
+      rapl_after(file, rapl_core);
     }
 
     subprocess_destroy(&process);
@@ -426,3 +426,53 @@ void rapl_after(FILE *fp, int core) {
 
   return;
 }
+
+/*
+  The same readings as rapl_before() and rapl_after() take, for a program that
+  keeps them itself (the C++ runners' `--counters` reads them around each
+  phase of a run). Unlike those, this doesn't exit if the MSRs can't be read,
+  but returns -1, so that the caller can go on without the energy readings.
+  rapl_init() must have been called first, for `dram_avail`.
+*/
+int rapl_read(int core, struct rapl_reading *reading) {
+  char msr_filename[32];
+  uint64_t data;
+  int fd, result = 0;
+
+  sprintf(msr_filename, "/dev/cpu/%d/msr", core);
+  fd = open(msr_filename, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  if (pread(fd, &data, sizeof data, MSR_PKG_ENERGY_STATUS) != sizeof data)
+    result = -1;
+  reading->package = (long long)data & ENERGY_MASK;
+  if (pread(fd, &data, sizeof data, MSR_PP0_ENERGY_STATUS) != sizeof data)
+    result = -1;
+  reading->pp0 = (long long)data & ENERGY_MASK;
+  reading->dram = 0;
+  if (dram_avail) {
+    if (pread(fd, &data, sizeof data, MSR_DRAM_ENERGY_STATUS) != sizeof data)
+      result = -1;
+    reading->dram = (long long)data & ENERGY_MASK;
+  }
+
+  close(fd);
+
+  return result;
+}
+
+/*
+  Add the energy used between the readings `before` and `after` to `energy`,
+  in joules, as rapl_after() computes it.
+*/
+void rapl_add_energy(struct rapl_energy *energy,
+                     const struct rapl_reading *before,
+                     const struct rapl_reading *after) {
+  energy->package +=
+      compute_energy(before->package, after->package, cpu_energy_units);
+  energy->pp0 += compute_energy(before->pp0, after->pp0, cpu_energy_units);
+  if (dram_avail)
+    energy->dram +=
+        compute_energy(before->dram, after->dram, dram_energy_units);
+}
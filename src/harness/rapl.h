@@ -6,6 +6,28 @@
 #ifndef _RAPL_H
 #define _RAPL_H
 
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A reading of the energy status registers, for rapl_read(). */
+struct rapl_reading {
+  long long package;
+  long long pp0;
+  long long dram;
+};
+
+/* Energy used, in joules. */
+struct rapl_energy {
+  double package;
+  double pp0;
+  double dram;
+};
+
+extern int dram_avail;
+
 int open_msr(int core);
 long long read_msr(int fd, int which);
 int detect_cpu(void);
@@ -14,5 +36,13 @@ void show_power_info(int core);
 void show_power_limit(int core);
 void rapl_before(int);
 void rapl_after(FILE *, int);
+int rapl_read(int core, struct rapl_reading *reading);
+void rapl_add_energy(struct rapl_energy *energy,
+                     const struct rapl_reading *before,
+                     const struct rapl_reading *after);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif // !_RAPL_H
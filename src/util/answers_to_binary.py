@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+
+# Convert answers files, as written by random_data.py, into the binary answers
+# format that the C++ runners can map straight into memory. The binary file
+# has a 32-byte header followed by the table of counts, one 32-bit integer per
+# pattern/sequence pair, row by row. All values are little-endian. See
+# `AnswersHeader` in ../C++/input.hpp for the layout of the header.
+
+import argparse
+import os
+import struct
+import sys
+from array import array
+
+
+MAGIC = b"ANSWERSB"
+VERSION = 1
+# magic, version, rows, columns, k, and 8 bytes reserved
+HEADER = struct.Struct("<8sIIIi8x")
+
+
+def parse_command_line():
+    parser = argparse.ArgumentParser()
+
+    # Set up the arguments
+    parser.add_argument(
+        "-o",
+        "--output",
+        type=str,
+        help="Name of the file to write (only with a single input file)",
+    )
+    parser.add_argument(
+        "files",
+        nargs="+",
+        help="Answers file(s) to convert",
+    )
+
+    return parser.parse_args()
+
+
+def output_name(name):
+    root, _ = os.path.splitext(name)
+
+    return root + ".bin"
+
+
+def convert(in_name, out_name):
+    with open(in_name, "r") as f:
+        header = [int(value) for value in f.readline().split()]
+        if len(header) < 2:
+            raise ValueError(f"{in_name}: missing header line")
+        rows, columns = header[0], header[1]
+        k = header[2] if len(header) > 2 else -1
+
+        table = array("i")
+        for line in f:
+            line = line.rstrip("\n")
+            values = [int(value) for value in line.split(",") if value != ""]
+            if len(values) != columns:
+                raise ValueError(
+                    f"{in_name}: wrong number of numbers read ({len(values)})"
+                )
+            table.extend(values)
+
+    if len(table) != rows * columns:
+        raise ValueError(f"{in_name}: wrong number of lines read")
+    if sys.byteorder != "little":
+        table.byteswap()
+
+    with open(out_name, "wb") as f:
+        f.write(HEADER.pack(MAGIC, VERSION, rows, columns, k))
+        table.tofile(f)
+
+    print(f"{in_name} -> {out_name} ({rows} x {columns})")
+
+
+def main():
+    args = parse_command_line()
+    if args.output and len(args.files) > 1:
+        sys.exit("--output can only be used with a single input file")
+
+    for name in args.files:
+        convert(name, args.output or output_name(name))
+
+
+if __name__ == "__main__":
+    main()
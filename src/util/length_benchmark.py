@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+
+# Compare exact-matching programs across a range of pattern lengths. For each
+# length, a set of patterns is drawn from the sequences themselves (so that
+# every pattern is findable), the answers are computed, and then each of the
+# programs is run against them. The "runtime" value each program reports is
+# collected and summarized.
+
+import argparse
+import os
+import random
+import subprocess
+import tempfile
+from statistics import mean
+
+import yaml
+
+
+DEFAULT_LENGTHS = "8,16,32,64,128,256"
+DEFAULT_PATTERN_COUNT = 20
+DEFAULT_RUNS = 3
+
+
+def parse_command_line():
+    parser = argparse.ArgumentParser()
+
+    # Set up the arguments
+    parser.add_argument(
+        "-s",
+        "--seed",
+        type=int,
+        help="Random seed to use in pattern selection",
+    )
+    parser.add_argument(
+        "-f",
+        "--sequences",
+        type=str,
+        required=True,
+        dest="file",
+        help="Name of the sequences file to search",
+    )
+    parser.add_argument(
+        "-l",
+        "--lengths",
+        type=str,
+        default=DEFAULT_LENGTHS,
+        help="Pattern lengths to test, comma-separated",
+    )
+    parser.add_argument(
+        "-pc",
+        "--pattern-count",
+        type=int,
+        default=DEFAULT_PATTERN_COUNT,
+        dest="pcount",
+        help="Number of patterns to generate for each length",
+    )
+    parser.add_argument(
+        "-n",
+        "--runs",
+        type=int,
+        default=DEFAULT_RUNS,
+        help="Number of times to run each program for each length",
+    )
+    parser.add_argument(
+        "-o",
+        "--output",
+        type=str,
+        help="Name of a YAML file to write the raw run-times to",
+    )
+    parser.add_argument(
+        "programs",
+        type=str,
+        nargs="+",
+        help="The programs to run",
+    )
+
+    return vars(parser.parse_args())
+
+
+def read_sequences(file):
+    with open(file, "r") as f:
+        count = int(f.readline().split()[0])
+        sequences = [f.readline().rstrip("\n") for _ in range(count)]
+
+    return sequences
+
+
+def count_matches(pattern, sequence):
+    # Count the overlapping occurrences of pattern in sequence.
+    count = 0
+    pos = sequence.find(pattern)
+    while pos != -1:
+        count += 1
+        pos = sequence.find(pattern, pos + 1)
+
+    return count
+
+
+def write_data(sequences, length, pcount, pfile, afile):
+    candidates = [s for s in sequences if len(s) >= length]
+    if not candidates:
+        raise ValueError(f"No sequence is long enough for length {length}")
+
+    patterns = []
+    for _ in range(pcount):
+        source = random.choice(candidates)
+        base = random.randrange(0, len(source) - length + 1)
+        patterns.append(source[base:base + length])
+
+    with open(pfile, "w", newline="\n") as pf:
+        pf.write(f"{pcount} {length}\n")
+        for pattern in patterns:
+            pf.write(pattern + "\n")
+
+    with open(afile, "w", newline="\n") as af:
+        af.write(f"{pcount} {len(sequences)}\n")
+        for pattern in patterns:
+            counts = [count_matches(pattern, s) for s in sequences]
+            af.write(",".join(map(str, counts)) + "\n")
+
+    return
+
+
+def run_program(program, file, pfile, afile):
+    result = subprocess.run(
+        [program, file, pfile, afile], capture_output=True, text=True
+    )
+    if result.returncode != 0:
+        raise RuntimeError(
+            f"{program} exited with {result.returncode}:\n{result.stdout}"
+            f"{result.stderr}"
+        )
+
+    for line in result.stdout.splitlines():
+        key, _, value = line.partition(": ")
+        if key == "runtime":
+            return float(value)
+
+    raise RuntimeError(f"{program} did not report a runtime")
+
+
+def main():
+    args = parse_command_line()
+
+    # Apply a specific seed if given:
+    if args["seed"] is not None:
+        random.seed(args["seed"])
+
+    sequences = read_sequences(args["file"])
+    lengths = list(map(int, args["lengths"].split(",")))
+    programs = args["programs"]
+    results = []
+
+    name_width = max(map(len, map(os.path.basename, programs)))
+    print(f"{'length':>6}  {'program':<{name_width}}  {'min':>10}  {'mean':>10}")
+
+    with tempfile.TemporaryDirectory() as tmp:
+        pfile = os.path.join(tmp, "patterns.txt")
+        afile = os.path.join(tmp, "answers.txt")
+
+        for length in lengths:
+            write_data(sequences, length, args["pcount"], pfile, afile)
+
+            for program in programs:
+                runtimes = [
+                    run_program(program, args["file"], pfile, afile)
+                    for _ in range(args["runs"])
+                ]
+                name = os.path.basename(program)
+                print(
+                    f"{length:>6}  {name:<{name_width}}  "
+                    f"{min(runtimes):>10.6f}  {mean(runtimes):>10.6f}"
+                )
+                results.append(
+                    {"program": name, "length": length, "runtimes": runtimes}
+                )
+
+    if args["output"] is not None:
+        with open(args["output"], "w") as f:
+            yaml.dump(results, f)
+
+    return
+
+
+if __name__ == "__main__":
+    main()
@@ -202,6 +202,9 @@ def validate(data):
             continue
 
         for key in NUMERICAL_KEYS:
+            # Records from a runner's `--bench` mode have no energy readings.
+            if key not in record:
+                continue
             if record[key] < 0.0:
                 # Because the MSRs that are read for energy consumption numbers
                 # roll over at 32 bits, sometimes we get a negative number that
@@ -276,7 +279,13 @@ def analyze_data(data, langs, algos):
             #   6. Any notes about short samples
             for key in NUMERICAL_KEYS:
                 cell = {}
-                values = map(lambda x: x[key], iters)
+                values = [x[key] for x in iters if key in x]
+                if not values:
+                    nan = float("nan")
+                    cell = {"samples": 0, "mean": nan, "median": nan,
+                            "stdev": nan, "variance": nan}
+                    new_data[lang][algo][key] = cell
+                    continue
                 values = np.array(
                     list(filter(lambda x: x >= 0.0, values)), dtype=float
                 )
@@ -1892,7 +1901,10 @@ def main():
     data = []
     with open(args.input, "r") as file:
         for record in yaml.safe_load_all(file):
-            data.append(record)
+            # The summary that ends a runner's `--bench` output is not an
+            # iteration of its own.
+            if record is not None and "iteration" in record:
+                data.append(record)
     print(f"  {len(data)} experiment records read.")
 
     print("Validating experiments data...")